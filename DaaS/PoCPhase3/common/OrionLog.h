@@ -19,6 +19,89 @@
 #define  PKTCNTR  (tgInfo.rxPkts)
 #endif
 
+#ifdef ORION_LOG_ASYNC
+/* Asynchronous logging for lcore fast paths.
+ * A log call only stores a binary record (call site, TSC, packet counter and up to ORION_LOG_ARGS_MAX
+ * arguments) into a lock-free ring owned by the calling lcore. OrionLogDrain(), called from the main
+ * lcore, formats and prints the records. Each call site is rate limited to ORION_LOG_SITE_RATE records
+ * per second and the suppressed records are counted and reported with the next printed record.
+ * NOTE: "%s" arguments are printed later by another lcore, they must point to static strings!
+ */
+#include <stdint.h>
+
+#define ORION_LOG_ARGS_MAX   8
+#define ORION_LOG_SITE_RATE  100     // records per second per call site
+
+typedef struct OrionLogSite_s
+{
+  const char *level;                 // "DBG", "ERROR", "INFO"
+  const char *fmt;
+  uint32_t line;
+  uint32_t windowCnt;                // records posted in the current rate limiting window
+  uint64_t windowTsc;                // start of the current rate limiting window
+  uint32_t suppressed;               // records suppressed since the last posted record
+} OrionLogSite;
+
+int      OrionLogInit(void);
+void     OrionLogPost(OrionLogSite *site, uint32_t pktCntr, uint32_t nargs, const uint64_t *args);
+unsigned OrionLogDrain(void);
+
+static inline uint64_t orion_log_arg_int(int64_t v)     { return (uint64_t) v; }
+static inline uint64_t orion_log_arg_ptr(const void *v) { return (uint64_t) (uintptr_t) v; }
+static inline uint64_t orion_log_arg_dbl(double v)      { union { double d; uint64_t u; } x = { .d = v }; return x.u; }
+
+#define ORION_LOG_ARG(_x) _Generic((_x),                                    \
+    float: orion_log_arg_dbl, double: orion_log_arg_dbl,                    \
+    char *: orion_log_arg_ptr, const char *: orion_log_arg_ptr,             \
+    void *: orion_log_arg_ptr, const void *: orion_log_arg_ptr,             \
+    default: orion_log_arg_int)(_x)
+
+// Argument count (0..8) and per-argument conversion to uint64_t
+#define ORION_LOG_NARGS(...)  ORION_LOG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define ORION_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...)  N
+#define ORION_LOG_CAT(a, b)   ORION_LOG_CAT_(a, b)
+#define ORION_LOG_CAT_(a, b)  a##b
+#define ORION_LOG_A0()
+#define ORION_LOG_A1(a)       ORION_LOG_ARG(a),
+#define ORION_LOG_A2(a, ...)  ORION_LOG_ARG(a), ORION_LOG_A1(__VA_ARGS__)
+#define ORION_LOG_A3(a, ...)  ORION_LOG_ARG(a), ORION_LOG_A2(__VA_ARGS__)
+#define ORION_LOG_A4(a, ...)  ORION_LOG_ARG(a), ORION_LOG_A3(__VA_ARGS__)
+#define ORION_LOG_A5(a, ...)  ORION_LOG_ARG(a), ORION_LOG_A4(__VA_ARGS__)
+#define ORION_LOG_A6(a, ...)  ORION_LOG_ARG(a), ORION_LOG_A5(__VA_ARGS__)
+#define ORION_LOG_A7(a, ...)  ORION_LOG_ARG(a), ORION_LOG_A6(__VA_ARGS__)
+#define ORION_LOG_A8(a, ...)  ORION_LOG_ARG(a), ORION_LOG_A7(__VA_ARGS__)
+
+#define ORION_LOG_POST(_level, _fmt, ...) \
+  do { \
+    static OrionLogSite _site = { _level, _fmt, __LINE__, 0, 0, 0 }; \
+    uint64_t _args[ORION_LOG_ARGS_MAX + 1] = \
+      { ORION_LOG_CAT(ORION_LOG_A, ORION_LOG_NARGS(_, ##__VA_ARGS__))(__VA_ARGS__) 0 }; \
+    OrionLogPost(&_site, PKTCNTR, ORION_LOG_NARGS(_, ##__VA_ARGS__), _args); \
+  } while(0)
+
+#define DBGLOG(fmt, ...) \
+  do { \
+    if (debugLog) \
+      ORION_LOG_POST("DBG", fmt, ##__VA_ARGS__); \
+  } while(0);
+#define ERRLOG(fmt, ...) \
+  do { \
+    if (errorLog) \
+      ORION_LOG_POST("ERROR", fmt, ##__VA_ARGS__); \
+  } while(0);
+#define INFOLOG(fmt, ...) \
+  do { \
+    if (infoLog) \
+      ORION_LOG_POST("INFO", fmt, ##__VA_ARGS__); \
+  } while(0);
+#define ERRASSERT(x, fmt, ...) \
+  do { \
+    if (errorLog && !(x)) \
+      ORION_LOG_POST("ERROR", #x " " fmt, ##__VA_ARGS__); \
+  } while(0);
+
+#else  // Synchronous printf logging
+
 #define DBGLOG(fmt...) \
   do { \
     if (debugLog) \
@@ -52,6 +135,8 @@
     } \
   } while(0);
 
+#endif  // ORION_LOG_ASYNC
+
 extern int debugLog, errorLog, infoLog;
 
 #endif  // End of _ORION_LOG_H_
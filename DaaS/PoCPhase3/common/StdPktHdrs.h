@@ -62,6 +62,22 @@ struct Ipv4Hdr_s {
 } __attribute__((__packed__));
 typedef struct Ipv4Hdr_s Ipv4Hdr;
 
+/**
+ * IPv6 Header: 40 bytes
+ * BigEndian expected
+ */
+struct Ipv6Hdr_s {
+        uint32_t vtc_flow;              /* version(4) traffic class(8) flow label(20) */
+        uint16_t payload_len;           /* payload length, including extension headers */
+        uint8_t  proto;                 /* next header */
+        uint8_t  hop_limits;            /* hop limit */
+        uint8_t  src_addr[16];          /* source address */
+        uint8_t  dst_addr[16];          /* destination address */
+} __attribute__((__packed__));
+typedef struct Ipv6Hdr_s Ipv6Hdr;
+#define IPV6_VTC_TC_SHIFT       20
+#define IPV6_VTC_FLOW_MASK      0x000fffff
+
 /**
  * UDP Header: 8 bytes
  * BigEndian expected
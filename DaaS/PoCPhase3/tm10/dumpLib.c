@@ -16,7 +16,7 @@
 
 #define BOOL_STR_XXXABLED(_bool) ((_bool==true)?"enabled":"disabled")
 
-void dumpStreamConf(StreamCfg *sc)
+void dumpStreamConf(const StreamCfg *sc)
 {
   printf("Stream#%d: ", sc->streamId);
   printf("\n\tsrcIP:     %hhu.%hhu.%hhu.%hhu", sc->srcIP[0],sc->srcIP[1],sc->srcIP[2],sc->srcIP[3]);
@@ -123,12 +123,14 @@ void dumpIntfConf(IntfConf *ic)
 
 void dumpPss(SchedConf *sc)
 {
+  const TmConf *cf = sc->conf;
+
   printf("*****************\n");
   printf("PSS Configuration\n");
   printf("*****************\n");
   for (int i = 0; i < sc->timeslotsPerSeq; i++)
   {
-    printf("%4hu ", *(sc->pss[i]));
+    printf("%4hu ", cf->pss[i]);
     if ( (i+1) % 20 == 0 )
     {
       printf("\n");
@@ -139,8 +141,10 @@ void dumpPss(SchedConf *sc)
 
 void dumpSchedConf(SchedConf *sc)
 {
+  const TmConf *cf = sc->conf;
+
   printf("***********************\n");
-  printf("Scheduler Configuration- CONFIG 0 ONLY!\n");
+  printf("Scheduler Configuration #%u\n", cf->version);
   printf("***********************\n");
   printf("schedId             %u\n", sc->schedId);
   printf("schedMode           %u\n", sc->schedMode);
@@ -148,6 +152,7 @@ void dumpSchedConf(SchedConf *sc)
   printf("tmCore              %u\n", sc->tmCore);
   printf("txCore              %u\n", sc->txCore);
   printf("rxCore              %u\n", sc->rxCore);
+  printf("numRxCores          %u\n", sc->numRxCores);
   printf("linkSpeedMbps       %u\n", sc->linkSpeedMbps);
   printf("timeslotsPerSeq     %u\n", sc->timeslotsPerSeq);
   printf("maxPktSize          %u\n", sc->maxPktSize);
@@ -162,22 +167,22 @@ void dumpSchedConf(SchedConf *sc)
   printf("schedCfgFile        %s\n", sc->schedCfgFile);
   printf("intfCfgFile         %s\n", sc->intfCfgFile);
   printf("***********************\n");
-  printf("numStreams:         %d\n", sc->numStreams);
-  printf("streamsBaseNum:     %u\n", sc->streamsBaseNum);
+  printf("numStreams:         %d\n", cf->numStreams);
+  printf("streamsBaseNum:     %u\n", cf->streamsBaseNum);
   printf("***********************\n");
-  for (int i=0; i<sc->numStreams; i++)
-    dumpStreamConf(&sc->streamCfg[0][i]);  // Update stream cfg
+  for (int i=0; i<cf->numStreams; i++)
+    dumpStreamConf(&cf->streamCfg[i]);  // Update stream cfg
   printf("***********************\n");
   for (int i = 0; i < sc->queuesNum; i++)
   {
     printf("bundle %-4u         numQueues %-4u numTimeslots %-7u schedRate %-6u queue(s): ", 
-           sc->bundleConf[0][i].bid,
-           sc->bundleConf[0][i].numQueues,
-           sc->bundleConf[0][i].numTimeslots,
-           sc->bundleConf[0][i].schedRate);
-    for (int j = 0; j < sc->bundleConf[0][i].numQueues; j++)
+           cf->bundleConf[i].bid,
+           cf->bundleConf[i].numQueues,
+           cf->bundleConf[i].numTimeslots,
+           cf->bundleConf[i].schedRate);
+    for (int j = 0; j < cf->bundleConf[i].numQueues; j++)
     {
-      printf("%u ", sc->bundleConf[0][i].queues[j]);
+      printf("%u ", cf->bundleConf[i].queues[j]);
     }
     printf("\n");
   }
@@ -18,6 +18,6 @@ void dumpRunConf(RunConf *rc);
 void dumpIntfConf(IntfConf *ic);
 void dumpPss(SchedConf *sc);
 void dumpSchedConf(SchedConf *sc);
-void dumpStreamConf(StreamCfg *sc);
+void dumpStreamConf(const StreamCfg *sc);
 
 #endif // DUMP_LIB_H_
@@ -8,10 +8,22 @@
 
 #include "tmDefs.h"
 #include "parserLib.h"
+#include "tmClassifier.h"
+#include "tmFlowTable.h"
+#include "tmPolicer.h"
+#include "tmBuffer.h"
+#include "tmAqm.h"
+#include "tmFq.h"
+#include "tmEbs.h"
+#include "tmFlowAssign.h"
+#include "tmBundle.h"
+#include "tmConf.h"
 #include <stdint.h>
+#include <rte_ip.h>
+#include <arpa/inet.h>
 
 typedef int SCF_ROW_FUNCTION;
-typedef int (*SCF_ROW_FNPTR)(SchedConf *sc, int row, char *str, uint8_t confId);
+typedef int (*SCF_ROW_FNPTR)(SchedConf *sc, int row, char *str, TmConf *cf);
 
 static int
 app_parse_scf_mac_addr_str(uint8_t *mac, char *str)
@@ -20,32 +32,32 @@ app_parse_scf_mac_addr_str(uint8_t *mac, char *str)
 }
 
 static SCF_ROW_FUNCTION
-app_parse_scf_row_CONFIG_DESCRIPTION(SchedConf *dummy, int rowId, char *cd_str, uint8_t confId)
+app_parse_scf_row_CONFIG_DESCRIPTION(SchedConf *dummy, int rowId, char *cd_str, TmConf *cf)
 {
   // Informational
-  if (dummy && rowId && confId) {}  // avoid compiler warning
+  if (dummy && rowId && cf) {}  // avoid compiler warning
   printf("\t%s\n", cd_str);
   return 0;
 }
 
 static SCF_ROW_FUNCTION
-app_parse_scf_row_CONFIG_TOPLVL(SchedConf *sc, int rowId, char *tl_str, uint8_t confId)
+app_parse_scf_row_CONFIG_TOPLVL(SchedConf *sc, int rowId, char *tl_str, TmConf *cf)
 {
 #define TL_TOKENS  7
   char *tokens[TL_TOKENS];
   int ret;
-  if (rowId && confId) {}  // avoid compiler warning
+  if (rowId) {}  // avoid compiler warning
 
   ret = parser_opt_str_vals(tl_str, "\t", TL_TOKENS, tokens);
   if (ret != TL_TOKENS)
     return -1;
 
   if (strcmp(tokens[0],"DCB_Q")==0)
-    sc->schedMode = SCHED_MODE_DCB_Q;
+    cf->schedMode = SCHED_MODE_DCB_Q;
   else if (strcmp(tokens[0],"RR")==0)
-    sc->schedMode = SCHED_MODE_SRR;
+    cf->schedMode = SCHED_MODE_SRR;
   else if (strcmp(tokens[0],"L2FWD")==0)
-    sc->schedMode = SCHED_MODE_L2FWD;
+    cf->schedMode = SCHED_MODE_L2FWD;
   else
     rte_exit(EXIT_FAILURE, "ERROR: unexpected schedule algorithms %s, expects GBS or RR!\n", tokens[0]);
 
@@ -54,37 +66,45 @@ app_parse_scf_row_CONFIG_TOPLVL(SchedConf *sc, int rowId, char *tl_str, uint8_t
   // The lower-priority queues cannot be added to the set of queues derived from the configuration,
   // because their placement would change when the scheduler configuration is swapped (and their packets would get lost).
   
-  sc->queuesNum = (uint16_t)  atoi(tokens[1]) & 0xffff;
-  sc->timeslotsPerSeq = (uint16_t) atoi(tokens[2]) & 0xffff;
-  sc->maxPktSize = (uint16_t) atoi(tokens[3]) & 0xffff;
-  sc->baseStreamId = (uint16_t) atoi(tokens[4]) & 0xffff;
-  schedClassifierType = sc->classifierType = (uint16_t) atoi(tokens[5]) & 0xffff;
-
-  sc->ecnThreshold   = (uint32_t)atoi(tokens[6]);
-  ecn_mark_threshold = sc->ecnThreshold; 
-
-
+  cf->queuesNum = (uint16_t)  atoi(tokens[1]) & 0xffff;
+  cf->timeslotsPerSeq = (uint16_t) atoi(tokens[2]) & 0xffff;
+  cf->maxPktSize = (uint16_t) atoi(tokens[3]) & 0xffff;
+  cf->baseStreamId = (uint16_t) atoi(tokens[4]) & 0xffff;
+  cf->classifierType = (uint16_t) atoi(tokens[5]) & 0xffff;
 
-  double  delay_ms = strtod(tokens[6], NULL);        /* may be 0        */
-  uint32_t speed   = runConf.linkSpeedMbpsConf;
-
- 
-  const double bits_per_pkt = 1542.0 * 8.0;
-  double pkts = delay_ms * (double)speed * 1000.0 / bits_per_pkt;
-  ecn_mark_threshold = (uint32_t)(pkts + 0.5);   /* round ‑> nearest */
+  // ECN threshold in ms, may be 0. Converted to bytes at each queue's rate by TmBufferLimitBuild().
+  double delayMs = strtod(tokens[6], NULL);
+  cf->ecnThresholdUsec = (delayMs > 0.0) ? (uint32_t) (delayMs * 1000.0 + 0.5) : 0;
 
   // AF DEBUG
-  printf("Recorded classifier type: %u\n", schedClassifierType);
+  printf("Recorded classifier type: %u\n", cf->classifierType);
   // END DEBUG
 
   // Initialize the VLAN ID table
-  memset(vlanid_table, 0, 4096 * sizeof(VlanLookupEntry));
+  memset(cf->vlanTable, 0, sizeof(cf->vlanTable));
+
+  // The queue, bundle and path tables are sized from the number of queues
+  if (cf->bundleConf != NULL)
+  {
+    printf("ERROR: [CONFIG_TOPLVL] has more than one row\n");
+    return -1;
+  }
+  if (cf->queuesNum == 0 || cf->queuesNum > NUM_GBSQUEUES_MAX)
+  {
+    printf("ERROR: [CONFIG_TOPLVL] %s queues outside range 1..%d\n", tokens[1], NUM_GBSQUEUES_MAX);
+    return -1;
+  }
+  if (TmConfTablesAlloc(sc, cf) != 0)
+  {
+    printf("ERROR: [CONFIG_TOPLVL] tables of %u queues could not be allocated\n", cf->queuesNum);
+    return -1;
+  }
   
   return 0;
 }
 
 static SCF_ROW_FUNCTION
-app_parse_scf_row_GBS_PSS(SchedConf *sc, int rowId, char *tsq_str, uint8_t confId)
+app_parse_scf_row_GBS_PSS(SchedConf *sc, int rowId, char *tsq_str, TmConf *cf)
 {
   #define TSQ_TOKENS 2
   char *token[TSQ_TOKENS];
@@ -100,23 +120,77 @@ app_parse_scf_row_GBS_PSS(SchedConf *sc, int rowId, char *tsq_str, uint8_t confI
     printf("ERROR: GBS_PSS column 1 expected %d, got %s\n", rowId, token[0]);
     return -1;
   }
+  if (slot >= cf->timeslotsPerSeq || slot >= NUM_TIMESLOTS_MAX)
+  {
+    printf("ERROR: GBS_PSS slot#%d beyond the %u timeslots of the sequence\n", slot, cf->timeslotsPerSeq);
+    return -1;
+  }
 
   uint16_t bid = (uint16_t) atoi(token[1]);
-  if (bid >= sc->queuesNum)
+  if (bid >= cf->queuesNum)
   {
-    printf("ERROR: GBS_PSS slot#%d field2 bundleId %s is not within 0..%d\n", slot, token[1], (int)(sc->queuesNum - 1));
+    printf("ERROR: GBS_PSS slot#%d field2 bundleId %s is not within 0..%d\n", slot, token[1], (int)(cf->queuesNum - 1));
     return -1;
   }
 
-  sc->pss[confId][slot] = bid;
-  sc->bundleConf[confId][bid].bid = bid;
-  sc->bundleConf[confId][bid].numTimeslots++;
+  BundleConf *bc = &cf->bundleConf[bid];
+  cf->pss[slot] = bid;
+  bc->bid = bid;
+
+  // The distances to the next busy slot and to the next slot of the same bundle are filled in as the
+  // rows arrive in slot order: a busy slot closes the run of empty slots before it.
+  if (bid != 0)
+  {
+    for (int j = slot - 1; j >= 0; j--)
+    {
+      cf->pssNextBusy[j] = (uint16_t) (slot - j);
+      if (cf->pss[j] != 0)
+        break;
+    }
+    if (bc->numTimeslots > 0)
+      cf->pssNextSame[bc->pssLast] = (uint16_t) (slot - bc->pssLast);
+    else
+      bc->pssFirst = (uint16_t) slot;
+    bc->pssLast = (uint16_t) slot;
+  }
+  bc->numTimeslots++;
+
+  // The last slot wraps the tail of the sequence around to its first busy slots
+  if (slot == cf->timeslotsPerSeq - 1)
+  {
+    uint16_t n = cf->timeslotsPerSeq;
+    uint16_t first = 0;
+    uint16_t longest = 0;
+    while (first < n && cf->pss[first] == 0)
+      first++;
+    if (first == n)
+      return 0;  // no bundle at all: pssNextBusy stays 0
+    for (int j = slot; j >= 0; j--)
+    {
+      cf->pssNextBusy[j] = (uint16_t) (first + n - j);
+      if (cf->pss[j] != 0)
+        break;
+    }
+    for (uint16_t b = 1; b < cf->queuesNum; b++)
+    {
+      const BundleConf *bb = &cf->bundleConf[b];
+      if (bb->numTimeslots > 0)
+        cf->pssNextSame[bb->pssLast] = (uint16_t) (bb->pssFirst + n - bb->pssLast);
+    }
+    for (uint16_t j = 0; j < n; j++)
+    {
+      if (cf->pssNextBusy[j] > longest)
+        longest = cf->pssNextBusy[j];
+    }
+    if (longest > 1)
+      printf("Conf #%u: up to %u PSS slots to the next bundle\n", cf->version, longest);
+  }
 
   return 0;
 }
 
 static SCF_ROW_FUNCTION
-app_parse_scf_row_GBS_SCHEDULING_RATE(SchedConf *sc, int rowId, char *sr_str, uint8_t confId)
+app_parse_scf_row_GBS_SCHEDULING_RATE(SchedConf *sc, int rowId, char *sr_str, TmConf *cf)
 {
   #define SR_TOKENS 3
   char *token[SR_TOKENS];
@@ -129,9 +203,9 @@ app_parse_scf_row_GBS_SCHEDULING_RATE(SchedConf *sc, int rowId, char *sr_str, ui
     }
 
   uint16_t bid = atoi(token[0]);
-  if (bid >= NUM_GBSQUEUES_MAX)
+  if (bid >= cf->queuesNum)
   {
-    printf("ERROR: gbs bid#%d outside range 0..%d\n", bid, (NUM_GBSQUEUES_MAX - 1));
+    printf("ERROR: gbs bid#%d outside range 0..%d\n", bid, (cf->queuesNum - 1));
     return -1;
   }
 
@@ -141,63 +215,64 @@ app_parse_scf_row_GBS_SCHEDULING_RATE(SchedConf *sc, int rowId, char *sr_str, ui
     printf("ERROR: gbs bundle#%d has rate %s greater than link rate %d\n", bid, token[1], runConf.linkSpeedMbpsConf);
     return -1;
   }
-  sc->bundleConf[confId][bid].schedRate = schedRate;
+  cf->bundleConf[bid].schedRate = schedRate;
 
   uint16_t pathid = atoi(token[2]);
-  if (pathid >= NUM_GBSQUEUES_MAX)
+  if (pathid >= cf->queuesNum)
   {
-    printf("ERROR: gbs path ID #%d outside range 0..%d\n", pathid, (NUM_GBSQUEUES_MAX - 1));
+    printf("ERROR: gbs path ID #%d outside range 0..%d\n", pathid, (cf->queuesNum - 1));
     return -1;
   }
-  sc->bundleConf[confId][bid].pathId = pathid;
-  sc->pathConf[confId][pathid].schedRate += schedRate;
-  sc->pathConf[confId][pathid].numTimeslots += sc->bundleConf[confId][bid].numTimeslots;
+  cf->bundleConf[bid].pathId = pathid;
+  cf->pathConf[pathid].schedRate += schedRate;
+  cf->pathConf[pathid].numTimeslots += cf->bundleConf[bid].numTimeslots;
 
   
   // DEBUG
-  printf("Conf #%d Bundle Id %u  Rate %u  numTimeslots: %d  Path: %u  PathRate: %u  PathTimeslots: %d\n",
-	 confId, sc->bundleConf[confId][bid].bid, 
-	 sc->bundleConf[confId][bid].schedRate, 
-	 sc->bundleConf[confId][bid].numTimeslots, 
-	 sc->bundleConf[confId][bid].pathId,
-	 sc->pathConf[confId][sc->bundleConf[confId][bid].pathId].schedRate, 
-	 sc->pathConf[confId][sc->bundleConf[confId][bid].pathId].numTimeslots) ;
+  printf("Conf #%u Bundle Id %u  Rate %u  numTimeslots: %d  Path: %u  PathRate: %u  PathTimeslots: %d\n",
+	 cf->version, cf->bundleConf[bid].bid, 
+	 cf->bundleConf[bid].schedRate, 
+	 cf->bundleConf[bid].numTimeslots, 
+	 cf->bundleConf[bid].pathId,
+	 cf->pathConf[cf->bundleConf[bid].pathId].schedRate, 
+	 cf->pathConf[cf->bundleConf[bid].pathId].numTimeslots) ;
   // END DEBUG
   
   return 0;
 }
 
 static SCF_ROW_FUNCTION
-app_parse_scf_row_GBS_BUNDLE_MAPPING(SchedConf *sc, int rowId, char *bm_str, uint8_t confId)
+app_parse_scf_row_GBS_BUNDLE_MAPPING(SchedConf *sc, int rowId, char *bm_str, TmConf *cf)
 {
   int bmTokens = 2;
 
-  if (schedClassifierType == VLANID_SRCMAC_CLASSIFIER)
+  if (cf->classifierType == VLANID_SRCMAC_CLASSIFIER)
     {
       bmTokens = 4;
     }
 
-  char **token = (char **)malloc(bmTokens * sizeof(char *));
+  // An optional last column gives the queue's DRR quantum in bytes
+  char **token = (char **)malloc((bmTokens + 1) * sizeof(char *));
 
   int i; char *ptr;
   if (rowId) {}  // avoid compiler warning
 
-  for (i=0, ptr=strtok(bm_str, "\t"); ptr && i<bmTokens; i++, ptr=strtok(NULL, "\t"))
+  for (i=0, ptr=strtok(bm_str, "\t"); ptr && i<bmTokens+1; i++, ptr=strtok(NULL, "\t"))
     token[i] = ptr;
 
   int bid = atoi(token[0]);
-  if (bid < 0 || bid >= NUM_GBSQUEUES_MAX)
+  if (bid < 0 || bid >= cf->queuesNum)
   {
-    printf("ERROR: bundle id %d outside range 0..%d\n", bid, (NUM_GBSQUEUES_MAX - 1));
+    printf("ERROR: bundle id %d outside range 0..%d\n", bid, (cf->queuesNum - 1));
     return -1;
   }
 
-  BundleConf *bc = &(sc->bundleConf[confId][bid]);
+  BundleConf *bc = &(cf->bundleConf[bid]);
 
   int qid = atoi(token[1]);
-  if (qid < 0 || qid >= NUM_GBSQUEUES_MAX)
+  if (qid < 0 || qid >= cf->queuesNum)
   {
-    printf("ERROR: gbs qid#%d outside range 0..%d\n", qid, (NUM_GBSQUEUES_MAX - 1));
+    printf("ERROR: gbs qid#%d outside range 0..%d\n", qid, (cf->queuesNum - 1));
     return -1;
   }
 
@@ -209,8 +284,22 @@ app_parse_scf_row_GBS_BUNDLE_MAPPING(SchedConf *sc, int rowId, char *bm_str, uin
   }
 
   bc->queues[bc->numQueues] = qid;
+  bc->quantum[bc->numQueues] = 0;
+  if (i == bmTokens + 1 && strcmp(token[bmTokens], "*") != 0)
+  {
+    char *end;
+    unsigned long quantum = strtoul(token[bmTokens], &end, 0);
+    if ((*end != '\0' && *end != '\n' && *end != '\r') || quantum < RTE_ETHER_MIN_LEN || quantum > UINT16_MAX)
+    {
+      printf("ERROR: bundle %d queue %d bad DRR quantum %s, expects %u..%u bytes or *\n", bid, qid, token[bmTokens],
+             RTE_ETHER_MIN_LEN, UINT16_MAX);
+      free(token);
+      return -1;
+    }
+    bc->quantum[bc->numQueues] = (uint32_t) quantum;
+  }
 
-  if (schedClassifierType == VLANID_SRCMAC_CLASSIFIER)
+  if (cf->classifierType == VLANID_SRCMAC_CLASSIFIER)
     {
       // If packet classification is based on VLAN ID and SRC MAC address,
       // load the corresponding two fields
@@ -222,16 +311,16 @@ app_parse_scf_row_GBS_BUNDLE_MAPPING(SchedConf *sc, int rowId, char *bm_str, uin
 	}
 
       int addrlen = 0;
-      if(vlanid_table[vlanid].qid1 == 0)
+      if(cf->vlanTable[vlanid].qid1 == 0)
 	{
-	  addrlen = app_parse_scf_mac_addr_str((uint8_t *)(&(vlanid_table[vlanid].macaddr1)), token[3]);
-	  vlanid_table[vlanid].qid1 = (uint16_t)qid;
-	  vlanid_table[vlanid].vlanId = (uint16_t)vlanid;
+	  addrlen = app_parse_scf_mac_addr_str((uint8_t *)(&(cf->vlanTable[vlanid].macaddr1)), token[3]);
+	  cf->vlanTable[vlanid].qid1 = (uint16_t)qid;
+	  cf->vlanTable[vlanid].vlanId = (uint16_t)vlanid;
 	}
       else
 	{
-	  addrlen = app_parse_scf_mac_addr_str((uint8_t *)(&(vlanid_table[vlanid].macaddr2)), token[3]);
-	  vlanid_table[vlanid].qid2 = (uint16_t)qid;
+	  addrlen = app_parse_scf_mac_addr_str((uint8_t *)(&(cf->vlanTable[vlanid].macaddr2)), token[3]);
+	  cf->vlanTable[vlanid].qid2 = (uint16_t)qid;
 	}
       if (addrlen != 6)
 	{
@@ -241,13 +330,13 @@ app_parse_scf_row_GBS_BUNDLE_MAPPING(SchedConf *sc, int rowId, char *bm_str, uin
       // AF250617 DEBUG
       printf("VLAN ID TABLE ENTRY %d: VLANID: %u QID1: %u QID2: %u",
 	     vlanid,
-	     vlanid_table[vlanid].vlanId,
-	     vlanid_table[vlanid].qid1,
-	     vlanid_table[vlanid].qid2);
+	     cf->vlanTable[vlanid].vlanId,
+	     cf->vlanTable[vlanid].qid1,
+	     cf->vlanTable[vlanid].qid2);
       printf(" MAC1: ");
-      mac_address_printf(&(vlanid_table[vlanid].macaddr1));
+      mac_address_printf(&(cf->vlanTable[vlanid].macaddr1));
       printf(" MAC2: ");
-      mac_address_printf(&(vlanid_table[vlanid].macaddr2));
+      mac_address_printf(&(cf->vlanTable[vlanid].macaddr2));
       printf("\n");      
       // END DEBUG
     }
@@ -258,8 +347,740 @@ app_parse_scf_row_GBS_BUNDLE_MAPPING(SchedConf *sc, int rowId, char *bm_str, uin
   return 0;
 }
 
+// "*" or a value/range of the form "lo[-hi]", written into [lo,hi]. Returns -1 if outside 0..max.
+static int
+app_parse_scf_range_str(const char *str, uint32_t max, uint32_t *lo, uint32_t *hi)
+{
+  if (strcmp(str, "*") == 0)
+  {
+    *lo = 0;
+    *hi = max;
+    return 0;
+  }
+
+  char *end;
+  *lo = (uint32_t) strtoul(str, &end, 0);
+  *hi = (*end == '-') ? (uint32_t) strtoul(end + 1, &end, 0) : *lo;
+  if (*end != '\0' || *lo > *hi || *hi > max)
+    return -1;
+  return 0;
+}
+
+// "*" or a dotted IPv4 address with optional "/prefix", ip returned in host order
+static int
+app_parse_scf_ipv4_str(const char *str, uint32_t *ip, uint8_t *prefix)
+{
+  unsigned a[4];
+  unsigned plen = 32;
+
+  if (strcmp(str, "*") == 0)
+  {
+    *ip = 0;
+    *prefix = 0;
+    return 0;
+  }
+
+  int n = sscanf(str, "%u.%u.%u.%u/%u", &a[0], &a[1], &a[2], &a[3], &plen);
+  if ((n != 4 && n != 5) || plen > 32)
+    return -1;
+  for (int i = 0; i < 4; i++)
+    if (a[i] > UINT8_MAX)
+      return -1;
+
+  *ip = RTE_IPV4(a[0], a[1], a[2], a[3]);
+  *prefix = (uint8_t) plen;
+  return 0;
+}
+
+// IPv6 address with optional "/prefix", ip returned in network order. "*" is handled by the caller.
+static int
+app_parse_scf_ipv6_str(const char *str, uint8_t ip[16], uint8_t *prefix)
+{
+  char addr[INET6_ADDRSTRLEN];
+  unsigned plen = 128;
+  const char *slash = strchr(str, '/');
+  size_t len = slash ? (size_t)(slash - str) : strlen(str);
+
+  if (len >= sizeof(addr))
+    return -1;
+  memcpy(addr, str, len);
+  addr[len] = '\0';
+  if (inet_pton(AF_INET6, addr, ip) != 1)
+    return -1;
+  if (slash)
+  {
+    char *end;
+    plen = (unsigned) strtoul(slash + 1, &end, 10);
+    if (*end != '\0' || plen > 128)
+      return -1;
+  }
+  *prefix = (uint8_t) plen;
+  return 0;
+}
+
+// Classification action: GBS:<qid>, EBS:<class> or DROP
+static int
+app_parse_scf_action_str(const char *str, uint16_t *qid, const TmConf *cf)
+{
+  int n;
+
+  if (strcmp(str, "DROP") == 0)
+    *qid = QID_DROP;
+  else if (sscanf(str, "GBS:%d", &n) == 1 && n > 0 && n < cf->queuesNum)
+    *qid = (uint16_t) n;
+  else if (sscanf(str, "EBS:%d", &n) == 1 && n >= 0 && n < TM_NUM_CLASSES)
+    *qid = QID_EBS(cf->queuesNum, n);
+  else
+  {
+    printf("ERROR: bad action %s, expects GBS:<1..%d>, EBS:<0..%d> or DROP\n", str, cf->queuesNum - 1, TM_NUM_CLASSES - 1);
+    return -1;
+  }
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_CLASSIFIER_RULES(SchedConf *sc, int rowId, char *cr_str, TmConf *cf)
+{
+  // priority  vlanId  pcp  srcIP[/len]  dstIP[/len]  srcPort[-hi]  dstPort[-hi]  protocol  dscp  action  [flowLabel]
+  // IP addresses are IPv4 or IPv6; a rule with "*" for both and no flowLabel applies to both families.
+  #define CR_TOKENS 10
+  char *token[CR_TOKENS + 1];
+  uint32_t lo, hi;
+
+  int n = parser_opt_str_vals(cr_str, "\t", CR_TOKENS + 1, token);
+  if (n != CR_TOKENS && n != CR_TOKENS + 1)
+    return -1;
+
+  if (cf->numClassifierRules == CLASSIFIER_RULES_MAX)
+  {
+    printf("ERROR: max number of classifier rules reached (%d) at row %d\n", CLASSIFIER_RULES_MAX, rowId);
+    return -1;
+  }
+
+  ClassifierRule *cr = &cf->classifierRule[cf->numClassifierRules];
+  memset(cr, 0, sizeof(*cr));
+
+  cr->priority = (uint32_t) atoi(token[0]);
+
+  // VLAN TCI: vlanId in bits 0..11, pcp in bits 13..15
+  if (strcmp(token[1], "*") != 0)
+  {
+    if (app_parse_scf_range_str(token[1], 4095, &lo, &hi) != 0 || lo != hi)
+    {
+      printf("ERROR: classifier rule %d bad vlanId %s\n", rowId, token[1]);
+      return -1;
+    }
+    cr->vlanTci |= (uint16_t) lo;
+    cr->vlanTciMask |= 0x0fff;
+  }
+  if (strcmp(token[2], "*") != 0)
+  {
+    if (app_parse_scf_range_str(token[2], 7, &lo, &hi) != 0 || lo != hi)
+    {
+      printf("ERROR: classifier rule %d bad pcp %s\n", rowId, token[2]);
+      return -1;
+    }
+    cr->vlanTci |= (uint16_t) (lo << 13);
+    cr->vlanTciMask |= 0xe000;
+  }
+
+  bool ipv6 = strchr(token[3], ':') != NULL || strchr(token[4], ':') != NULL || n == CR_TOKENS + 1;
+  bool ipv4 = (strcmp(token[3], "*") != 0 && strchr(token[3], ':') == NULL) ||
+              (strcmp(token[4], "*") != 0 && strchr(token[4], ':') == NULL);
+  if (ipv4 && ipv6)
+  {
+    printf("ERROR: classifier rule %d mixes IPv4 and IPv6 in %s, %s%s\n", rowId, token[3], token[4],
+           (n == CR_TOKENS + 1) ? " with flowLabel" : "");
+    return -1;
+  }
+  cr->family = ipv6 ? CR_FAMILY_IPV6 : (ipv4 ? CR_FAMILY_IPV4 : (CR_FAMILY_IPV4 | CR_FAMILY_IPV6));
+
+  if (ipv6)
+  {
+    if ((strcmp(token[3], "*") != 0 && app_parse_scf_ipv6_str(token[3], cr->srcIp6, &cr->srcIpPrefix) != 0) ||
+        (strcmp(token[4], "*") != 0 && app_parse_scf_ipv6_str(token[4], cr->dstIp6, &cr->dstIpPrefix) != 0))
+    {
+      printf("ERROR: classifier rule %d bad IPv6 address %s or %s\n", rowId, token[3], token[4]);
+      return -1;
+    }
+    if (n == CR_TOKENS + 1 && strcmp(token[10], "*") != 0)
+    {
+      if (app_parse_scf_range_str(token[10], IPV6_VTC_FLOW_MASK, &lo, &hi) != 0 || lo != hi)
+      {
+        printf("ERROR: classifier rule %d bad flowLabel %s\n", rowId, token[10]);
+        return -1;
+      }
+      cr->flowLabel = lo;
+      cr->flowLabelMask = IPV6_VTC_FLOW_MASK;
+    }
+  }
+  else if (app_parse_scf_ipv4_str(token[3], &cr->srcIp, &cr->srcIpPrefix) != 0 ||
+           app_parse_scf_ipv4_str(token[4], &cr->dstIp, &cr->dstIpPrefix) != 0)
+  {
+    printf("ERROR: classifier rule %d bad IPv4 address %s or %s\n", rowId, token[3], token[4]);
+    return -1;
+  }
+
+  if (app_parse_scf_range_str(token[5], UINT16_MAX, &lo, &hi) != 0)
+  {
+    printf("ERROR: classifier rule %d bad srcPort %s\n", rowId, token[5]);
+    return -1;
+  }
+  cr->srcPortLo = (uint16_t) lo;
+  cr->srcPortHi = (uint16_t) hi;
+
+  if (app_parse_scf_range_str(token[6], UINT16_MAX, &lo, &hi) != 0)
+  {
+    printf("ERROR: classifier rule %d bad dstPort %s\n", rowId, token[6]);
+    return -1;
+  }
+  cr->dstPortLo = (uint16_t) lo;
+  cr->dstPortHi = (uint16_t) hi;
+
+  if (strcmp(token[7], "udp") == 0)
+    cr->proto = IPPROTO_UDP;
+  else if (strcmp(token[7], "tcp") == 0)
+    cr->proto = IPPROTO_TCP;
+  else if (strcmp(token[7], "*") != 0)
+  {
+    if (app_parse_scf_range_str(token[7], UINT8_MAX, &lo, &hi) != 0 || lo != hi)
+    {
+      printf("ERROR: classifier rule %d bad protocol %s\n", rowId, token[7]);
+      return -1;
+    }
+    cr->proto = (uint8_t) lo;
+  }
+  cr->protoMask = (strcmp(token[7], "*") == 0) ? 0 : 0xff;
+
+  if (strcmp(token[8], "*") != 0)
+  {
+    if (app_parse_scf_range_str(token[8], 63, &lo, &hi) != 0 || lo != hi)
+    {
+      printf("ERROR: classifier rule %d bad dscp %s\n", rowId, token[8]);
+      return -1;
+    }
+    cr->dscp = (uint8_t) lo;
+    cr->dscpMask = 0x3f;
+  }
+
+  if (app_parse_scf_action_str(token[9], &cr->qid, cf) != 0)
+  {
+    printf("ERROR: classifier rule %d bad action %s\n", rowId, token[9]);
+    return -1;
+  }
+
+  cf->numClassifierRules++;
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_FLOW_TABLE(SchedConf *sc, int rowId, char *ft_str, TmConf *cf)
+{
+  // 5T  srcIP  dstIP  srcPort  dstPort  protocol  action
+  // VM  vlanId  srcMAC  action
+  #define FT_TOKENS_MAX 7
+  char *token[FT_TOKENS_MAX];
+  FlowKey key;
+  uint16_t qid;
+  uint32_t lo, hi;
+  uint8_t prefix;
+
+  int n = parser_opt_str_vals(ft_str, "\t", FT_TOKENS_MAX, token);
+  memset(&key, 0, sizeof(key));
+
+  if (n == 7 && strcmp(token[0], "5T") == 0)
+  {
+    key.type = FLOW_KEY_5TUPLE;
+    if (app_parse_scf_ipv4_str(token[1], &key.srcIp, &prefix) != 0 || prefix != 32 ||
+        app_parse_scf_ipv4_str(token[2], &key.dstIp, &prefix) != 0 || prefix != 32)
+    {
+      printf("ERROR: flow table row %d bad IPv4 address %s or %s\n", rowId, token[1], token[2]);
+      return -1;
+    }
+    key.srcIp = rte_cpu_to_be_32(key.srcIp);
+    key.dstIp = rte_cpu_to_be_32(key.dstIp);
+
+    if (app_parse_scf_range_str(token[3], UINT16_MAX, &lo, &hi) != 0 || lo != hi)
+    {
+      printf("ERROR: flow table row %d bad srcPort %s\n", rowId, token[3]);
+      return -1;
+    }
+    key.srcPort = rte_cpu_to_be_16((uint16_t) lo);
+    if (app_parse_scf_range_str(token[4], UINT16_MAX, &lo, &hi) != 0 || lo != hi)
+    {
+      printf("ERROR: flow table row %d bad dstPort %s\n", rowId, token[4]);
+      return -1;
+    }
+    key.dstPort = rte_cpu_to_be_16((uint16_t) lo);
+
+    if (strcmp(token[5], "udp") == 0)
+      key.proto = IPPROTO_UDP;
+    else if (strcmp(token[5], "tcp") == 0)
+      key.proto = IPPROTO_TCP;
+    else if (app_parse_scf_range_str(token[5], UINT8_MAX, &lo, &hi) == 0 && lo == hi)
+      key.proto = (uint8_t) lo;
+    else
+    {
+      printf("ERROR: flow table row %d bad protocol %s\n", rowId, token[5]);
+      return -1;
+    }
+    if (key.proto != IPPROTO_UDP && key.proto != IPPROTO_TCP && (key.srcPort || key.dstPort))
+    {
+      printf("ERROR: flow table row %d ports must be 0 for protocol %s\n", rowId, token[5]);
+      return -1;
+    }
+  }
+  else if (n == 4 && strcmp(token[0], "VM") == 0)
+  {
+    key.type = FLOW_KEY_VLANMAC;
+    if (app_parse_scf_range_str(token[1], 4095, &lo, &hi) != 0 || lo != hi)
+    {
+      printf("ERROR: flow table row %d bad vlanId %s\n", rowId, token[1]);
+      return -1;
+    }
+    key.vlanId = (uint16_t) lo;
+    if (app_parse_scf_mac_addr_str(key.srcMac.addr_bytes, token[2]) != 6)
+    {
+      printf("ERROR: flow table row %d bad srcMAC %s\n", rowId, token[2]);
+      return -1;
+    }
+  }
+  else
+  {
+    printf("ERROR: flow table row %d expects 5T with 7 columns or VM with 4 columns\n", rowId);
+    return -1;
+  }
+
+  if (app_parse_scf_action_str(token[n - 1], &qid, cf) != 0)
+    return -1;
+
+  return TmFlowTableAdd(sc, cf, &key, qid);
+}
+
+// Policer color action: ACCEPT, EBS:<class> or DROP
+static int
+app_parse_scf_color_action_str(const char *str, uint16_t *action, const TmConf *cf)
+{
+  if (strcmp(str, "ACCEPT") == 0)
+  {
+    *action = QID_NONE;
+    return 0;
+  }
+  if (strncmp(str, "GBS:", 4) == 0)
+  {
+    printf("ERROR: policer action %s cannot remark to a GBS queue\n", str);
+    return -1;
+  }
+  return app_parse_scf_action_str(str, action, cf);
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_GBS_QUEUE_POLICER(SchedConf *sc, int rowId, char *qp_str, TmConf *cf)
+{
+  // qid  SRTCM|TRTCM  cirMbps|*  cbs  ebs|pbs  pirMbps|*  yellowAction  redAction
+  #define QP_TOKENS 8
+  char *token[QP_TOKENS];
+  uint32_t lo, hi;
+
+  if (parser_opt_str_vals(qp_str, "\t", QP_TOKENS, token) != QP_TOKENS)
+    return -1;
+
+  if (app_parse_scf_range_str(token[0], cf->queuesNum - 1, &lo, &hi) != 0 || lo != hi || lo == 0)
+  {
+    printf("ERROR: policer row %d bad GBS qid %s, expects 1..%d\n", rowId, token[0], cf->queuesNum - 1);
+    return -1;
+  }
+  PolicerConf *pc = &cf->policerConf[lo];
+  memset(pc, 0, sizeof(*pc));
+
+  if (strcmp(token[1], "SRTCM") == 0)
+    pc->mode = POLICER_SRTCM;
+  else if (strcmp(token[1], "TRTCM") == 0)
+    pc->mode = POLICER_TRTCM;
+  else
+  {
+    printf("ERROR: policer row %d bad mode %s, expects SRTCM or TRTCM\n", rowId, token[1]);
+    return -1;
+  }
+
+  // "*" rate: the [GBS_SCHEDULING_RATE] of the queue's bundle, resolved by TmPolicerBuild()
+  if (strcmp(token[2], "*") != 0 &&
+      (app_parse_scf_range_str(token[2], runConf.linkSpeedMbpsConf, &lo, &hi) != 0 || lo != hi || lo == 0))
+  {
+    printf("ERROR: policer row %d bad cir %s\n", rowId, token[2]);
+    return -1;
+  }
+  pc->cirMbps = (strcmp(token[2], "*") != 0) ? lo : 0;
+
+  if (app_parse_scf_range_str(token[3], UINT32_MAX, &lo, &hi) != 0 || lo != hi ||
+      app_parse_scf_range_str(token[4], UINT32_MAX, &pc->ebs, &hi) != 0 || pc->ebs != hi)
+  {
+    printf("ERROR: policer row %d bad burst size %s or %s\n", rowId, token[3], token[4]);
+    return -1;
+  }
+  pc->cbs = lo;
+
+  if (pc->mode == POLICER_TRTCM &&
+      (app_parse_scf_range_str(token[5], runConf.linkSpeedMbpsConf, &lo, &hi) != 0 || lo != hi || lo == 0))
+  {
+    printf("ERROR: policer row %d bad pir %s\n", rowId, token[5]);
+    return -1;
+  }
+  pc->pirMbps = (pc->mode == POLICER_TRTCM) ? lo : 0;
+
+  pc->action[RTE_COLOR_GREEN] = QID_NONE;
+  if (app_parse_scf_color_action_str(token[6], &pc->action[RTE_COLOR_YELLOW], cf) != 0 ||
+      app_parse_scf_color_action_str(token[7], &pc->action[RTE_COLOR_RED], cf) != 0)
+  {
+    printf("ERROR: policer row %d bad color action %s or %s\n", rowId, token[6], token[7]);
+    return -1;
+  }
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_QUEUE_BUFFER_LIMIT(SchedConf *sc, int rowId, char *ql_str, TmConf *cf)
+{
+  // GBS:<qid>|EBS:<class>  maxPkts|*  maxBytes|*  [ecnUsec|*]
+  #define QL_TOKENS 3
+  char *token[QL_TOKENS + 1];
+  uint16_t qid;
+  uint32_t hi;
+
+  int n = parser_opt_str_vals(ql_str, "\t", QL_TOKENS + 1, token);
+  if (n != QL_TOKENS && n != QL_TOKENS + 1)
+    return -1;
+
+  if (app_parse_scf_action_str(token[0], &qid, cf) != 0 || qid == QID_DROP)
+  {
+    printf("ERROR: queue limit row %d bad queue %s\n", rowId, token[0]);
+    return -1;
+  }
+  // "*" is derived from the queue rate by TmBufferLimitBuild()
+  QueueLimit *qc = &cf->queueLimitConf[qid];
+  if (app_parse_scf_range_str(token[1], QUEUE_LIMIT_PKTS_MAX, &qc->maxPkts, &hi) != 0 ||
+      (strcmp(token[1], "*") != 0 && (qc->maxPkts != hi || qc->maxPkts == 0)))
+  {
+    printf("ERROR: queue limit row %d bad max pkts %s, expects 1..%d or *\n", rowId, token[1], QUEUE_LIMIT_PKTS_MAX);
+    return -1;
+  }
+  if (app_parse_scf_range_str(token[2], UINT32_MAX, &qc->maxBytes, &hi) != 0 ||
+      (strcmp(token[2], "*") != 0 && (qc->maxBytes != hi || qc->maxBytes < cf->maxPktSize)))
+  {
+    printf("ERROR: queue limit row %d bad max bytes %s, expects at least %u or *\n", rowId, token[2], cf->maxPktSize);
+    return -1;
+  }
+  if (n == QL_TOKENS + 1 &&
+      (app_parse_scf_range_str(token[3], US_PER_S, &qc->ecnUsec, &hi) != 0 ||
+       (strcmp(token[3], "*") != 0 && (qc->ecnUsec != hi || qc->ecnUsec == 0))))
+  {
+    printf("ERROR: queue limit row %d bad ECN threshold %s, expects 1..%u usec or *\n", rowId, token[3], US_PER_S);
+    return -1;
+  }
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_QUEUE_BUFFER_SHARING(SchedConf *sc, int rowId, char *bs_str, TmConf *cf)
+{
+  // GBS:<qid>|EBS:<class>|GBS:*|EBS:*  alpha|*  [reservePkts|*]
+  #define BS_TOKENS 2
+  char *token[BS_TOKENS + 1];
+  uint16_t qid, qidLast;
+  uint32_t reserve = 0, hi;
+
+  int n = parser_opt_str_vals(bs_str, "\t", BS_TOKENS + 1, token);
+  if (n != BS_TOKENS && n != BS_TOKENS + 1)
+    return -1;
+
+  // A wildcard row sets every queue of its kind, later rows override it
+  if (strcmp(token[0], "GBS:*") == 0)
+  {
+    qid = 1;
+    qidLast = cf->queuesNum - 1;
+  }
+  else if (strcmp(token[0], "EBS:*") == 0)
+  {
+    qid = QID_EBS(cf->queuesNum, 0);
+    qidLast = QID_EBS(cf->queuesNum, TM_NUM_CLASSES - 1);
+  }
+  else if (app_parse_scf_action_str(token[0], &qid, cf) == 0 && qid != QID_DROP)
+    qidLast = qid;
+  else
+  {
+    printf("ERROR: buffer sharing row %d bad queue %s\n", rowId, token[0]);
+    return -1;
+  }
+
+  // "*" is the GBS or EBS default, set by TmBufferLimitBuild()
+  char *end;
+  double alpha = (strcmp(token[1], "*") == 0) ? 0.0 : strtod(token[1], &end);
+  if (strcmp(token[1], "*") != 0 && (*end != '\0' || alpha < 1.0 / (1 << BUF_DT_ALPHA_SHIFT) || alpha > BUF_DT_ALPHA_MAX))
+  {
+    printf("ERROR: buffer sharing row %d bad alpha %s, expects %g..%d or *\n", rowId, token[1],
+           1.0 / (1 << BUF_DT_ALPHA_SHIFT), BUF_DT_ALPHA_MAX);
+    return -1;
+  }
+  if (n == BS_TOKENS + 1 &&
+      (app_parse_scf_range_str(token[2], QUEUE_LIMIT_PKTS_MAX, &reserve, &hi) != 0 ||
+       (strcmp(token[2], "*") != 0 && (reserve != hi || reserve == 0 || qidLast >= cf->queuesNum))))
+  {
+    printf("ERROR: buffer sharing row %d bad reserve %s, expects 1..%d pkts or * for GBS queues\n", rowId, token[2],
+           QUEUE_LIMIT_PKTS_MAX);
+    return -1;
+  }
+
+  for (; qid <= qidLast; qid++)
+  {
+    cf->queueLimitConf[qid].dtAlpha = (uint16_t) (alpha * (1 << BUF_DT_ALPHA_SHIFT) + 0.5);
+    cf->queueLimitConf[qid].reservePkts = reserve;
+  }
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_QUEUE_AQM(SchedConf *sc, int rowId, char *qa_str, TmConf *cf)
+{
+  // GBS:<qid>|EBS:<class>  CODEL|PIE  targetUsec|*  intervalUsec|*  ECN|DROP
+  #define QA_TOKENS 5
+  char *token[QA_TOKENS];
+  uint16_t qid;
+  uint32_t hi;
+
+  if (parser_opt_str_vals(qa_str, "\t", QA_TOKENS, token) != QA_TOKENS)
+    return -1;
+
+  if (app_parse_scf_action_str(token[0], &qid, cf) != 0 || qid == QID_DROP)
+  {
+    printf("ERROR: AQM row %d bad queue %s\n", rowId, token[0]);
+    return -1;
+  }
+  AqmConf *ac = &cf->aqmConf[qid];
+  memset(ac, 0, sizeof(*ac));
+
+  if (strcmp(token[1], "CODEL") == 0)
+    ac->mode = AQM_CODEL;
+  else if (strcmp(token[1], "PIE") == 0)
+    ac->mode = AQM_PIE;
+  else
+  {
+    printf("ERROR: AQM row %d bad algorithm %s, expects CODEL or PIE\n", rowId, token[1]);
+    return -1;
+  }
+
+  // "*" is the algorithm's default, set by TmAqmBuild()
+  if (app_parse_scf_range_str(token[2], US_PER_S, &ac->targetUsec, &hi) != 0 ||
+      (strcmp(token[2], "*") != 0 && (ac->targetUsec != hi || ac->targetUsec == 0)) ||
+      app_parse_scf_range_str(token[3], US_PER_S, &ac->intervalUsec, &hi) != 0 ||
+      (strcmp(token[3], "*") != 0 && (ac->intervalUsec != hi || ac->intervalUsec == 0)))
+  {
+    printf("ERROR: AQM row %d bad target %s or interval %s, expects 1..%u usec or *\n", rowId, token[2], token[3], US_PER_S);
+    return -1;
+  }
+
+  if (strcmp(token[4], "ECN") == 0)
+    ac->ecn = true;
+  else if (strcmp(token[4], "DROP") != 0)
+  {
+    printf("ERROR: AQM row %d bad signal %s, expects ECN or DROP\n", rowId, token[4]);
+    return -1;
+  }
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_QUEUE_FQ(SchedConf *sc, int rowId, char *fq_str, TmConf *cf)
+{
+  // GBS:<qid>|EBS:<class>  subQueues  quantumBytes|*
+  #define FQ_TOKENS 3
+  char *token[FQ_TOKENS];
+  uint16_t qid;
+  uint32_t lo, hi;
+
+  if (parser_opt_str_vals(fq_str, "\t", FQ_TOKENS, token) != FQ_TOKENS)
+    return -1;
+
+  if (app_parse_scf_action_str(token[0], &qid, cf) != 0 || qid == QID_DROP)
+  {
+    printf("ERROR: FQ row %d bad queue %s\n", rowId, token[0]);
+    return -1;
+  }
+  FqConf *fc = &cf->fqConf[qid];
+
+  if (app_parse_scf_range_str(token[1], FQ_SUBQUEUES_MAX, &lo, &hi) != 0 || lo != hi || lo < 2 ||
+      !rte_is_power_of_2(lo))
+  {
+    printf("ERROR: FQ row %d bad sub-queues %s, expects a power of 2 in 2..%d\n", rowId, token[1], FQ_SUBQUEUES_MAX);
+    return -1;
+  }
+  fc->numSub = (uint16_t) lo;
+
+  // "*" is maxPktSize, the smallest quantum that serves a backlogged flow in each round, see TmFqBuild()
+  if (app_parse_scf_range_str(token[2], UINT16_MAX, &fc->quantumBytes, &hi) != 0 ||
+      (strcmp(token[2], "*") != 0 && (fc->quantumBytes != hi || fc->quantumBytes < RTE_ETHER_MIN_LEN)))
+  {
+    printf("ERROR: FQ row %d bad quantum %s, expects %u..%u bytes or *\n", rowId, token[2], RTE_ETHER_MIN_LEN,
+           UINT16_MAX);
+    return -1;
+  }
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_EBS_DUALQ(SchedConf *sc, int rowId, char *dq_str, TmConf *cf)
+{
+  // EBS:<classic>  EBS:<l4s>  targetUsec|*  stepUsec|*  coupling|*  classicProtectPct|*
+  #define DQ_TOKENS 6
+  char *token[DQ_TOKENS];
+  uint16_t cQid, lQid;
+  uint32_t lo, hi;
+
+  if (parser_opt_str_vals(dq_str, "\t", DQ_TOKENS, token) != DQ_TOKENS)
+    return -1;
+
+  if (rowId != 0)
+  {
+    printf("ERROR: DualQ row %d, only one EBS pair is supported\n", rowId);
+    return -1;
+  }
+  if (app_parse_scf_action_str(token[0], &cQid, cf) != 0 || app_parse_scf_action_str(token[1], &lQid, cf) != 0 ||
+      cQid < QID_EBS_BASE(cf->queuesNum) || lQid < QID_EBS_BASE(cf->queuesNum) || cQid == lQid)
+  {
+    printf("ERROR: DualQ row %d bad EBS pair %s %s\n", rowId, token[0], token[1]);
+    return -1;
+  }
+  DualQConf *dq = &cf->dualq;
+  memset(dq, 0, sizeof(*dq));
+  dq->cClass = (uint8_t) (cQid - QID_EBS_BASE(cf->queuesNum));
+  dq->lClass = (uint8_t) (lQid - QID_EBS_BASE(cf->queuesNum));
+
+  // "*" is the RFC 9332 default, set by TmAqmBuild()
+  if (app_parse_scf_range_str(token[2], US_PER_S, &dq->targetUsec, &hi) != 0 ||
+      (strcmp(token[2], "*") != 0 && (dq->targetUsec != hi || dq->targetUsec == 0)) ||
+      app_parse_scf_range_str(token[3], US_PER_S, &dq->stepUsec, &hi) != 0 ||
+      (strcmp(token[3], "*") != 0 && (dq->stepUsec != hi || dq->stepUsec == 0)))
+  {
+    printf("ERROR: DualQ row %d bad target %s or step %s, expects 1..%u usec or *\n", rowId, token[2], token[3], US_PER_S);
+    return -1;
+  }
+  if (app_parse_scf_range_str(token[4], 64, &lo, &hi) != 0 || (strcmp(token[4], "*") != 0 && (lo != hi || lo == 0)))
+  {
+    printf("ERROR: DualQ row %d bad coupling %s, expects 1..64 or *\n", rowId, token[4]);
+    return -1;
+  }
+  dq->coupling = (strcmp(token[4], "*") != 0) ? (uint16_t) lo : 0;
+  if (app_parse_scf_range_str(token[5], 100, &lo, &hi) != 0 || (strcmp(token[5], "*") != 0 && (lo != hi || lo == 0)))
+  {
+    printf("ERROR: DualQ row %d bad classic protection %s, expects 1..100 %% or *\n", rowId, token[5]);
+    return -1;
+  }
+  dq->cProtectPct = (strcmp(token[5], "*") != 0) ? (uint8_t) lo : 0;
+  dq->enabled = true;
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_EBS_SCHEDULING(SchedConf *sc, int rowId, char *es_str, TmConf *cf)
+{
+  // EBS:<class>  priority  quantumBytes|*  maxRateMbps|*
+  // EBS:*        *         *               maxRateMbps     (cap of all EBS traffic)
+  #define ES_TOKENS 4
+  char *token[ES_TOKENS];
+  uint16_t qid;
+  uint32_t lo, hi, quantum, rate;
+  EbsSchedConf *ec = &cf->ebsSched;
+
+  if (parser_opt_str_vals(es_str, "\t", ES_TOKENS, token) != ES_TOKENS)
+    return -1;
+
+  // "*" leaves the rate uncapped
+  if (app_parse_scf_range_str(token[3], runConf.linkSpeedMbpsConf, &rate, &hi) != 0 ||
+      (strcmp(token[3], "*") != 0 && (rate != hi || rate == 0)))
+  {
+    printf("ERROR: EBS scheduling row %d bad rate %s, expects 1..%u mbps or *\n", rowId, token[3],
+           runConf.linkSpeedMbpsConf);
+    return -1;
+  }
+
+  if (strcmp(token[0], "EBS:*") == 0)
+  {
+    if (strcmp(token[1], "*") != 0 || strcmp(token[2], "*") != 0 || strcmp(token[3], "*") == 0)
+    {
+      printf("ERROR: EBS scheduling row %d, EBS:* only sets the aggregate rate\n", rowId);
+      return -1;
+    }
+    ec->aggRateMbps = rate;
+    return 0;
+  }
+  if (app_parse_scf_action_str(token[0], &qid, cf) != 0 || qid < QID_EBS_BASE(cf->queuesNum))
+  {
+    printf("ERROR: EBS scheduling row %d bad class %s\n", rowId, token[0]);
+    return -1;
+  }
+  uint8_t cls = (uint8_t) (qid - QID_EBS_BASE(cf->queuesNum));
+
+  if (app_parse_scf_range_str(token[1], UINT8_MAX, &lo, &hi) != 0 || lo != hi)
+  {
+    printf("ERROR: EBS scheduling row %d bad priority %s, expects 0..%u\n", rowId, token[1], UINT8_MAX);
+    return -1;
+  }
+  // "*" is maxPktSize, the smallest quantum that serves a backlogged class in each round
+  if (app_parse_scf_range_str(token[2], UINT16_MAX, &quantum, &hi) != 0 ||
+      (strcmp(token[2], "*") != 0 && (quantum != hi || quantum < RTE_ETHER_MIN_LEN)))
+  {
+    printf("ERROR: EBS scheduling row %d bad quantum %s, expects %u..%u bytes or *\n", rowId, token[2],
+           RTE_ETHER_MIN_LEN, UINT16_MAX);
+    return -1;
+  }
+  ec->prio[cls] = (uint8_t) lo;
+  ec->quantum[cls] = quantum;
+  ec->rateMbps[cls] = rate;
+  return 0;
+}
+
+static SCF_ROW_FUNCTION
+app_parse_scf_row_FLOW_ASSIGN(SchedConf *sc, int rowId, char *fa_str, TmConf *cf)
+{
+  // bundleId|*  idleMsec|*
+  #define FA_TOKENS 2
+  char *token[FA_TOKENS];
+  uint32_t bid, bidLast, idleMsec, hi;
+
+  if (parser_opt_str_vals(fa_str, "\t", FA_TOKENS, token) != FA_TOKENS)
+    return -1;
+
+  // A wildcard row assigns the flows of every bundle, later rows override it
+  if (app_parse_scf_range_str(token[0], cf->queuesNum - 1, &bid, &bidLast) != 0)
+  {
+    printf("ERROR: flow assign row %d bad bundle %s, expects 0..%d or *\n", rowId, token[0], cf->queuesNum - 1);
+    return -1;
+  }
+  // "*" is FLOW_ASSIGN_IDLE_USEC_DEFAULT
+  if (app_parse_scf_range_str(token[1], US_PER_S, &idleMsec, &hi) != 0 ||
+      (strcmp(token[1], "*") != 0 && (idleMsec != hi || idleMsec == 0)))
+  {
+    printf("ERROR: flow assign row %d bad idle timeout %s, expects 1..%u msec or *\n", rowId, token[1], US_PER_S);
+    return -1;
+  }
+
+  for (; bid <= bidLast; bid++)
+    cf->flowAssign.idleUsec[bid] = idleMsec ? idleMsec * 1000 : FLOW_ASSIGN_IDLE_USEC_DEFAULT;
+  return 0;
+}
+
+// Rows of the PSS: each counts one timeslot of its bundle, bundle 0 included
+static unsigned
+app_parse_scf_pss_rows(const TmConf *cf)
+{
+  unsigned rows = 0;
+
+  for (uint16_t b = 0; b < cf->queuesNum; b++)
+    rows += (unsigned) cf->bundleConf[b].numTimeslots;
+  return rows;
+}
+
 int
-app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, uint8_t confId)
+app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, TmConf *cf)
 {
   #define LINE_LENGTH_MAX 255
   char line[LINE_LENGTH_MAX+1] = { 0 };
@@ -276,7 +1097,17 @@ app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, uint8_t confId)
     { "[CONFIG_TOPLVL]",           &app_parse_scf_row_CONFIG_TOPLVL },
     { "[GBS_TIMESLOT_QUEUE_MAP]",  &app_parse_scf_row_GBS_PSS },
     { "[GBS_SCHEDULING_RATE]",     &app_parse_scf_row_GBS_SCHEDULING_RATE },
-    { "[GBS_BUNDLE_MAPPING]",      &app_parse_scf_row_GBS_BUNDLE_MAPPING }
+    { "[GBS_BUNDLE_MAPPING]",      &app_parse_scf_row_GBS_BUNDLE_MAPPING },
+    { "[CLASSIFIER_RULES]",        &app_parse_scf_row_CLASSIFIER_RULES },
+    { "[FLOW_TABLE]",              &app_parse_scf_row_FLOW_TABLE },
+    { "[GBS_QUEUE_POLICER]",       &app_parse_scf_row_GBS_QUEUE_POLICER },
+    { "[QUEUE_BUFFER_LIMIT]",      &app_parse_scf_row_QUEUE_BUFFER_LIMIT },
+    { "[QUEUE_BUFFER_SHARING]",    &app_parse_scf_row_QUEUE_BUFFER_SHARING },
+    { "[QUEUE_AQM]",               &app_parse_scf_row_QUEUE_AQM },
+    { "[EBS_DUALQ]",               &app_parse_scf_row_EBS_DUALQ },
+    { "[QUEUE_FQ]",                &app_parse_scf_row_QUEUE_FQ },
+    { "[EBS_SCHEDULING]",          &app_parse_scf_row_EBS_SCHEDULING },
+    { "[FLOW_ASSIGN]",             &app_parse_scf_row_FLOW_ASSIGN }
   };
   #define SCF_SECTMAP_NUM  (sizeof(scfSectMap)/sizeof(scfSectMap[0]))
   SCF_ROW_FNPTR sectFnptr = NULL;
@@ -288,6 +1119,14 @@ app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, uint8_t confId)
     return -1;
   }
 
+  // cf comes zeroed from TmConfAlloc()
+  TmEbsConfReset(sc, cf);
+  if (TmFlowTableReset(sc, cf) != 0)
+  {
+    fclose(file);
+    return -1;
+  }
+
   unsigned s=0;
   while (fgets(line, LINE_LENGTH_MAX, file) != NULL && ret>=0)
   {
@@ -314,11 +1153,18 @@ app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, uint8_t confId)
         printf("ERROR: sched cfgfile %s line#%d has unknown section name %s\n", cfgfile, lines, copied);
         ret = -1;
       }
+      // Only the description may come before the number of queues
+      else if (cf->bundleConf == NULL && sectFnptr != &app_parse_scf_row_CONFIG_DESCRIPTION &&
+               sectFnptr != &app_parse_scf_row_CONFIG_TOPLVL)
+      {
+        printf("ERROR: sched cfgfile %s line#%d section %s before [CONFIG_TOPLVL]\n", cfgfile, lines, copied);
+        ret = -1;
+      }
       continue;
     }
 
     // Invoke its parser function. s:index to scfSectMap[] table; sectRow:index within its section in cfgfile. 
-    ret = scfSectMap[s].fnptr(sc, sectRow, copied, confId);
+    ret = scfSectMap[s].fnptr(sc, sectRow, copied, cf);
     if (ret != 0)
     {
       printf("ERROR: cfgfile %s line#%d parsing failed!\n", cfgfile, lines);
@@ -336,31 +1182,80 @@ app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, uint8_t confId)
   else
   {
     // Sanity check
-    if (sc->timeslotsPerSeq==0 || sc->queuesNum==0 )
+    if (cf->timeslotsPerSeq==0 || cf->queuesNum==0 )
     {
       printf("ERROR: cfgfile %s parsing sanity check failed after %d lines, inconsistent/missing config entries:\n", cfgfile, lines);
-      printf("\ttimeslotsPerSeq: %u\n", sc->timeslotsPerSeq);
-      printf("\tqueuesNum: %u\n", sc->queuesNum);
+      printf("\ttimeslotsPerSeq: %u\n", cf->timeslotsPerSeq);
+      printf("\tqueuesNum: %u\n", cf->queuesNum);
+      ret = -1;
+    }
+    // The lcore roles, queues and time base are set up once from the first config
+    else if (sc->conf != NULL && (cf->schedMode != sc->schedMode || cf->queuesNum != sc->queuesNum ||
+                                  cf->timeslotsPerSeq != sc->timeslotsPerSeq || cf->maxPktSize != sc->maxPktSize))
+    {
+      printf("ERROR: cfgfile %s [CONFIG_TOPLVL] changes the mode, queues, timeslots or max pkt size: restart needed\n", cfgfile);
       ret = -1;
     }
+    else if (app_parse_scf_pss_rows(cf) != cf->timeslotsPerSeq)
+    {
+      printf("ERROR: cfgfile %s [GBS_TIMESLOT_QUEUE_MAP] has %u rows for %u timeslots\n", cfgfile,
+             app_parse_scf_pss_rows(cf), cf->timeslotsPerSeq);
+      ret = -1;
+    }
+    else if (TmClassifierBuild(sc, cf) != 0)
+    {
+      printf("ERROR: cfgfile %s classifier rules could not be compiled\n", cfgfile);
+      ret = -1;
+    }
+    else if (TmPolicerBuild(sc, cf) != 0)
+    {
+      printf("ERROR: cfgfile %s queue policers could not be configured\n", cfgfile);
+      ret = -1;
+    }
+    else if (TmFlowAssignBuild(sc, cf) != 0)
+    {
+      printf("ERROR: cfgfile %s flow assignment tables could not be created\n", cfgfile);
+      ret = -1;
+    }
+    else if (TmFqBuild(sc, cf) != 0)
+    {
+      printf("ERROR: cfgfile %s fair queuing could not be configured\n", cfgfile);
+      ret = -1;
+    }
+    else
+    {
+      TmBufferLimitBuild(sc, cf);
+      TmAqmBuild(sc, cf);
+      TmEbsBuild(sc, cf);
+    }
   }
 
   fclose(file);
   return ret;
 }
 
-// Scheduling Sequence Configuration
-int
-app_parse_scf(uint8_t sid, const char *fname, uint8_t confId)
+// Scheduling Sequence Configuration: a new config to publish with TmConfPublish(), NULL if fname is not valid
+TmConf *
+app_parse_scf(uint8_t sid, const char *fname)
 {
   SchedConf *sc = &schedConf[sid];
 
   printf("Parsing %s\n", fname);
 
-  int ret = app_parse_scf_cfgfile(sc, fname, confId);
+  TmConf *cf = TmConfAlloc(sc);
+  if (cf == NULL)
+  {
+    printf("ERROR: scf file %s config alloc failed for schedId%u!\n", fname, sid);
+    return NULL;
+  }
+  int ret = app_parse_scf_cfgfile(sc, fname, cf);
   if (ret != 0)
-    rte_exit(EXIT_FAILURE, "ERROR: scf file %s parsing failed for schedId%u!\n", fname, sid);
+  {
+    printf("ERROR: scf file %s parsing failed for schedId%u!\n", fname, sid);
+    TmConfFree(cf);
+    return NULL;
+  }
 
-  return 0;
+  return cf;
 }
 
@@ -10,7 +10,7 @@
 #include "parserLib.h"
 
 typedef int CFG_ROW_FUNCTION;
-typedef int (*CFG_ROW_FNPTR)(SchedConf *sc, int row, char *str, uint8_t confId);
+typedef int (*CFG_ROW_FNPTR)(SchedConf *sc, int row, char *str, TmConf *cf);
 
 static int
 parse_ipv4_str(uint8_t *ipv4, char *str)
@@ -20,16 +20,16 @@ parse_ipv4_str(uint8_t *ipv4, char *str)
 }
 
 static CFG_ROW_FUNCTION
-app_parse_cfg_row_CONFIG_DESCRIPTION(SchedConf *dummy, int rowId, char *cd_str, uint8_t confId)
+app_parse_cfg_row_CONFIG_DESCRIPTION(SchedConf *dummy, int rowId, char *cd_str, TmConf *cf)
 {
   // Informational
-  if (dummy && rowId && confId) {}  // avoid compiler warning
+  if (dummy && rowId && cf) {}  // avoid compiler warning
   printf("%s\n", cd_str);
   return 0;
 }
 
 static CFG_ROW_FUNCTION
-app_parse_cfg_row_CONFIG_STREAMS(SchedConf *sc, int rowId, char *tl_str, uint8_t confId)
+app_parse_cfg_row_CONFIG_STREAMS(SchedConf *sc, int rowId, char *tl_str, TmConf *cf)
 {
 #define TL_STREAMTOKENS  10
   char *tokens[TL_STREAMTOKENS];
@@ -55,9 +55,9 @@ app_parse_cfg_row_CONFIG_STREAMS(SchedConf *sc, int rowId, char *tl_str, uint8_t
       rte_exit(EXIT_FAILURE, "ERROR: Bad CONFIG_STREAMS invalid streamId %s, expected 0..%d!\n", token, NUM_STREAMS_MAX);
     }
 
-  if (sc->streamsBaseNum == 0)
+  if (cf->streamsBaseNum == 0)
     {
-      sc->streamsBaseNum = streamId;
+      cf->streamsBaseNum = streamId;
       streamIdNext = streamId;
     }
   if (streamIdNext != streamId)
@@ -65,7 +65,7 @@ app_parse_cfg_row_CONFIG_STREAMS(SchedConf *sc, int rowId, char *tl_str, uint8_t
       rte_exit(EXIT_FAILURE, "ERROR: Bad CONFIG_STREAMS invalid streamId %s, streamId not sequential!\n", token);
     }
 
-  StreamCfg *stream = &sc->streamCfg[confId][STREAM_ID_TO_IDX(streamId)];
+  StreamCfg *stream = &cf->streamCfg[STREAM_ID_TO_IDX(streamId)];
   stream->streamId = streamId;
   streamIdNext++; // streams defintions expected to be sequential
 
@@ -130,13 +130,13 @@ app_parse_cfg_row_CONFIG_STREAMS(SchedConf *sc, int rowId, char *tl_str, uint8_t
   stream->protocol = (uint8_t)IPPROTO_UDP;
   
   // update the number of streams
-  sc->numStreams++;
+  cf->numStreams++;
   
   return 0;
 }
 
 static int
-app_parse_cfg_streamfile(SchedConf *sc, const char *streamfile, uint8_t confId)
+app_parse_cfg_streamfile(SchedConf *sc, const char *streamfile, TmConf *cf)
 {
   #define LINE_LENGTH_MAX 255
   char line[LINE_LENGTH_MAX+1] = { 0 };
@@ -197,7 +197,7 @@ app_parse_cfg_streamfile(SchedConf *sc, const char *streamfile, uint8_t confId)
 
     // Invoke its parser function. s:index to streamSectMap[] table; sectRow:index within its section in streamfile. 
     //printf("DEBUG: Parsing Section [%s]\n", copied);
-    ret = streamSectMap[s].fnptr(sc, sectRow, copied, confId);
+    ret = streamSectMap[s].fnptr(sc, sectRow, copied, cf);
     if (ret != 0)
     {
       printf("ERROR: streamfile %s line#%d parsing failed\n", streamfile, lines);
@@ -225,16 +225,16 @@ app_parse_cfg_streamfile(SchedConf *sc, const char *streamfile, uint8_t confId)
 
 // Parse Stream Configuration File
 int
-app_parse_strmcf(uint8_t sid, const char *fname, uint8_t confId)
+app_parse_strmcf(uint8_t sid, const char *fname, TmConf *cf)
 {
   SchedConf *sc = &schedConf[sid];
 
   printf("Parsing %s\n", fname);
 
-  int ret = app_parse_cfg_streamfile(sc, fname, confId);
+  int ret = app_parse_cfg_streamfile(sc, fname, cf);
   if (ret != 0)
-    rte_exit(EXIT_FAILURE, "ERROR: streamfile %s parsing failed!\n", fname);
+    printf("ERROR: streamfile %s parsing failed!\n", fname);
 
-  return 0;
+  return ret;
 }
 
@@ -8,6 +8,9 @@
 
 #include "tmDefs.h"
 #include "parserLib.h"
+#include "tmBuffer.h"
+#include "tmConf.h"
+#include "tmFlowAssign.h"
 
 #include "../common/OrionDpdk.h"
 #include "../common/OrionLog.h"
@@ -33,6 +36,16 @@ static const char usage[] =
 	"           B = timeslots (default=0 for no limit)                              \n"
 	"    --speed mbps : override link speed                                         \n"
 	"    --promis-off : disable unmatched dstMAC unicast traffic also to DPDK       \n"
+	"    --log-debug : enable debug log messages (DBGLOG)                           \n"
+	"    --flow-mark : classify [FLOW_TABLE] entries in the NIC with rte_flow MARK  \n"
+	"    --rxq N : number of RSS rx queues (default 1, max %u)                      \n"
+	"    --enq-lcores \"A,B,..\" : enqueue lcores in addition to the --pfc one,     \n"
+	"           rx queue q is polled by enqueue lcore (q %% number of enqueue lcores)\n"
+	"    --rxq-poll wrr:W0,W1,.. | sp[:N] : rx queue polling policy (default wrr:1,..)\n"
+	"           wrr = up to Wq consecutive full bursts from rx queue q per round     \n"
+	"           sp  = higher q# first, a lower queue skipped N polls is served first \n"
+	"    --qlat usec : target queueing delay sizing the queue buffer limits not set\n"
+	"           in [QUEUE_BUFFER_LIMIT] (default %u)                                \n"
 	"    --stp sec : Statistics display timer priod in seconds (default is %u)      \n"
 ;
 
@@ -40,7 +53,7 @@ static const char usage[] =
 static void
 app_usage(const char *prgname)
 {
-	printf(usage, prgname, STATS_TIMER_PERIOD_DEFAULT);
+	printf(usage, prgname, NUM_RXQUEUES_MAX, QUEUE_LATENCY_USEC_DEFAULT, STATS_TIMER_PERIOD_DEFAULT);
 }
 
 static int
@@ -90,12 +103,10 @@ app_parse_pfc(const char *pfc_arg)
 	int sid = atoi(tokens[0]);
 	if (sid != 0 || sid>=NUM_SCHED_MAX)
 		rte_exit(EXIT_FAILURE, "ERROR: only 1 scheduler instance supported, got %u!\n", sid); 
+	TmSchedAlloc((uint16_t) atoi(tokens[1]) & 0xff);
 	SchedConf *sc = &schedConf[sid];
 
 	sc->schedId    = (uint8_t) sid;
-	// Set to use initial config
-	sc->confId   = 0;   
-	sc->newConfig   = false;   
 	sc->rxPort  = (uint8_t) atoi(tokens[1]) & 0xff;
         sc->txPort  = (uint8_t) atoi(tokens[2]) & 0xff;
         sc->rxCore  = (uint8_t) atoi(tokens[3]) & 0xff;
@@ -133,13 +144,19 @@ app_parse_pfc(const char *pfc_arg)
           printf("Error getting file stat in file_is_modified ");
         }
         sc->lastUpdateTime = file_stat.st_mtime;
-        // Initial configId is 0
-	ret = app_parse_scf(sc->schedId, sc->schedCfgFile, sc->confId);
-	if (ret)
+	TmConf *cf = app_parse_scf(sc->schedId, sc->schedCfgFile);
+	if (cf == NULL)
 	{
 		RTE_LOG(ERR, PARSER, "Invalid scheduler config file %s parsing of pfc %s\n", scf, pfc_str);
-		return ret;
+		return -1;
 	}
+	// Set up once: a reload keeps them, see app_parse_scf_cfgfile()
+	sc->schedMode = cf->schedMode;
+	sc->queuesNum = cf->queuesNum;
+	sc->timeslotsPerSeq = cf->timeslotsPerSeq;
+	sc->maxPktSize = cf->maxPktSize;
+	TmSchedTablesAlloc(sc);
+	TmConfPublish(sc, cf);
 #if 0
 	// parse stream config file
 	uint32_t strmcfLenMax = sizeof(sc->streamCfgFile) - 1;
@@ -149,7 +166,7 @@ app_parse_pfc(const char *pfc_arg)
 		return -1;
 	}
 	memcpy(sc->streamCfgFile, strmcf, strmcfLenMax);
-	ret = app_parse_strmcf(sc->schedId, sc->streamCfgFile, sc->confId); // Update stream cfg
+	ret = app_parse_strmcf(sc->schedId, sc->streamCfgFile, sc->conf); // Update stream cfg
 	if (ret)
 	{
 		RTE_LOG(ERR, PARSER, "Invalid stream config file %s parsing of pfc %s\n", strmcf, pfc_str);
@@ -164,6 +181,71 @@ app_parse_pfc(const char *pfc_arg)
 	return 0;
 }
 
+static uint32_t enqLcores[NUM_ENQ_LCORES_MAX - 1];
+static int numEnqLcores;
+
+static int
+app_parse_enq_lcores(const char *lcores_str)
+{
+	numEnqLcores = parser_opt_int_vals(lcores_str, ',', NUM_ENQ_LCORES_MAX - 1, enqLcores);
+	if (numEnqLcores < 1)
+		return -1;
+	for (int i=0; i<numEnqLcores; i++)
+	{
+		if (enqLcores[i] >= RTE_MAX_LCORE || !rte_lcore_is_enabled(enqLcores[i]))
+		{
+			printf("ERROR: enqueue lcore %u is not enabled\n", enqLcores[i]);
+			return -1;
+		}
+		// Each enqueue lcore polls its own rx queue, a duplicate would leave one unpolled
+		for (int j=0; j<i; j++)
+		{
+			if (enqLcores[j] == enqLcores[i])
+			{
+				printf("ERROR: enqueue lcore %u listed twice\n", enqLcores[i]);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+static int
+app_parse_rxq_poll(const char *poll_str)
+{
+	uint32_t vals[NUM_RXQUEUES_MAX];
+
+	if (strncmp(poll_str, "wrr:", 4) == 0)
+	{
+		int n = parser_opt_int_vals(poll_str + 4, ',', NUM_RXQUEUES_MAX, vals);
+		if (n < 1)
+			return -1;
+		for (int q=0; q<NUM_RXQUEUES_MAX; q++)
+		{
+			uint32_t w = (q < n) ? vals[q] : 1;
+			if (w == 0 || w > UINT16_MAX)
+				return -1;
+			runConf.rxqWeight[q] = (uint16_t) w;
+		}
+		runConf.rxqPollMode = RXQ_POLL_WRR;
+		return 0;
+	}
+	if (strcmp(poll_str, "sp") == 0)
+	{
+		runConf.rxqPollMode = RXQ_POLL_SP;
+		return 0;
+	}
+	if (strncmp(poll_str, "sp:", 3) == 0)
+	{
+		if (parser_opt_int_vals(poll_str + 3, ',', 1, vals) != 1 || vals[0] == 0 || vals[0] > UINT16_MAX)
+			return -1;
+		runConf.rxqPollMode = RXQ_POLL_SP;
+		runConf.rxqStarveLimit = (uint16_t) vals[0];
+		return 0;
+	}
+	return -1;
+}
+
 static int
 app_parse_lim(const char *lim_str)
 {
@@ -200,6 +282,12 @@ parse_args(int argc, char **argv)
 		PARSED_OPTION_STP	= 0x0004,
 		PARSED_OPTION_LIM	= 0x0008,
 		PARSED_OPTION_PROMIS	= 0x0010,
+		PARSED_OPTION_LOGDEBUG	= 0x0020,
+		PARSED_OPTION_FLOWMARK	= 0x0040,
+		PARSED_OPTION_RXQ	= 0x0080,
+		PARSED_OPTION_ENQLCORES	= 0x0100,
+		PARSED_OPTION_RXQPOLL	= 0x0200,
+		PARSED_OPTION_QLAT	= 0x0400,
 		PARSED_OPTION_HELP	= 0x8000
 	};
 
@@ -213,6 +301,12 @@ parse_args(int argc, char **argv)
 		{ "stp", 1, NULL, 0 },
 		{ "lim", 1, NULL, 0 },
 		{ "promis-off", 0, NULL, 0 },
+		{ "log-debug", 0, NULL, 0 },
+		{ "flow-mark", 0, NULL, 0 },
+		{ "rxq", 1, NULL, 0 },
+		{ "enq-lcores", 1, NULL, 0 },
+		{ "rxq-poll", 1, NULL, 0 },
+		{ "qlat", 1, NULL, 0 },
 		{ "help", 0, NULL, 0 },
 		{ NULL,  0, NULL, 0 }
 	};
@@ -258,6 +352,64 @@ parse_args(int argc, char **argv)
 					parsedOptionsMask |= PARSED_OPTION_PROMIS;
 					break;
 				}
+				else if (strcmp(optname, "log-debug")==0)
+				{
+					debugLog = 1;
+					parsedOptionsMask |= PARSED_OPTION_LOGDEBUG;
+					break;
+				}
+				else if (strcmp(optname, "flow-mark")==0)
+				{
+					runConf.flowMarkOffload = true;
+					parsedOptionsMask |= PARSED_OPTION_FLOWMARK;
+					break;
+				}
+				else if (strcmp(optname, "rxq")==0)
+				{
+					int rxq = atoi(optarg);
+					if (rxq < 1 || rxq > NUM_RXQUEUES_MAX)
+					{
+						RTE_LOG(ERR, PARSER, "Invalid rxq %s, expected 1..%u\n", optarg, NUM_RXQUEUES_MAX);
+						return -1;
+					}
+					runConf.rxqNum = (uint16_t) rxq;
+					parsedOptionsMask |= PARSED_OPTION_RXQ;
+					break;
+				}
+				else if (strcmp(optname, "enq-lcores")==0)
+				{
+					ret = app_parse_enq_lcores(optarg);
+					if (ret)
+					{
+						RTE_LOG(ERR, PARSER, "Invalid parsing of enq-lcores %s\n", optarg);
+						return -1;
+					}
+					parsedOptionsMask |= PARSED_OPTION_ENQLCORES;
+					break;
+				}
+				else if (strcmp(optname, "rxq-poll")==0)
+				{
+					ret = app_parse_rxq_poll(optarg);
+					if (ret)
+					{
+						RTE_LOG(ERR, PARSER, "Invalid parsing of rxq-poll %s\n", optarg);
+						return -1;
+					}
+					parsedOptionsMask |= PARSED_OPTION_RXQPOLL;
+					break;
+				}
+				else if (strcmp(optname, "qlat")==0)
+				{
+					int usec = atoi(optarg);
+					if (usec < 1 || usec > 1000000)
+					{
+						RTE_LOG(ERR, PARSER, "Invalid qlat %s, expected 1..1000000 usec\n", optarg);
+						return -1;
+					}
+					runConf.queueLatencyUsec = (uint32_t) usec;
+					parsedOptionsMask |= PARSED_OPTION_QLAT;
+					break;
+				}
 				else if (strcmp(optname, "speed")==0)
 				{
 					int speed = sched_parse_speed(optarg);
@@ -304,5 +456,26 @@ parse_args(int argc, char **argv)
 		rte_exit(EXIT_FAILURE, "Bye...\n");
 	}
 
+	// Enqueue lcores: the --pfc rxCore first, then the --enq-lcores list
+	SchedConf *sc = &schedConf[0];
+	sc->rxCores[0] = sc->rxCore;
+	sc->numRxCores = 1;
+	for (int i=0; i<numEnqLcores; i++)
+	{
+		if (enqLcores[i] == sc->rxCore || enqLcores[i] == sc->tmCore || enqLcores[i] == sc->txCore ||
+		    enqLcores[i] == rte_get_main_lcore())
+			rte_exit(EXIT_FAILURE, "ERROR: enqueue lcore %u already has another role!\n", enqLcores[i]);
+		sc->rxCores[sc->numRxCores++] = (uint8_t) enqLcores[i];
+	}
+	if (runConf.rxqNum < sc->numRxCores)
+		rte_exit(EXIT_FAILURE, "ERROR: %u enqueue lcores need at least as many rx queues, got --rxq %u!\n",
+			 sc->numRxCores, runConf.rxqNum);
+
+	// Derived queue limits depend on --qlat and --speed
+	TmBufferLimitBuild(sc, sc->conf);
+	// One flow assignment table per enqueue lcore
+	if (TmFlowAssignBuild(sc, sc->conf) != 0)
+		rte_exit(EXIT_FAILURE, "ERROR: flow assignment tables could not be created!\n");
+
 	return 0;
 }
@@ -24,9 +24,11 @@ int parser_opt_int_vals(const char *conf_str, char separator, uint32_t n_vals, u
 int parser_opt_str_vals(char *conf_str, const char *separator, uint32_t n_vals, char *token[]);
 int parser_dupstr(char *new, char *orig, int max);	// Make copy of original string and rid off trailing \n with NULL
 
+struct TmConf_s;
+
 int app_parse_icf(uint8_t sid, const char *fname);
-int app_parse_scf(uint8_t sid, const char *fname, uint8_t confId);
+struct TmConf_s *app_parse_scf(uint8_t sid, const char *fname);  // NULL if not valid, see TmConfPublish()
 //int app_parse_strmcf(uint8_t sid, const char *fname);
-int app_parse_strmcf(uint8_t sid, const char *fname, uint8_t confId);  // Update stream cfg
+int app_parse_strmcf(uint8_t sid, const char *fname, struct TmConf_s *cf);  // Update stream cfg
 
 #endif  // End of _PARSER_LIB_H_
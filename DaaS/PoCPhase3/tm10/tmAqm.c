@@ -0,0 +1,335 @@
+/* tmAqm.c
+**
+** Active queue management of the scheduler queues. The dequeue lcore applies CoDel (RFC 8289) or
+** PIE (RFC 8033) to each pkt taken from a [QUEUE_AQM] queue, on the sojourn time since its ingress
+** timestamp OrionMbufMeta::rxRtsc. A congestion signal CE marks ECN-capable pkts or drops them.
+** An [EBS_DUALQ] pair of EBS classes is instead run as a DualPI2 coupled AQM (RFC 9332): one PI
+** base probability p' signals the classic queue with p'^2 and the L4S queue with k * p', the L4S
+** queue is also step marked above a shallow sojourn threshold.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include "tmAqm.h"
+#include "tmBuffer.h"
+#include "tmPkt.h"
+
+#define AQM_PIE_ALPHA           0.125   // Hz, weight of the delay error
+#define AQM_PIE_BETA            1.25    // Hz, weight of the delay trend
+#define AQM_PIE_ECN_PROB_MAX    0.1     // above this probability ECN-capable pkts are dropped too
+#define AQM_DUALQ_ALPHA         0.16    // Hz
+#define AQM_DUALQ_BETA          3.2     // Hz
+
+static inline uint64_t
+TmAqmUsecToTsc(uint32_t usec)
+{
+  return (uint64_t) usec * rte_get_tsc_hz() / US_PER_S;
+}
+
+void
+TmAqmBuild(SchedConf *sc, TmConf *cf)
+{
+  unsigned numAqm = 0;
+
+  for (uint16_t qid = 0; qid < NUM_QIDS(cf->queuesNum); qid++)
+    {
+      AqmConf *ac = &cf->aqmConf[qid];
+      if (ac->mode == AQM_NONE)
+        continue;
+      if (ac->targetUsec == 0)
+        ac->targetUsec = (ac->mode == AQM_CODEL) ? AQM_CODEL_TARGET_USEC_DEFAULT : AQM_PIE_TARGET_USEC_DEFAULT;
+      if (ac->intervalUsec == 0)
+        ac->intervalUsec = (ac->mode == AQM_CODEL) ? AQM_CODEL_INTERVAL_USEC_DEFAULT : AQM_PIE_TUPDATE_USEC_DEFAULT;
+      ac->targetTsc = TmAqmUsecToTsc(ac->targetUsec);
+      ac->intervalTsc = TmAqmUsecToTsc(ac->intervalUsec);
+      numAqm++;
+    }
+  if (numAqm != 0)
+    printf("Conf #%u: %u queues with AQM\n", cf->version, numAqm);
+
+  DualQConf *dq = &cf->dualq;
+  if (dq->enabled)
+    {
+      if (dq->targetUsec == 0)
+        dq->targetUsec = DUALQ_TARGET_USEC_DEFAULT;
+      if (dq->stepUsec == 0)
+        dq->stepUsec = DUALQ_STEP_USEC_DEFAULT;
+      if (dq->coupling == 0)
+        dq->coupling = DUALQ_COUPLING_DEFAULT;
+      if (dq->cProtectPct == 0)
+        dq->cProtectPct = DUALQ_C_PROTECT_PCT_DEFAULT;
+      dq->targetTsc = TmAqmUsecToTsc(dq->targetUsec);
+      dq->stepTsc = TmAqmUsecToTsc(dq->stepUsec);
+      dq->tupdateTsc = TmAqmUsecToTsc(DUALQ_TUPDATE_USEC);
+      dq->lStreakMax = (uint16_t) (100 / dq->cProtectPct - 1);
+      printf("Conf #%u: DualQ classic EBS %u L4S EBS %u, target %u us step %u us k %u\n", cf->version, dq->cClass,
+             dq->lClass, dq->targetUsec, dq->stepUsec, dq->coupling);
+    }
+}
+
+// Uniform in [0, 1) from the top 53 bits
+static inline double
+TmAqmRand(void)
+{
+  return (double) (rte_rand() >> 11) * 0x1.0p-53;
+}
+
+// Congestion signal: CE mark if allowed and the pkt is ECN-capable, otherwise drop
+static int
+TmAqmSignal(struct rte_mbuf *mbuf, bool markOk, DequeueThreadStats *ds)
+{
+  PktL3Info pi;
+
+  if (markOk && TmPktParseL3(mbuf, &pi) && TmPktMarkCE(&pi))
+    {
+      ds->aqmMarks++;
+      return AQM_MARK;
+    }
+  rte_pktmbuf_free(mbuf);
+  ds->aqmDrops++;
+  return AQM_DROP;
+}
+
+// Integer square root, only evaluated on a CoDel signal
+static uint64_t
+TmAqmIsqrt(uint64_t x)
+{
+  uint64_t r = 0;
+  for (uint64_t b = 1ULL << 62; b != 0; b >>= 2)
+    {
+      if (x >= r + b)
+        {
+          x -= r + b;
+          r = (r >> 1) + b;
+        }
+      else
+        r >>= 1;
+    }
+  return r;
+}
+
+// CoDel control law: next signal interval / sqrt(count) after t
+static inline uint64_t
+TmAqmCodelControlLaw(const AqmConf *ac, uint64_t t, uint32_t count)
+{
+  // sqrt(count << 32) is sqrt(count) << 16
+  return t + (ac->intervalTsc << 16) / TmAqmIsqrt((uint64_t) count << 32);
+}
+
+static bool
+TmAqmCodelShouldSignal(const AqmConf *ac, AqmState *as, uint64_t sojourn, uint64_t qbytes, uint32_t maxPktSize,
+                       uint64_t now)
+{
+  // Below target, or too little left to keep the link busy
+  if (sojourn < ac->targetTsc || qbytes <= maxPktSize)
+    {
+      as->codel.firstAboveTsc = 0;
+      return false;
+    }
+  if (as->codel.firstAboveTsc == 0)
+    {
+      as->codel.firstAboveTsc = now + ac->intervalTsc;
+      return false;
+    }
+  return now >= as->codel.firstAboveTsc;
+}
+
+static bool
+TmAqmCodel(const AqmConf *ac, AqmState *as, uint64_t sojourn, uint64_t qbytes, uint32_t maxPktSize, uint64_t now)
+{
+  bool okToSignal = TmAqmCodelShouldSignal(ac, as, sojourn, qbytes, maxPktSize, now);
+
+  if (as->codel.dropping)
+    {
+      if (!okToSignal)
+        {
+          as->codel.dropping = false;
+          return false;
+        }
+      if (now < as->codel.dropNextTsc)
+        return false;
+      as->codel.count++;
+      as->codel.dropNextTsc = TmAqmCodelControlLaw(ac, as->codel.dropNextTsc, as->codel.count);
+      return true;
+    }
+  if (!okToSignal)
+    return false;
+
+  // Enter the dropping state, resuming near the previous signal rate if it was left recently
+  uint32_t delta = as->codel.count - as->codel.lastCount;
+  as->codel.dropping = true;
+  as->codel.count = (delta > 1 && (int64_t) (now - as->codel.dropNextTsc) < (int64_t) (16 * ac->intervalTsc)) ?
+                    delta : 1;
+  as->codel.lastCount = as->codel.count;
+  as->codel.dropNextTsc = TmAqmCodelControlLaw(ac, now, as->codel.count);
+  return true;
+}
+
+// PIE probability update, every AqmConf::intervalTsc while the queue is served
+static void
+TmAqmPieUpdate(const AqmConf *ac, AqmState *as, uint64_t qdelay, bool idle)
+{
+  double hz = (double) rte_get_tsc_hz();
+  double prob = as->pie.prob;
+  double p = AQM_PIE_ALPHA * ((double) qdelay - (double) ac->targetTsc) / hz +
+             AQM_PIE_BETA * ((double) qdelay - (double) as->pie.qdelayOldTsc) / hz;
+
+  // Smaller steps while the probability is low
+  if (prob < 0.000001)
+    p /= 2048;
+  else if (prob < 0.00001)
+    p /= 512;
+  else if (prob < 0.0001)
+    p /= 128;
+  else if (prob < 0.001)
+    p /= 32;
+  else if (prob < 0.01)
+    p /= 8;
+  else if (prob < 0.1)
+    p /= 2;
+  if (prob >= 0.1 && p > 0.02)
+    p = 0.02;
+  prob += p;
+
+  // Decay once the queue drained
+  if (idle && as->pie.qdelayOldTsc < ac->targetTsc / 2)
+    prob *= 0.98;
+  as->pie.prob = RTE_MAX(RTE_MIN(prob, 1.0), 0.0);
+
+  if (as->pie.burstAllowanceTsc > 0)
+    as->pie.burstAllowanceTsc -= (int64_t) ac->intervalTsc;
+  else if (as->pie.prob == 0.0 && qdelay < ac->targetTsc / 2 && as->pie.qdelayOldTsc < ac->targetTsc / 2)
+    as->pie.burstAllowanceTsc = (int64_t) TmAqmUsecToTsc(AQM_PIE_MAX_BURST_USEC);
+  as->pie.qdelayOldTsc = qdelay;
+}
+
+static bool
+TmAqmPie(const AqmConf *ac, AqmState *as, uint64_t sojourn, uint64_t qbytes, uint32_t maxPktSize, uint64_t now)
+{
+  if (now - as->pie.lastUpdateTsc >= ac->intervalTsc)
+    {
+      TmAqmPieUpdate(ac, as, sojourn, qbytes == 0);
+      as->pie.lastUpdateTsc = now;
+    }
+
+  if (as->pie.burstAllowanceTsc > 0)
+    return false;
+  if (as->pie.qdelayOldTsc < ac->targetTsc / 2 && as->pie.prob < 0.2)
+    return false;
+  if (qbytes <= 2 * (uint64_t) maxPktSize)
+    return false;
+  return TmAqmRand() < as->pie.prob;
+}
+
+int
+TmAqmDequeue(SchedConf *sc, SchedState *ss, const TmConf *cf, uint16_t qid, struct rte_mbuf *mbuf, uint64_t rtscNow)
+{
+  const AqmConf *ac = &cf->aqmConf[qid];
+  AqmState *as = &ss->aqm[qid];
+
+  if (ac->mode == AQM_NONE)
+    return AQM_PASS;
+
+  // (Re)start from an idle state when the queue's AQM is first used or changed by a reload
+  if (unlikely(as->mode != ac->mode))
+    {
+      memset(as, 0, sizeof(*as));
+      as->mode = ac->mode;
+      if (ac->mode == AQM_PIE)
+        {
+          as->pie.burstAllowanceTsc = (int64_t) TmAqmUsecToTsc(AQM_PIE_MAX_BURST_USEC);
+          as->pie.lastUpdateTsc = rtscNow;
+        }
+    }
+
+  uint64_t rxRtsc = ORION_MBUF_META(mbuf)->rxRtsc;
+  uint64_t sojourn = (rtscNow > rxRtsc) ? rtscNow - rxRtsc : 0;
+  uint64_t qbytes = TmBufferOccBytes(ss, qid);
+
+  if (ac->mode == AQM_CODEL)
+    {
+      if (TmAqmCodel(ac, as, sojourn, qbytes, sc->maxPktSize, rtscNow))
+        return TmAqmSignal(mbuf, ac->ecn, &ss->STATS_DEQUEUE);
+    }
+  else
+    {
+      if (TmAqmPie(ac, as, sojourn, qbytes, sc->maxPktSize, rtscNow))
+        return TmAqmSignal(mbuf, ac->ecn && as->pie.prob <= AQM_PIE_ECN_PROB_MAX, &ss->STATS_DEQUEUE);
+    }
+  return AQM_PASS;
+}
+
+int
+TmAqmDualQSelect(SchedState *ss, const TmConf *cf)
+{
+  const DualQConf *dq = &cf->dualq;
+  DualQState *ds = &ss->dualq;
+  bool lBacklog = TmBufferQueueActive(ss, QID_EBS(ss->queuesNum, dq->lClass));
+  bool cBacklog = TmBufferQueueActive(ss, QID_EBS(ss->queuesNum, dq->cClass));
+
+  // L4S first, but a backlogged classic queue gets one in lStreakMax + 1 services
+  if (!cBacklog)
+    return lBacklog ? dq->lClass : dq->cClass;
+  if (!lBacklog || ds->lStreak >= dq->lStreakMax)
+    {
+      ds->lStreak = 0;
+      return dq->cClass;
+    }
+  ds->lStreak++;
+  return dq->lClass;
+}
+
+// DualPI2 base probability update, every DUALQ_TUPDATE_USEC on the larger of the two queueing delays
+static void
+TmAqmDualQUpdate(const DualQConf *dq, DualQState *ds, SchedState *ss)
+{
+  double hz = (double) rte_get_tsc_hz();
+  uint64_t qdelayC = (TmBufferOccBytes(ss, QID_EBS(ss->queuesNum, dq->cClass)) != 0) ? ds->sojournTsc[0] : 0;
+  uint64_t qdelayL = (TmBufferOccBytes(ss, QID_EBS(ss->queuesNum, dq->lClass)) != 0) ? ds->sojournTsc[1] : 0;
+  uint64_t qdelay = RTE_MAX(qdelayC, qdelayL);
+
+  double prob = ds->prob + AQM_DUALQ_ALPHA * ((double) qdelay - (double) dq->targetTsc) / hz +
+                AQM_DUALQ_BETA * ((double) qdelay - (double) ds->qdelayOldTsc) / hz;
+  ds->prob = RTE_MAX(RTE_MIN(prob, 1.0), 0.0);
+  ds->qdelayOldTsc = qdelay;
+}
+
+int
+TmAqmDualQDequeue(SchedState *ss, const TmConf *cf, bool l4s, struct rte_mbuf *mbuf, uint64_t rtscNow)
+{
+  const DualQConf *dq = &cf->dualq;
+  DualQState *ds = &ss->dualq;
+  DequeueThreadStats *dstats = &ss->STATS_DEQUEUE;
+
+  uint64_t rxRtsc = ORION_MBUF_META(mbuf)->rxRtsc;
+  uint64_t sojourn = (rtscNow > rxRtsc) ? rtscNow - rxRtsc : 0;
+  ds->sojournTsc[l4s] = sojourn;
+
+  if (rtscNow - ds->lastUpdateTsc >= dq->tupdateTsc)
+    {
+      TmAqmDualQUpdate(dq, ds, ss);
+      ds->lastUpdateTsc = rtscNow;
+    }
+
+  if (l4s)
+    {
+      // Native step marking on the shallow L4S queue, or the coupled classic probability
+      if (sojourn >= dq->stepTsc || TmAqmRand() < RTE_MIN(ds->prob * dq->coupling, 1.0))
+        {
+          dstats->dualqLSignals++;
+          return TmAqmSignal(mbuf, true, dstats);
+        }
+      return AQM_PASS;
+    }
+
+  // Classic: p'^2 as two independent draws below p'; ECT(0) pkts are marked, others dropped
+  if (TmAqmRand() < ds->prob && TmAqmRand() < ds->prob)
+    {
+      dstats->dualqCSignals++;
+      return TmAqmSignal(mbuf, true, dstats);
+    }
+  return AQM_PASS;
+}
@@ -0,0 +1,54 @@
+/* tmAqm.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_AQM_H_
+#define TM_AQM_H_
+
+#include <inttypes.h>
+
+#include "tmDefs.h"
+#include "tmPkt.h"
+
+enum AqmVerdict_e
+{
+  AQM_PASS,
+  AQM_MARK,                            // pkt CE marked, to be sent
+  AQM_DROP                             // pkt freed by TmAqmDequeue()
+};
+
+void TmAqmBuild(SchedConf *sc, TmConf *cf);                                  // Convert cf->aqmConf times to tsc
+
+/*
+ * Dequeue lcore: AQM verdict on pkt mbuf just taken from queue qid, with rtscNow the current tsc relative
+ * to the epoch. The caller must skip a pkt returned as AQM_DROP.
+ */
+int TmAqmDequeue(SchedConf *sc, SchedState *ss, const TmConf *cf, uint16_t qid, struct rte_mbuf *mbuf, uint64_t rtscNow);
+
+int TmAqmDualQSelect(SchedState *ss, const TmConf *cf);                       // EBS class of the DualQ pair to serve
+
+/*
+ * Dequeue lcore: DualPI2 verdict on pkt mbuf just taken from the L4S (l4s true) or classic queue of the
+ * [EBS_DUALQ] pair. The caller must skip a pkt returned as AQM_DROP.
+ */
+int TmAqmDualQDequeue(SchedState *ss, const TmConf *cf, bool l4s, struct rte_mbuf *mbuf, uint64_t rtscNow);
+
+// Enqueue lcores: ECT(1) and CE pkts classified to the classic class of the DualQ pair go to its L4S class
+static inline uint16_t
+TmAqmDualQSteer(const TmConf *cf, uint16_t qid, struct rte_mbuf *mbuf)
+{
+  const DualQConf *dq = &cf->dualq;
+  PktL3Info pi;
+
+  if (likely(!dq->enabled) || qid != QID_EBS(cf->queuesNum, dq->cClass))
+    return qid;
+  if (TmPktParseL3(mbuf, &pi) && (pi.tos & 0x01))
+    return QID_EBS(cf->queuesNum, dq->lClass);
+  return qid;
+}
+
+#endif // TM_AQM_H_
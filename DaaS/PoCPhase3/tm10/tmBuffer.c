@@ -0,0 +1,106 @@
+/* tmBuffer.c
+**
+** Scheduler queue buffer limits. Each GBS queue and EBS class is tail dropped by the enqueue lcores
+** at a packet and a byte limit, from [QUEUE_BUFFER_LIMIT] or derived from the queue rate and the
+** "--qlat" target queueing delay. The rxRings are sized from the limits at start-up. The ECN marking
+** threshold of each queue is also kept in bytes, from a queueing delay.
+** All the queues draw from the rx port mbuf pool: beyond its reserved mbufs a queue is also dropped at a
+** dynamic threshold (Choudhury-Hahne) of alpha times the free shared mbufs, so that no queue can exhaust
+** the pool while an idle pool is still available to a single queue.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include "tmBuffer.h"
+#include "tmBundle.h"
+#include "../common/OrionLog.h"
+
+static struct rte_ring *
+TmBufferRing(SchedState *ss, uint16_t qid)
+{
+  return (ss->rxRing != NULL) ? ss->rxRing[qid] : NULL;
+}
+
+void
+TmBufferLimitBuild(SchedConf *sc, TmConf *cf)
+{
+  SchedState *ss = &schedState[sc->schedId];
+  uint64_t reserveTotal = 0;
+
+  for (uint16_t qid = 0; qid < NUM_QIDS(cf->queuesNum); qid++)
+    {
+      // No queue between the last GBS qid and the EBS classes
+      if (qid == cf->queuesNum)
+        qid = QID_EBS_BASE(cf->queuesNum);
+
+      const QueueLimit *qc = &cf->queueLimitConf[qid];
+      QueueLimit *ql = &cf->queueLimit[qid];
+
+      // GBS queues drain at their bundle rate, EBS classes at most at the link rate
+      uint32_t rateMbps = (qid < cf->queuesNum) ? bundleRateOfQueue(cf, qid) : runConf.linkSpeedMbpsConf;
+      uint64_t bytes = (uint64_t) rateMbps * runConf.queueLatencyUsec / 8;
+      bytes = RTE_MAX(bytes, (uint64_t) QUEUE_LIMIT_PKTS_MIN * cf->maxPktSize);
+      if (qc->maxBytes != 0)
+        bytes = qc->maxBytes;
+
+      // A derived pkt limit lets the byte limit bind for any pkt size
+      uint64_t pkts = (qc->maxPkts != 0) ? qc->maxPkts : RTE_MAX(bytes / RTE_ETHER_MIN_LEN, QUEUE_LIMIT_PKTS_MIN);
+      pkts = RTE_MIN(pkts, QUEUE_LIMIT_PKTS_MAX);
+
+      // Rings exist once the dequeue lcore started: a reload cannot grow them
+      struct rte_ring *ring = TmBufferRing(ss, qid);
+      if (ring != NULL && pkts > rte_ring_get_capacity(ring))
+        {
+          printf("WARNING: qid %u limit of %"PRIu64" pkts capped to its rxRing capacity %u\n",
+                 qid, pkts, rte_ring_get_capacity(ring));
+          pkts = rte_ring_get_capacity(ring);
+        }
+
+      ql->maxPkts = (uint32_t) pkts;
+      ql->maxBytes = (uint32_t) RTE_MIN(bytes, UINT32_MAX);
+
+      // ECN marking threshold: the queueing delay at the queue rate, marks on bytes whatever the pkt sizes
+      ql->ecnUsec = (qc->ecnUsec != 0) ? qc->ecnUsec : cf->ecnThresholdUsec;
+      ql->ecnBytes = (uint32_t) RTE_MIN((uint64_t) rateMbps * ql->ecnUsec / 8, UINT32_MAX);
+      if (ql->ecnUsec != 0 && ql->ecnBytes == 0)
+        ql->ecnBytes = 1;  // unrated queue: mark whenever it holds a backlog
+
+      // Shared buffer: GBS queues of a rated bundle keep a minimum and get a larger share by default
+      if (qid < cf->queuesNum)
+        {
+          ql->dtAlpha = qc->dtAlpha ? qc->dtAlpha : BUF_DT_ALPHA_GBS_DEFAULT;
+          ql->reservePkts = qc->reservePkts ? qc->reservePkts : ((qid != QID_DROP && rateMbps != 0) ? QUEUE_LIMIT_PKTS_MIN : 0);
+          ql->reservePkts = RTE_MIN(ql->reservePkts, ql->maxPkts);
+        }
+      else
+        {
+          ql->dtAlpha = qc->dtAlpha ? qc->dtAlpha : BUF_DT_ALPHA_EBS_DEFAULT;
+          ql->reservePkts = 0;
+        }
+      reserveTotal += ql->reservePkts;
+
+      if (rateMbps != 0 || qc->maxPkts != 0 || qc->maxBytes != 0)
+        DBGLOG("Conf #%u: qid %u limit %u pkts %u bytes, ECN from %u bytes, reserve %u pkts alpha %.2f\n", cf->version, qid,
+               ql->maxPkts, ql->maxBytes, ql->ecnBytes, ql->reservePkts, (double) ql->dtAlpha / (1 << BUF_DT_ALPHA_SHIFT));
+    }
+
+  uint32_t poolPkts = TM_MBUF_POOL_SIZE - TM_MBUF_POOL_HEADROOM;
+  if (reserveTotal >= poolPkts)
+    {
+      printf("WARNING: Conf #%u: GBS reserves of %"PRIu64" pkts leave no shared mbufs out of %u\n", cf->version, reserveTotal,
+             poolPkts);
+      reserveTotal = poolPkts;
+    }
+  cf->bufSharedPkts = poolPkts - (uint32_t) reserveTotal;
+  printf("Conf #%u: %u shared mbufs, %"PRIu64" reserved\n", cf->version, cf->bufSharedPkts, reserveTotal);
+}
+
+uint32_t
+TmBufferRingSize(const SchedConf *sc, uint16_t qid)
+{
+  // rte_ring capacity is its size - 1
+  return rte_align32pow2(sc->conf->queueLimit[qid].maxPkts + 1);
+}
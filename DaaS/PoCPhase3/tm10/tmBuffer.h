@@ -0,0 +1,175 @@
+/* tmBuffer.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_BUFFER_H_
+#define TM_BUFFER_H_
+
+#include <inttypes.h>
+
+#include "tmDefs.h"
+
+void TmBufferLimitBuild(SchedConf *sc, TmConf *cf);                          // Resolve cf->queueLimit from cf->queueLimitConf
+
+uint32_t TmBufferRingSize(const SchedConf *sc, uint16_t qid);                // rxRing size holding the current limit of qid
+
+// Bytes held by scheduler queue qid. The In counters are added before the ring enqueue, so reading the
+// Out counters first never yields a negative occupancy.
+static inline uint64_t
+TmBufferOccBytes(SchedState *ss, uint16_t qid)
+{
+  QueueOcc *o = &ss->queueOcc[qid];
+  uint64_t out = __atomic_load_n(&o->bytesOut, __ATOMIC_ACQUIRE);
+  return __atomic_load_n(&o->bytesIn, __ATOMIC_RELAXED) - out;
+}
+
+// Pkts and bytes held by scheduler queue qid
+static inline void
+TmBufferOcc(SchedState *ss, uint16_t qid, uint32_t *pkts, uint64_t *bytes)
+{
+  QueueOcc *o = &ss->queueOcc[qid];
+  uint64_t bytesOut = __atomic_load_n(&o->bytesOut, __ATOMIC_ACQUIRE);
+  uint64_t pktsOut = __atomic_load_n(&o->pktsOut, __ATOMIC_ACQUIRE);
+  *pkts = (uint32_t) (__atomic_load_n(&o->pktsIn, __ATOMIC_RELAXED) - pktsOut);
+  *bytes = __atomic_load_n(&o->bytesIn, __ATOMIC_RELAXED) - bytesOut;
+}
+
+// Pkts held by scheduler queue qid
+static inline uint32_t
+TmBufferOccPkts(SchedState *ss, uint16_t qid)
+{
+  QueueOcc *o = &ss->queueOcc[qid];
+  uint64_t out = __atomic_load_n(&o->pktsOut, __ATOMIC_ACQUIRE);
+  return (uint32_t) (__atomic_load_n(&o->pktsIn, __ATOMIC_RELAXED) - out);
+}
+
+// Pkts held by all the scheduler queues
+static inline uint32_t
+TmBufferUsed(SchedState *ss)
+{
+  uint64_t out = __atomic_load_n(&ss->bufOcc.pktsOut, __ATOMIC_ACQUIRE);
+  return (uint32_t) (__atomic_load_n(&ss->bufOcc.pktsIn, __ATOMIC_RELAXED) - out);
+}
+
+// Free shared mbufs seen by an enqueue burst. Pkts held within the reserves are counted as shared use too,
+// so that the reserves stay available whatever the shared use.
+static inline uint32_t
+TmBufferFree(const TmConf *cf, SchedState *ss)
+{
+  uint32_t used = TmBufferUsed(ss);
+  return (used < cf->bufSharedPkts) ? cf->bufSharedPkts - used : 0;
+}
+
+// Enqueue lcores: pkts and bytes offered to the rxRing of qid, negative for those the ring then rejected
+static inline void
+TmBufferOccEnq(SchedState *ss, uint16_t qid, int32_t pkts, int64_t bytes)
+{
+  __atomic_fetch_add(&ss->queueOcc[qid].bytesIn, (uint64_t) bytes, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&ss->queueOcc[qid].pktsIn, (uint64_t) (int64_t) pkts, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&ss->bufOcc.pktsIn, (uint64_t) (int64_t) pkts, __ATOMIC_RELAXED);
+}
+
+// Dequeue lcore: true if qid may hold pkts. A set bit may still precede the pkts in the ring, so a dequeue
+// can find the ring empty. Queues found empty since the last TmBufferActiveFlush() are not active.
+static inline bool
+TmBufferQueueActive(SchedState *ss, uint16_t qid)
+{
+  uint64_t active = __atomic_load_n(&ss->activeMap[qid / 64], __ATOMIC_RELAXED) & ~ss->activeEmpty[qid / 64];
+  return (active >> (qid % 64)) & 1;
+}
+
+// Dequeue lcore: EBS classes that may hold pkts, bit c for class c
+static inline uint32_t
+TmBufferEbsActive(SchedState *ss)
+{
+  // QID_EBS_BASE() is a multiple of TM_NUM_CLASSES: the classes never straddle two words
+  RTE_BUILD_BUG_ON(64 % TM_NUM_CLASSES != 0);
+  uint16_t base = QID_EBS_BASE(ss->queuesNum);
+  uint64_t active = __atomic_load_n(&ss->activeMap[base / 64], __ATOMIC_RELAXED) & ~ss->activeEmpty[base / 64];
+  return (uint32_t) (active >> (base % 64)) & ((1u << TM_NUM_CLASSES) - 1);
+}
+
+// Enqueue lcores: the activeMap words of the queues that got pkts in one rx burst. A burst hits at most
+// TM_RX_PKT_BURST_MAX queues, whatever the size of the map.
+typedef struct ActiveBatch_s
+{
+  uint16_t numWords;
+  uint16_t word[TM_RX_PKT_BURST_MAX];
+  uint64_t bits[TM_RX_PKT_BURST_MAX];
+} ActiveBatch;
+
+static inline void
+TmBufferActiveAdd(ActiveBatch *ab, uint16_t qid)
+{
+  uint16_t w = qid / 64;
+  uint16_t i;
+
+  for (i = 0; i < ab->numWords && ab->word[i] != w; i++);
+  if (i == ab->numWords)
+    {
+      ab->word[i] = w;
+      ab->bits[i] = 0;
+      ab->numWords++;
+    }
+  ab->bits[i] |= 1ull << (qid % 64);
+}
+
+// Enqueue lcores: mark the qids of ab non-empty once their pkts are in the rings, one atomic per word
+static inline void
+TmBufferActiveSet(SchedState *ss, const ActiveBatch *ab)
+{
+  for (uint16_t i = 0; i < ab->numWords; i++)
+    __atomic_fetch_or(&ss->activeMap[ab->word[i]], ab->bits[i], __ATOMIC_RELEASE);
+}
+
+// Dequeue lcore: a read of qid came back empty. Its bit is cleared by the next TmBufferActiveFlush().
+static inline void
+TmBufferActiveEmpty(SchedState *ss, uint16_t qid)
+{
+  ss->activeEmpty[qid / 64] |= 1ull << (qid % 64);
+  ss->activeEmptyAny = true;
+}
+
+// Dequeue lcore: clear the bits of the queues found empty, one atomic per word, then set back those that
+// hold pkts again. An enqueue racing with the clear is either seen by the occupancy read or sets the bit
+// after it. The enqueue lcores' occupancy lines are only read for queues that came back empty.
+static inline void
+TmBufferActiveFlush(SchedState *ss)
+{
+  if (likely(!ss->activeEmptyAny))
+    return;
+  ss->activeEmptyAny = false;
+  for (unsigned w = 0; w < ss->activeWords; w++)
+    {
+      uint64_t empty = ss->activeEmpty[w];
+      if (likely(empty == 0))
+        continue;
+      ss->activeEmpty[w] = 0;
+      __atomic_fetch_and(&ss->activeMap[w], ~empty, __ATOMIC_SEQ_CST);
+      uint64_t busy = 0;
+      for (uint64_t m = empty; m != 0; m &= m - 1)
+        {
+          unsigned b = (unsigned) __builtin_ctzll(m);
+          if (TmBufferOccPkts(ss, (uint16_t) (w * 64 + b)) != 0)
+            busy |= 1ull << b;
+        }
+      if (busy != 0)
+        __atomic_fetch_or(&ss->activeMap[w], busy, __ATOMIC_RELAXED);
+    }
+}
+
+// Dequeue lcore: a pkt of the given bytes taken from the rxRing of qid
+static inline void
+TmBufferOccDeq(SchedState *ss, uint16_t qid, uint32_t bytes)
+{
+  QueueOcc *o = &ss->queueOcc[qid];
+  __atomic_store_n(&o->bytesOut, o->bytesOut + bytes, __ATOMIC_RELEASE);
+  __atomic_store_n(&o->pktsOut, o->pktsOut + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&ss->bufOcc.pktsOut, ss->bufOcc.pktsOut + 1, __ATOMIC_RELEASE);
+}
+
+#endif // TM_BUFFER_H_
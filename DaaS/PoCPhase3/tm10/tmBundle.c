@@ -7,70 +7,87 @@
 */
 
 #include "tmBundle.h"
+#include "tmBuffer.h"
  
-#define INT32_CEILING (1E9)
-#define INT64_CEILING (1E18)
+#define INT32_CEILING INT32_C(1000000000)
+#define INT64_CEILING INT64_C(1000000000000000000)
 
-uint16_t lastQueueServed[NUM_GBSQUEUES_MAX];          // index, not id, of the last queue served for each bundle
-
-void initBundles(void)
-{
-  for (int i = 0; i < NUM_GBSQUEUES_MAX; i++)
-  {
-    lastQueueServed[i] = NO_QUEUE;
-  }
-}
-
-bool bundleQueuesAreEmpty(SchedState *ss, BundleConf *bc)
+bool bundleQueuesAreEmpty(SchedState *ss, const BundleConf *bc)
 {
   bool isEmpty = true;
   for (int i = 0; i < bc->numQueues; i++)
   {
     uint16_t qid  = bc->queues[i];
-    //#if 0
-    if ( !rte_ring_empty(ss->gbsQueue[0][qid].rxRing) )
+    if ( TmBufferQueueActive(ss, qid) )
     {
       isEmpty = false;
       break;
     }
-    //#endif
   }
   return isEmpty;
 }
 
-uint16_t getNextQueueToServed(BundleConf *bc)
+// Pass the turn to the next queue of the bundle, which gets its quantum
+static inline void bundleDrrNext(SchedConf *sc, const BundleConf *bc, BundleDrr *drr)
 {
-  uint16_t qid  = NO_QUEUE;
-  uint16_t qidx;
+  drr->cur = (drr->cur + 1 < bc->numQueues) ? drr->cur + 1 : 0;
+  drr->deficit[drr->cur] += bc->quantum[drr->cur] ? (int32_t) bc->quantum[drr->cur] : sc->maxPktSize;
+}
+
+uint16_t getNextQueueToServed(SchedConf *sc, const BundleConf *bc, BundleState *bs)
+{
+  BundleDrr *drr = &bs->drr;
 
-  // if bundle has never been served before, start at the beginning
-  if (lastQueueServed[bc->bid] == NO_QUEUE)                          
+  // A reload may have shrunk the bundle
+  if (unlikely(drr->cur >= bc->numQueues))
   {
-    qidx = 0;
+    drr->cur = 0;
   }
-  // otherwise increment idx
-  else
+
+  // The queue keeps the turn while its deficit is positive; a pkt is served whatever its size and charged
+  // afterwards, so no head of line peek is needed
+  while (drr->deficit[drr->cur] <= 0)
+  {
+    bundleDrrNext(sc, bc, drr);
+  }
+
+  return bc->queues[drr->cur];
+}
+
+void bundleQueueServed(BundleState *bs, uint32_t pktLen)
+{
+  bs->drr.deficit[bs->drr.cur] -= (int32_t) pktLen;
+}
+
+void bundleQueueSkipped(SchedConf *sc, const BundleConf *bc, BundleState *bs, bool empty)
+{
+  // An idle queue does not bank quanta
+  if (empty && bs->drr.deficit[bs->drr.cur] > 0)
   {
-    qidx = lastQueueServed[bc->bid] + 1;
+    bs->drr.deficit[bs->drr.cur] = 0;
   }
+  bundleDrrNext(sc, bc, &bs->drr);
+}
 
-  // if at the end, move to the beginning
-  if (qidx >= bc->numQueues)
+uint32_t bundleRateOfQueue(const TmConf *cf, uint16_t qid)
+{
+  for (int b = 0; b < cf->queuesNum; b++)
   {
-    qidx = 0;
+    const BundleConf *bc = &cf->bundleConf[b];
+    for (int i = 0; i < bc->numQueues; i++)
+    {
+      if (bc->queues[i] == qid)
+        return bc->schedRate;
+    }
   }
-  
-  lastQueueServed[bc->bid] = qidx;
-  qid  = bc->queues[qidx];
-  
-  return qid;
+  return 0;
 }
 
-void increasePathCredit(SchedConf *sc, PathState *ps, int32_t numTimeslots, uint64_t rtscCurr)
+void increasePathCredit(SchedConf *sc, PathState *ps, int32_t numTimeslots, uint64_t rtscUpdate)
 {
   /// Update credit counter for the current bundle
   int64_t creditths = (int64_t) sc->timeslotTsc * sc->timeslotsPerSeq;  // credit limit (same for paths and bundles)
-  int64_t gbsCredit = (int64_t) (rtscCurr - ps->pathCredit.lastRtsc) * numTimeslots;
+  int64_t gbsCredit = (int64_t) (rtscUpdate - ps->pathCredit.lastRtsc) * numTimeslots;
 
   // First bring the credit value within an acceptable range
   if (unlikely(gbsCredit >= INT64_CEILING))
@@ -95,7 +112,7 @@ void increasePathCredit(SchedConf *sc, PathState *ps, int32_t numTimeslots, uint
     }
 
   // Set the time of latest update
-  ps->pathCredit.lastRtsc = rtscCurr;
+  ps->pathCredit.lastRtsc = rtscUpdate;
 }
 
 void decreasePathCredit(SchedConf *sc, PathState *ps, uint64_t txtimeTsc)
@@ -103,11 +120,11 @@ void decreasePathCredit(SchedConf *sc, PathState *ps, uint64_t txtimeTsc)
   ps->pathCredit.value -= (sc->timeslotsPerSeq * txtimeTsc);
 }
 
-void increaseBundleCredit(SchedConf *sc, BundleState *bs, int32_t numTimeslots, uint64_t rtscCurr)
+void increaseBundleCredit(SchedConf *sc, BundleState *bs, int32_t numTimeslots, uint64_t rtscUpdate)
 {
   // Update credit counter for the current bundle
   int64_t creditths = (int64_t) sc->timeslotTsc * sc->timeslotsPerSeq;                  // credit limit
-  int64_t gbsCredit = (int64_t) (rtscCurr - bs->bundleCredit.lastRtsc) * numTimeslots;
+  int64_t gbsCredit = (int64_t) (rtscUpdate - bs->bundleCredit.lastRtsc) * numTimeslots;
 
   // First bring the credit value within an acceptable range
   if (unlikely(gbsCredit >= INT64_CEILING))
@@ -132,7 +149,7 @@ void increaseBundleCredit(SchedConf *sc, BundleState *bs, int32_t numTimeslots,
     }
 
   // Set the time of latest update
-  bs->bundleCredit.lastRtsc = rtscCurr;
+  bs->bundleCredit.lastRtsc = rtscUpdate;
 }
 
 
@@ -141,11 +158,11 @@ void decreaseBundleCredit(SchedConf *sc, BundleState *bs, uint64_t txtimeTsc)
   bs->bundleCredit.value -= (sc->timeslotsPerSeq * txtimeTsc);
 }
 
-void increaseQueueCredit(SchedConf *sc, QueueState *qs, int32_t numTimeslots, uint64_t rtscCurr)
+void increaseQueueCredit(SchedConf *sc, QueueState *qs, int32_t numTimeslots, uint64_t rtscUpdate)
 {
   // Update credit counter for the current queue
   int64_t creditths = (int64_t) sc->timeslotTsc * sc->timeslotsPerSeq;                  // credit limit
-  int64_t gbsCredit = (int64_t) (rtscCurr - qs->queueCredit.lastRtsc) * numTimeslots;
+  int64_t gbsCredit = (int64_t) (rtscUpdate - qs->queueCredit.lastRtsc) * numTimeslots;
 
   // First bring the credit increment value within an acceptable range
   if (unlikely(gbsCredit >= INT64_CEILING))
@@ -165,13 +182,13 @@ void increaseQueueCredit(SchedConf *sc, QueueState *qs, int32_t numTimeslots, ui
       // See if the available credits have exceeded the maximum allowed
       if (unlikely(qs->queueCredit.value > creditths))
 	{
-	  //DBGLOG("credit saturated for slot#%u,queue=%u at tsc %18"PRIu64"\n", ss->timeslotIdx, gbsQIdx, rtscCurr);
+	  //DBGLOG("credit saturated for slot#%u,queue=%u at tsc %18"PRIu64"\n", ss->timeslotIdx, gbsQIdx, rtscUpdate);
 	  qs->queueCredit.value = creditths;
 	}
     }
 
   // Set the time of latest update
-  qs->queueCredit.lastRtsc = rtscCurr;
+  qs->queueCredit.lastRtsc = rtscUpdate;
 }
 
 void decreaseQueueCredit(SchedConf *sc, QueueState *qs)
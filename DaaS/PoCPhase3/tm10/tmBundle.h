@@ -15,21 +15,34 @@
 
 #define NO_QUEUE        0xFFFF
 
-void initBundles(void);
+// Wire time in TSC tics of the given bytes, framing included, rounded to the nearest tic. A multiply
+// rather than the double division by linkSpeedBpMTsc on every served pkt.
+static inline uint64_t txTimeTsc(const SchedConf *sc, uint64_t bytes)
+{
+  return (bytes * sc->txTscPerByteQ24 + (UINT64_C(1) << (TX_TSC_SHIFT - 1))) >> TX_TSC_SHIFT;
+}
 
-bool bundleQueuesAreEmpty(SchedState *ss, BundleConf *bc);                   // All queues in bundle are empty
+bool bundleQueuesAreEmpty(SchedState *ss, const BundleConf *bc);             // All queues in bundle are empty
 
-uint16_t getNextQueueToServed(BundleConf *bc);                               // Get the next queue (in RR) that should be served
+uint16_t getNextQueueToServed(SchedConf *sc, const BundleConf *bc, BundleState *bs); // Get the next queue (in DRR) that should be served
 
-void increasePathCredit(SchedConf *sc, PathState *ps, int32_t numTimeslots, uint64_t rtscCurr);
+void bundleQueueServed(BundleState *bs, uint32_t pktLen);                    // Charge a pkt of the queue returned by getNextQueueToServed()
 
-void decreasePathCredit(SchedConf *sc, PathState *ps, uint64_t rtscCurr);
+void bundleQueueSkipped(SchedConf *sc, const BundleConf *bc, BundleState *bs, bool empty); // Queue returned by getNextQueueToServed() could not be served
 
-void increaseBundleCredit(SchedConf *sc, BundleState *bs, int32_t numTimeslots, uint64_t rtscCurr);
+uint32_t bundleRateOfQueue(const TmConf *cf, uint16_t qid);                   // Scheduling rate in mbps of the bundle of GBS queue qid, 0 if unmapped
 
-void decreaseBundleCredit(SchedConf *sc, BundleState *bs, uint64_t rtscCurr);
+// Credits accrue numTimeslots tsc per tsc elapsed from the previous update to rtscUpdate, the dequeue
+// decision time relative to SchedState::tscEpoch, and are capped at one scheduling sequence.
+void increasePathCredit(SchedConf *sc, PathState *ps, int32_t numTimeslots, uint64_t rtscUpdate);
 
-void increaseQueueCredit(SchedConf *sc, QueueState *qs, int32_t numTimeslots, uint64_t txtimeTsc);
+void decreasePathCredit(SchedConf *sc, PathState *ps, uint64_t txtimeTsc);
+
+void increaseBundleCredit(SchedConf *sc, BundleState *bs, int32_t numTimeslots, uint64_t rtscUpdate);
+
+void decreaseBundleCredit(SchedConf *sc, BundleState *bs, uint64_t txtimeTsc);
+
+void increaseQueueCredit(SchedConf *sc, QueueState *qs, int32_t numTimeslots, uint64_t rtscUpdate);
 
 void decreaseQueueCredit(SchedConf *sc, QueueState *qs);
 
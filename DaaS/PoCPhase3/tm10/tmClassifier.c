@@ -0,0 +1,376 @@
+/* tmClassifier.c
+**
+** Multi-field rule classifier. The [CLASSIFIER_RULES] of the scheduler config file are
+** compiled into one rte_acl context per address family, each classifying a whole rx burst
+** in a single call.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include <rte_acl.h>
+
+#include "tmClassifier.h"
+#include "tmPkt.h"
+
+// Search key built from the packet headers. rte_acl reads it in 4-byte groups, with the first field one byte long.
+// Multi-byte fields are kept in network byte order as required by rte_acl_classify().
+typedef struct TmAclKey_s
+{
+  uint8_t  proto;
+  uint8_t  dscp;
+  uint16_t vlanTci;                    // 0 if untagged
+  uint32_t srcIp;
+  uint32_t dstIp;
+  uint16_t srcPort;                    // 0 if not UDP/TCP
+  uint16_t dstPort;
+} __rte_packed TmAclKey;
+
+enum
+{
+  ACL_FIELD_PROTO,
+  ACL_FIELD_DSCP,
+  ACL_FIELD_VLANTCI,
+  ACL_FIELD_SRCIP,
+  ACL_FIELD_DSTIP,
+  ACL_FIELD_SRCPORT,
+  ACL_FIELD_DSTPORT,
+  ACL_NUM_FIELDS
+};
+
+RTE_ACL_RULE_DEF(TmAclRule, ACL_NUM_FIELDS);
+
+// IPv6 search key, addresses are matched as four 32-bit words each
+typedef struct TmAcl6Key_s
+{
+  uint8_t  proto;
+  uint8_t  dscp;
+  uint16_t vlanTci;                    // 0 if untagged
+  uint8_t  srcIp[16];
+  uint8_t  dstIp[16];
+  uint16_t srcPort;                    // 0 if not UDP/TCP
+  uint16_t dstPort;
+  uint32_t flowLabel;
+} __rte_packed TmAcl6Key;
+
+enum
+{
+  ACL6_FIELD_PROTO,
+  ACL6_FIELD_DSCP,
+  ACL6_FIELD_VLANTCI,
+  ACL6_FIELD_SRCIP0, ACL6_FIELD_SRCIP1, ACL6_FIELD_SRCIP2, ACL6_FIELD_SRCIP3,
+  ACL6_FIELD_DSTIP0, ACL6_FIELD_DSTIP1, ACL6_FIELD_DSTIP2, ACL6_FIELD_DSTIP3,
+  ACL6_FIELD_SRCPORT,
+  ACL6_FIELD_DSTPORT,
+  ACL6_FIELD_FLOWLABEL,
+  ACL6_NUM_FIELDS
+};
+
+RTE_ACL_RULE_DEF(TmAcl6Rule, ACL6_NUM_FIELDS);
+
+static const struct rte_acl_field_def aclFieldDefs[ACL_NUM_FIELDS] =
+{
+  { .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint8_t),  .field_index = ACL_FIELD_PROTO,   .input_index = 0, .offset = offsetof(TmAclKey, proto) },
+  { .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint8_t),  .field_index = ACL_FIELD_DSCP,    .input_index = 0, .offset = offsetof(TmAclKey, dscp) },
+  { .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint16_t), .field_index = ACL_FIELD_VLANTCI, .input_index = 0, .offset = offsetof(TmAclKey, vlanTci) },
+  { .type = RTE_ACL_FIELD_TYPE_MASK,    .size = sizeof(uint32_t), .field_index = ACL_FIELD_SRCIP,   .input_index = 1, .offset = offsetof(TmAclKey, srcIp) },
+  { .type = RTE_ACL_FIELD_TYPE_MASK,    .size = sizeof(uint32_t), .field_index = ACL_FIELD_DSTIP,   .input_index = 2, .offset = offsetof(TmAclKey, dstIp) },
+  { .type = RTE_ACL_FIELD_TYPE_RANGE,   .size = sizeof(uint16_t), .field_index = ACL_FIELD_SRCPORT, .input_index = 3, .offset = offsetof(TmAclKey, srcPort) },
+  { .type = RTE_ACL_FIELD_TYPE_RANGE,   .size = sizeof(uint16_t), .field_index = ACL_FIELD_DSTPORT, .input_index = 3, .offset = offsetof(TmAclKey, dstPort) },
+};
+
+#define ACL6_IP_FIELD_DEF(_field, _input, _member, _word) \
+  { .type = RTE_ACL_FIELD_TYPE_MASK, .size = sizeof(uint32_t), .field_index = (_field), .input_index = (_input), \
+    .offset = offsetof(TmAcl6Key, _member) + (_word) * sizeof(uint32_t) }
+
+static const struct rte_acl_field_def acl6FieldDefs[ACL6_NUM_FIELDS] =
+{
+  { .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint8_t),  .field_index = ACL6_FIELD_PROTO,     .input_index = 0, .offset = offsetof(TmAcl6Key, proto) },
+  { .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint8_t),  .field_index = ACL6_FIELD_DSCP,      .input_index = 0, .offset = offsetof(TmAcl6Key, dscp) },
+  { .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint16_t), .field_index = ACL6_FIELD_VLANTCI,   .input_index = 0, .offset = offsetof(TmAcl6Key, vlanTci) },
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_SRCIP0, 1, srcIp, 0),
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_SRCIP1, 2, srcIp, 1),
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_SRCIP2, 3, srcIp, 2),
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_SRCIP3, 4, srcIp, 3),
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_DSTIP0, 5, dstIp, 0),
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_DSTIP1, 6, dstIp, 1),
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_DSTIP2, 7, dstIp, 2),
+  ACL6_IP_FIELD_DEF(ACL6_FIELD_DSTIP3, 8, dstIp, 3),
+  { .type = RTE_ACL_FIELD_TYPE_RANGE,   .size = sizeof(uint16_t), .field_index = ACL6_FIELD_SRCPORT,   .input_index = 9, .offset = offsetof(TmAcl6Key, srcPort) },
+  { .type = RTE_ACL_FIELD_TYPE_RANGE,   .size = sizeof(uint16_t), .field_index = ACL6_FIELD_DSTPORT,   .input_index = 9, .offset = offsetof(TmAcl6Key, dstPort) },
+  { .type = RTE_ACL_FIELD_TYPE_BITMASK, .size = sizeof(uint32_t), .field_index = ACL6_FIELD_FLOWLABEL, .input_index = 10, .offset = offsetof(TmAcl6Key, flowLabel) },
+};
+
+// Create the context on first use, otherwise empty it for a new set of rules
+static struct rte_acl_ctx *
+TmAclCtxPrepare(struct rte_acl_ctx **pctx, const char *name, uint32_t numFields)
+{
+  if (*pctx == NULL)
+    {
+      struct rte_acl_param param =
+      {
+        .name = name,
+        .socket_id = SOCKET_ID_ANY,
+        .rule_size = RTE_ACL_RULE_SZ(numFields),
+        .max_rule_num = CLASSIFIER_RULES_MAX,
+      };
+      *pctx = rte_acl_create(&param);
+      if (*pctx == NULL)
+        printf("ERROR: rte_acl_create(%s) failed: %s\n", name, rte_strerror(rte_errno));
+    }
+  else
+    {
+      rte_acl_reset(*pctx);
+    }
+  return *pctx;
+}
+
+static int
+TmAclCtxCompile(struct rte_acl_ctx *ctx, const struct rte_acl_field_def *defs, uint32_t numFields, uint16_t numRules)
+{
+  struct rte_acl_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.num_categories = 1;
+  cfg.num_fields = numFields;
+  memcpy(cfg.defs, defs, numFields * sizeof(defs[0]));
+
+  int ret = rte_acl_build(ctx, &cfg);
+  if (ret != 0)
+    printf("ERROR: rte_acl_build() failed for %u classifier rules: %d\n", numRules, ret);
+  return ret;
+}
+
+static inline void
+TmAclRuleData(struct rte_acl_rule_data *data, const ClassifierRule *cr)
+{
+  data->category_mask = 1;
+  data->priority = RTE_ACL_RULE_MAX_PRIORITY - CLASSIFIER_RULES_MAX + RTE_MIN(cr->priority, CLASSIFIER_RULES_MAX - 1);
+  data->userdata = (uint32_t) cr->qid + 1;                         // 0 is reserved by rte_acl for "no match"
+}
+
+static int
+TmClassifierAdd4(struct rte_acl_ctx *ctx, const ClassifierRule *cr)
+{
+  struct TmAclRule ar;
+  memset(&ar, 0, sizeof(ar));
+  TmAclRuleData(&ar.data, cr);
+
+  ar.field[ACL_FIELD_PROTO].value.u8          = cr->proto;
+  ar.field[ACL_FIELD_PROTO].mask_range.u8     = cr->protoMask;
+  ar.field[ACL_FIELD_DSCP].value.u8           = cr->dscp;
+  ar.field[ACL_FIELD_DSCP].mask_range.u8      = cr->dscpMask;
+  ar.field[ACL_FIELD_VLANTCI].value.u16       = cr->vlanTci;
+  ar.field[ACL_FIELD_VLANTCI].mask_range.u16  = cr->vlanTciMask;
+  ar.field[ACL_FIELD_SRCIP].value.u32         = cr->srcIp;
+  ar.field[ACL_FIELD_SRCIP].mask_range.u32    = cr->srcIpPrefix;
+  ar.field[ACL_FIELD_DSTIP].value.u32         = cr->dstIp;
+  ar.field[ACL_FIELD_DSTIP].mask_range.u32    = cr->dstIpPrefix;
+  ar.field[ACL_FIELD_SRCPORT].value.u16       = cr->srcPortLo;
+  ar.field[ACL_FIELD_SRCPORT].mask_range.u16  = cr->srcPortHi;
+  ar.field[ACL_FIELD_DSTPORT].value.u16       = cr->dstPortLo;
+  ar.field[ACL_FIELD_DSTPORT].mask_range.u16  = cr->dstPortHi;
+
+  return rte_acl_add_rules(ctx, (const struct rte_acl_rule *) &ar, 1);
+}
+
+// Split an IPv6 address and prefix length into the four 32-bit ACL fields starting at field
+static inline void
+TmAcl6IpFields(struct rte_acl_field *field, const uint8_t ip[16], uint8_t prefix)
+{
+  for (int w = 0; w < 4; w++)
+    {
+      const uint8_t *b = &ip[w * 4];
+      int bits = (int) prefix - w * 32;
+      field[w].value.u32 = ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+      field[w].mask_range.u32 = (uint32_t) RTE_MAX(0, RTE_MIN(bits, 32));
+    }
+}
+
+static int
+TmClassifierAdd6(struct rte_acl_ctx *ctx, const ClassifierRule *cr)
+{
+  struct TmAcl6Rule ar;
+  memset(&ar, 0, sizeof(ar));
+  TmAclRuleData(&ar.data, cr);
+
+  ar.field[ACL6_FIELD_PROTO].value.u8            = cr->proto;
+  ar.field[ACL6_FIELD_PROTO].mask_range.u8       = cr->protoMask;
+  ar.field[ACL6_FIELD_DSCP].value.u8             = cr->dscp;
+  ar.field[ACL6_FIELD_DSCP].mask_range.u8        = cr->dscpMask;
+  ar.field[ACL6_FIELD_VLANTCI].value.u16         = cr->vlanTci;
+  ar.field[ACL6_FIELD_VLANTCI].mask_range.u16    = cr->vlanTciMask;
+  TmAcl6IpFields(&ar.field[ACL6_FIELD_SRCIP0], cr->srcIp6, cr->srcIpPrefix);
+  TmAcl6IpFields(&ar.field[ACL6_FIELD_DSTIP0], cr->dstIp6, cr->dstIpPrefix);
+  ar.field[ACL6_FIELD_SRCPORT].value.u16         = cr->srcPortLo;
+  ar.field[ACL6_FIELD_SRCPORT].mask_range.u16    = cr->srcPortHi;
+  ar.field[ACL6_FIELD_DSTPORT].value.u16         = cr->dstPortLo;
+  ar.field[ACL6_FIELD_DSTPORT].mask_range.u16    = cr->dstPortHi;
+  ar.field[ACL6_FIELD_FLOWLABEL].value.u32       = cr->flowLabel;
+  ar.field[ACL6_FIELD_FLOWLABEL].mask_range.u32  = cr->flowLabelMask;
+
+  return rte_acl_add_rules(ctx, (const struct rte_acl_rule *) &ar, 1);
+}
+
+int
+TmClassifierBuild(SchedConf *sc, TmConf *cf)
+{
+  uint16_t numRules = cf->numClassifierRules;
+  uint16_t num4 = 0, num6 = 0;
+  char name[RTE_ACL_NAMESIZE];
+
+  cf->aclFamilies = 0;
+  for (uint16_t r = 0; r < numRules; r++)
+    {
+      num4 += (cf->classifierRule[r].family & CR_FAMILY_IPV4) ? 1 : 0;
+      num6 += (cf->classifierRule[r].family & CR_FAMILY_IPV6) ? 1 : 0;
+    }
+
+  // A family without rules is left to the legacy classifier. The contexts are named after the config
+  // version, so that they can be built while the previous config is in use.
+  if (num4 != 0)
+    {
+      snprintf(name, sizeof(name), "tmAcl-%u-v%u", sc->schedId, cf->version);
+      struct rte_acl_ctx *ctx = TmAclCtxPrepare(&cf->aclCtx, name, ACL_NUM_FIELDS);
+      if (ctx == NULL)
+        return -1;
+      for (uint16_t r = 0; r < numRules; r++)
+        {
+          ClassifierRule *cr = &cf->classifierRule[r];
+          if ((cr->family & CR_FAMILY_IPV4) == 0)
+            continue;
+          int ret = TmClassifierAdd4(ctx, cr);
+          if (ret != 0)
+            {
+              printf("ERROR: rte_acl_add_rules() failed for classifier rule %u: %d\n", r, ret);
+              return -1;
+            }
+        }
+      if (TmAclCtxCompile(ctx, aclFieldDefs, ACL_NUM_FIELDS, num4) != 0)
+        return -1;
+    }
+
+  if (num6 != 0)
+    {
+      snprintf(name, sizeof(name), "tmAcl6-%u-v%u", sc->schedId, cf->version);
+      struct rte_acl_ctx *ctx = TmAclCtxPrepare(&cf->aclCtx6, name, ACL6_NUM_FIELDS);
+      if (ctx == NULL)
+        return -1;
+      for (uint16_t r = 0; r < numRules; r++)
+        {
+          ClassifierRule *cr = &cf->classifierRule[r];
+          if ((cr->family & CR_FAMILY_IPV6) == 0)
+            continue;
+          int ret = TmClassifierAdd6(ctx, cr);
+          if (ret != 0)
+            {
+              printf("ERROR: rte_acl_add_rules() failed for IPv6 classifier rule %u: %d\n", r, ret);
+              return -1;
+            }
+        }
+      if (TmAclCtxCompile(ctx, acl6FieldDefs, ACL6_NUM_FIELDS, num6) != 0)
+        return -1;
+    }
+
+  cf->aclFamilies = (num4 ? CR_FAMILY_IPV4 : 0) | (num6 ? CR_FAMILY_IPV6 : 0);
+  if (numRules != 0)
+    printf("Conf #%u: %u classifier rules compiled (%u IPv4, %u IPv6)\n", cf->version, numRules, num4, num6);
+  return 0;
+}
+
+// Fill the ACL search key of one IPv4 packet
+static inline void
+TmClassifierKey(const PktL3Info *pi, uint16_t vlanTci, TmAclKey *key)
+{
+  Ipv4Hdr *ipv4Hdr = (Ipv4Hdr *) pi->l3Hdr;
+  key->proto   = pi->proto;
+  key->dscp    = TOS_TO_DSCP(pi->tos);
+  key->vlanTci = vlanTci;
+  key->srcIp   = ipv4Hdr->src_addr;
+  key->dstIp   = ipv4Hdr->dst_addr;
+  key->srcPort = 0;
+  key->dstPort = 0;
+}
+
+// Fill the ACL search key of one IPv6 packet
+static inline void
+TmClassifierKey6(const PktL3Info *pi, uint16_t vlanTci, TmAcl6Key *key)
+{
+  Ipv6Hdr *ipv6Hdr = (Ipv6Hdr *) pi->l3Hdr;
+  key->proto     = pi->proto;
+  key->dscp      = TOS_TO_DSCP(pi->tos);
+  key->vlanTci   = vlanTci;
+  memcpy(key->srcIp, ipv6Hdr->src_addr, sizeof(key->srcIp));
+  memcpy(key->dstIp, ipv6Hdr->dst_addr, sizeof(key->dstIp));
+  key->srcPort   = 0;
+  key->dstPort   = 0;
+  key->flowLabel = rte_cpu_to_be_32(pi->flowLabel);
+}
+
+void
+TmClassifierBurst(struct rte_acl_ctx *ctx, struct rte_acl_ctx *ctx6, uint8_t families,
+                  struct rte_mbuf **mbufs, uint16_t *qids, uint16_t num)
+{
+  TmAclKey keys[num];
+  TmAcl6Key keys6[num];
+  const uint8_t *data[num], *data6[num];
+  uint32_t results[num];
+  uint16_t idx[num], idx6[num];
+  uint16_t n = 0, n6 = 0;
+
+  for (uint16_t i = 0; i < num; i++)
+    {
+      PktL3Info pi;
+      if (qids[i] != QID_NONE || !TmPktParseL3(mbufs[i], &pi))
+        continue;
+
+      char *pkt = rte_pktmbuf_mtod(mbufs[i], char *);
+      uint16_t vlanTci = is_vlan_pkt(pkt) ? get_vlanhdr_ptr(pkt)->tci : 0;
+      // NOTE: The srcPort and dstPort are in same L4 offset location for UDP and TCP headers!!
+      UdpHdr *l4Hdr = (pi.l4Hdr && (pi.proto == IPPROTO_UDP || pi.proto == IPPROTO_TCP)) ? (UdpHdr *) pi.l4Hdr : NULL;
+
+      if (pi.ipVersion == 4 && (families & CR_FAMILY_IPV4))
+        {
+          TmClassifierKey(&pi, vlanTci, &keys[n]);
+          if (l4Hdr)
+            {
+              keys[n].srcPort = l4Hdr->src_port;
+              keys[n].dstPort = l4Hdr->dst_port;
+            }
+          data[n] = (const uint8_t *) &keys[n];
+          idx[n++] = i;
+        }
+      else if (pi.ipVersion == 6 && (families & CR_FAMILY_IPV6))
+        {
+          TmClassifierKey6(&pi, vlanTci, &keys6[n6]);
+          if (l4Hdr)
+            {
+              keys6[n6].srcPort = l4Hdr->src_port;
+              keys6[n6].dstPort = l4Hdr->dst_port;
+            }
+          data6[n6] = (const uint8_t *) &keys6[n6];
+          idx6[n6++] = i;
+        }
+    }
+
+  if (n != 0)
+    {
+      rte_acl_classify(ctx, data, results, n, 1);
+      for (uint16_t k = 0; k < n; k++)
+        {
+          if (results[k] != 0)
+            qids[idx[k]] = (uint16_t) (results[k] - 1);
+        }
+    }
+
+  if (n6 != 0)
+    {
+      rte_acl_classify(ctx6, data6, results, n6, 1);
+      for (uint16_t k = 0; k < n6; k++)
+        {
+          if (results[k] != 0)
+            qids[idx6[k]] = (uint16_t) (results[k] - 1);
+        }
+    }
+}
@@ -0,0 +1,22 @@
+/* tmClassifier.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_CLASSIFIER_H_
+#define TM_CLASSIFIER_H_
+
+#include <inttypes.h>
+
+#include "tmDefs.h"
+
+int TmClassifierBuild(SchedConf *sc, TmConf *cf);                            // Compile [CLASSIFIER_RULES] into cf->aclCtx/aclCtx6
+
+void TmClassifierBurst(struct rte_acl_ctx *ctx, struct rte_acl_ctx *ctx6,    // IPv4 and IPv6 contexts, only used per families bits,
+                       uint8_t families, struct rte_mbuf **mbufs,            // only pkts with qids[i]==QID_NONE are classified,
+                       uint16_t *qids, uint16_t num);                        // qids[i] is left unchanged if no rule matches
+
+#endif // TM_CLASSIFIER_H_
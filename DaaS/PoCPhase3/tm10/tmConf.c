@@ -0,0 +1,127 @@
+/* tmConf.c
+**
+** Scheduler configuration life cycle. A parse fills a new TmConf that the main lcore publishes with a
+** single pointer store once it is complete. The config it replaces is freed after every registered
+** reader of SchedConf::confRcu went through a quiescent state, so that the enqueue, dequeue and tx
+** lcores never take a lock or see a config half built.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include <errno.h>
+
+#include <rte_acl.h>
+#include <rte_ethdev.h>
+#include <rte_hash.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_rcu_qsbr.h>
+
+#include "tmConf.h"
+
+static int
+TmConfSocket(SchedConf *sc)
+{
+  int socket = rte_eth_dev_socket_id(sc->rxPort);
+  return (socket < 0) ? (int) rte_socket_id() : socket;
+}
+
+TmConf *
+TmConfAlloc(SchedConf *sc)
+{
+  TmConf *cf = rte_zmalloc_socket("TmConf", sizeof(TmConf), RTE_CACHE_LINE_SIZE, TmConfSocket(sc));
+  if (cf == NULL)
+    return NULL;
+  // The version names the ACL contexts and flow table of the config, see TmClassifierBuild()
+  cf->version = sc->confVersion + 1;
+  return cf;
+}
+
+int
+TmConfTablesAlloc(SchedConf *sc, TmConf *cf)
+{
+  int socket = TmConfSocket(sc);
+  size_t n = cf->queuesNum;
+  size_t numQids = NUM_QIDS(cf->queuesNum);
+
+#define TM_CONF_TABLE(_t, _num)  ((_t) = rte_zmalloc_socket(#_t, (_num) * sizeof(*(_t)), RTE_CACHE_LINE_SIZE, socket))
+  TM_CONF_TABLE(cf->pathConf, n);
+  TM_CONF_TABLE(cf->bundleConf, n);
+  TM_CONF_TABLE(cf->policerConf, n);
+  TM_CONF_TABLE(cf->policerGen, n);
+  TM_CONF_TABLE(cf->queueLimitConf, numQids);
+  TM_CONF_TABLE(cf->queueLimit, numQids);
+  TM_CONF_TABLE(cf->aqmConf, numQids);
+  TM_CONF_TABLE(cf->fqConf, numQids);
+  TM_CONF_TABLE(cf->flowAssign.idleUsec, n);
+  TM_CONF_TABLE(cf->flowAssign.bundleOf, n);
+  TM_CONF_TABLE(cf->flowAssign.idleTsc, n);
+#undef TM_CONF_TABLE
+
+  if (cf->pathConf == NULL || cf->bundleConf == NULL || cf->policerConf == NULL || cf->policerGen == NULL ||
+      cf->queueLimitConf == NULL || cf->queueLimit == NULL || cf->aqmConf == NULL || cf->fqConf == NULL ||
+      cf->flowAssign.idleUsec == NULL || cf->flowAssign.bundleOf == NULL || cf->flowAssign.idleTsc == NULL)
+    return -ENOMEM;
+  return 0;
+}
+
+void
+TmConfFree(TmConf *cf)
+{
+  if (cf == NULL)
+    return;
+  rte_acl_free(cf->aclCtx);
+  rte_acl_free(cf->aclCtx6);
+  rte_hash_free(cf->flowTable);
+  for (int s = 0; s <= NUM_STREAMS_MAX; s++)
+    rte_pktmbuf_free(cf->streamPktMbuf[s]);
+  rte_free(cf->pathConf);
+  rte_free(cf->bundleConf);
+  rte_free(cf->policerConf);
+  rte_free(cf->policerGen);
+  rte_free(cf->queueLimitConf);
+  rte_free(cf->queueLimit);
+  rte_free(cf->aqmConf);
+  rte_free(cf->fqConf);
+  rte_free(cf->flowAssign.idleUsec);
+  rte_free(cf->flowAssign.bundleOf);
+  rte_free(cf->flowAssign.idleTsc);
+  rte_free(cf);
+}
+
+void
+TmConfPublish(SchedConf *sc, TmConf *cf)
+{
+  TmConf *old = sc->conf;
+
+  sc->confVersion = cf->version;
+  __atomic_store_n(&sc->conf, cf, __ATOMIC_RELEASE);
+  if (old == NULL)
+    return;
+
+  // Readers that report quiescent past this token have loaded cf
+  old->retireToken = rte_rcu_qsbr_start(sc->confRcu);
+  old->retireNext = sc->confRetired;
+  sc->confRetired = old;
+}
+
+void
+TmConfReclaim(SchedConf *sc)
+{
+  TmConf **link = &sc->confRetired;
+
+  while (*link != NULL)
+    {
+      TmConf *cf = *link;
+      if (rte_rcu_qsbr_check(sc->confRcu, cf->retireToken, false) == 1)
+        {
+          *link = cf->retireNext;
+          TmConfFree(cf);
+        }
+      else
+        link = &cf->retireNext;
+    }
+}
@@ -0,0 +1,27 @@
+/* tmConf.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_CONF_H_
+#define TM_CONF_H_
+
+#include "tmDefs.h"
+
+TmConf *TmConfAlloc(SchedConf *sc);               // Zeroed config on the socket of sc, NULL if out of memory
+int TmConfTablesAlloc(SchedConf *sc, TmConf *cf); // Zeroed tables of the cf->queuesNum GBS queues and their qids
+void TmConfFree(TmConf *cf);                      // Config never published, or reclaimed
+void TmConfPublish(SchedConf *sc, TmConf *cf);    // Main lcore: cf in effect, the previous one retired
+void TmConfReclaim(SchedConf *sc);                // Main lcore: free the retired configs no reader holds anymore
+
+// Enqueue, dequeue and tx lcores: config in effect, held until the reader's next rte_rcu_qsbr_quiescent()
+static inline const TmConf *
+TmConfGet(SchedConf *sc)
+{
+  return __atomic_load_n(&sc->conf, __ATOMIC_ACQUIRE);
+}
+
+#endif // TM_CONF_H_
@@ -13,6 +13,9 @@
 
 // Includes (from ../common/OrionTMInt.h)
 #include <stdbool.h>
+#include <rte_meter.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_spinlock.h>
 #include "../common/OrionDpdk.h"
 #include "../common/OrionPktDefs.h"
 #include "../common/OrionP4Int.h"
@@ -20,8 +23,8 @@
 #define RTE_LOGTYPE_PARSER RTE_LOGTYPE_USER1
 
 // Conditional code inclusions
-#define INCLUDE_MEMORY_BARRIERS
 #define TEST_RX_BURST_PERFORMANCE
+#define ORION_LOG_ASYNC                 // DBGLOG/INFOLOG/ERRLOG post binary records to per-lcore rings, see tmLog.c
 
 // Time conversions
 #define NSEC_PER_SEC                    1E9         	// Nano seconds per second
@@ -43,6 +46,7 @@
 #define IPG_LEN				12
 #define ETHER_DL_FRAME_OVERHEAD		(UDP_HDR_LEN + IP_HDR_LEN + ETH_HDR_LEN + VLAN_HDR_LEN)   // +46 
 #define ETHER_PHY_FRAME_OVERHEAD	(ETH_CRC_LEN + PREAMBLE_LEN + SFD_LEN + IPG_LEN)          // +24
+#define TX_TSC_SHIFT			24		// fraction bits of SchedConf::txTscPerByteQ24
 
 
 // Conditional definition of the number of hops depending on the specific use of TM9
@@ -61,6 +65,7 @@
 
 // System RX/TX definitions
 #define NUM_RXQUEUES_MAX                8
+#define NUM_ENQ_LCORES_MAX              4           	// Enqueue lcores, each polls its own subset of RSS rx queues
 #define TM_RX_PKT_BURST_MAX             16
 
 #define NUM_PORTSPERSCHED_MAX           2           	//
@@ -83,8 +88,7 @@
 #define TM_NUM_RX_RINGS            	16            // Number of shared rx rings (aka scheduler queues) by GBS traffic
 //#define TM_NUM_RX_RINGS            	2048            // Number of shared rx rings (aka scheduler queues) by GBS traffic
 #define TM_NUM_TX_RINGS            	1               // Hardcoded to 1 by implementation
-#define NUM_GBSQUEUES_MAX          	TM_NUM_RX_RINGS
-//#define NUM_GBSQUEUES_MAX          	4096
+#define NUM_GBSQUEUES_MAX          	16384           // Ceiling of the [CONFIG_TOPLVL] queues, the queue tables are sized from the config
 #define TM_NUM_CLASSES             	8               // Number of traffic classes to analyze
 #define TM_CLASS_MASK              	0x7             // Mask on vlan ID to get traffic class
 #define QUEUES_PER_BUNDLE_MAX      	16              // Max number of queues in a queue bundle
@@ -92,7 +96,7 @@
 // Stream definitions
 #define NUM_STREAMS_MAX			TM_NUM_RX_RINGS
 //#define NUM_STREAMS_MAX               4096
-#define STREAM_ID_TO_IDX(streamId)      (streamId - sc->streamsBaseNum + 1)
+#define STREAM_ID_TO_IDX(streamId)      (streamId - cf->streamsBaseNum + 1)
 #define PKT_SIZE_DEFAULT                512             // Packet size used to compute timing of empy queue
 
 // Classifier type definitions
@@ -102,9 +106,27 @@
 #define SRCPORT_CLASSIFIER		(uint16_t)3
 #define CLASSIFIER_TYPE_MAX		(uint16_t)3
 
+// Scheduler queue ids returned by the classifiers: the _n GBS queues of [CONFIG_TOPLVL] first, then the EBS
+// classes. These start on a TM_NUM_CLASSES boundary so that they share one activeMap word.
+#define QID_DROP			0				// Virtual empty queue, packets are dropped
+#define QID_EBS_BASE(_n)		RTE_ALIGN_CEIL((_n), TM_NUM_CLASSES)
+#define QID_EBS(_n, _class)		(QID_EBS_BASE(_n) + (_class))	// EBS class queue
+#define QID_CATCHALL(_n)		QID_EBS(_n, 0)			// Lowest-priority EBS queue
+#define QID_NONE			0xFFFF				// No classification decision yet
+#define NUM_QIDS(_n)			QID_EBS(_n, TM_NUM_CLASSES)	// Size of tables indexed by qid
+
+// Scheduler queue buffer limits, see [QUEUE_BUFFER_LIMIT] and TmBufferLimitBuild()
+#define QUEUE_LATENCY_USEC_DEFAULT	10000		// target queueing delay of the derived limits
+#define QUEUE_LIMIT_PKTS_MIN		64		// also the rxRing capacity of unused queues
+#define QUEUE_LIMIT_PKTS_MAX		262143		// capacity of the largest rxRing (262144 entries)
+#define TM_TX_RING_SIZE			8192		// txRing from the dequeue lcore to the tx lcore
+#define TM_MBUF_POOL_SIZE		400000		// mbufs of each MbufPoolRxPort<N>
+#define TM_MBUF_POOL_HEADROOM		32768		// rx descriptors, txRing and mempool caches
+#define BUF_DT_ALPHA_SHIFT		8		// QueueLimit::dtAlpha fixed point
+#define BUF_DT_ALPHA_GBS_DEFAULT	(2 << BUF_DT_ALPHA_SHIFT)
+#define BUF_DT_ALPHA_EBS_DEFAULT	(1 << BUF_DT_ALPHA_SHIFT)
+#define BUF_DT_ALPHA_MAX		64
 
-/* --- ECN support ---------------------------------------------- */
-extern uint32_t ecn_mark_threshold; 
 
 // ************************************************
 // State Enumerations (from ../common/OrionTMInt.h)
@@ -157,6 +179,254 @@ typedef struct RxFlow_s {
   uint16_t vlanTciMask;                // mask (0xffff) for full match
 } RxFlow;
 
+// Classifier rule from [CLASSIFIER_RULES]; each field is a wildcard when its mask/prefix/range is empty.
+// Values are in host byte order, as expected by rte_acl.
+#define CLASSIFIER_RULES_MAX  256
+#define CR_FAMILY_IPV4          0x01
+#define CR_FAMILY_IPV6          0x02
+typedef struct ClassifierRule_s {
+  uint32_t priority;                   // higher value wins when several rules match
+  uint8_t  family;                     // CR_FAMILY_xxx bits the rule applies to
+  uint16_t vlanTci;                    // vlanId (lower 12 bits) + priority
+  uint16_t vlanTciMask;
+  uint32_t srcIp;                      // IPv4 rules, host order
+  uint8_t  srcIpPrefix;                // 0..32, 0..128 for IPv6
+  uint32_t dstIp;
+  uint8_t  dstIpPrefix;
+  uint8_t  srcIp6[16];                 // IPv6 rules, network order
+  uint8_t  dstIp6[16];
+  uint32_t flowLabel, flowLabelMask;   // IPv6 only
+  uint16_t srcPortLo, srcPortHi;
+  uint16_t dstPortLo, dstPortHi;
+  uint8_t  proto, protoMask;
+  uint8_t  dscp, dscpMask;
+  uint16_t qid;                        // resulting scheduler queue: GBS qid, QID_EBS(class) or QID_DROP
+} ClassifierRule;
+
+// Exact-match flow table key from [FLOW_TABLE]. Unused fields must be 0, the key is hashed as a whole.
+// IP addresses and ports are in network byte order, as read from the packet; vlanId is in host order.
+#define FLOW_TABLE_ENTRIES_MAX  65536
+enum FlowKeyType_e
+{
+  FLOW_KEY_5TUPLE = 1,                 // srcIp, dstIp, srcPort, dstPort, proto
+  FLOW_KEY_VLANMAC = 2                 // vlanId, srcMac
+};
+typedef struct FlowKey_s {
+  uint8_t  type;                       // enum FlowKeyType_e
+  uint8_t  proto;
+  uint16_t vlanId;
+  uint32_t srcIp;
+  uint32_t dstIp;
+  uint16_t srcPort;
+  uint16_t dstPort;
+  struct rte_ether_addr srcMac;
+  uint16_t rsvd;
+} FlowKey;
+
+// Dynamic flow to queue assignment, see [FLOW_ASSIGN]. A flow that the legacy classifier maps to a GBS queue
+// of an assigned bundle is pinned on its first pkt to the least loaded queue of that bundle, until it is idle
+// for the bundle's timeout. Each enqueue lcore keeps its own table since RSS keeps a flow on one rx queue.
+#define FLOW_ASSIGN_ENTRIES_MAX         16384    // per enqueue lcore, power of 2
+#define FLOW_ASSIGN_IDLE_USEC_DEFAULT   1000000
+#define FLOW_ASSIGN_AGE_SCAN            32       // table positions checked for idle flows per rx burst
+#define FLOW_ASSIGN_NO_BUNDLE           0xFFFF
+
+typedef struct FlowAssignConf_s {
+  uint32_t *idleUsec;                  // [queuesNum] per bundle id, 0 if its flows are not assigned
+  uint16_t numBundles;                 // built by TmFlowAssignBuild()
+  uint16_t *bundleOf;                  // [queuesNum] bundle of each GBS qid, FLOW_ASSIGN_NO_BUNDLE if not assigned
+  uint64_t *idleTsc;                   // [queuesNum]
+} FlowAssignConf;
+
+typedef struct FlowAssignEntry_s {
+  FlowKey  key;
+  uint64_t lastTsc;                    // last pkt of the flow, 0 for a free position
+  uint16_t qid;
+} FlowAssignEntry;
+
+typedef struct FlowAssignState_s {
+  struct rte_hash *hash;               // FlowKey -> position in entry[]
+  FlowAssignEntry *entry;
+  uint32_t numFlows;
+  uint32_t ageCursor;
+} __rte_cache_aligned FlowAssignState;
+
+// Ingress policer of a GBS queue from [GBS_QUEUE_POLICER], applied before ring admission
+enum PolicerMode_e
+{
+  POLICER_NONE = 0,
+  POLICER_SRTCM,                       // RFC 2697 single rate three color marker
+  POLICER_TRTCM                        // RFC 2698 two rate three color marker
+};
+typedef struct PolicerConf_s {
+  uint8_t  mode;                       // enum PolicerMode_e
+  uint16_t action[RTE_COLORS];         // per color: QID_NONE accept, QID_EBS(class) remark or QID_DROP
+  uint32_t cirMbps;                    // 0 for the [GBS_SCHEDULING_RATE] of the queue's bundle
+  uint32_t pirMbps;                    // trTCM only
+  uint32_t cbs;                        // committed burst size in bytes
+  uint32_t ebs;                        // srTCM excess or trTCM peak burst size in bytes
+  union {
+    struct rte_meter_srtcm_profile srtcm;
+    struct rte_meter_trtcm_profile trtcm;
+  } profile;                           // built by TmPolicerBuild() at the full queue rate
+} PolicerConf;
+
+// Tail drop limits and ECN marking threshold of a scheduler queue. A 0 in [QUEUE_BUFFER_LIMIT] is derived
+// from the queue rate, or for ecnUsec taken from [CONFIG_TOPLVL]. Above reservePkts the queue also shares the
+// rx port mbuf pool under a dynamic threshold of dtAlpha times the free shared mbufs, see [QUEUE_BUFFER_SHARING].
+typedef struct QueueLimit_s {
+  uint32_t maxPkts;                    // never above the rxRing capacity
+  uint32_t maxBytes;
+  uint32_t ecnUsec;                    // queueing delay from which ECN-capable pkts are CE marked, 0 for none
+  uint32_t ecnBytes;                   // ecnUsec at the queue rate, built by TmBufferLimitBuild()
+  uint32_t reservePkts;                // mbufs kept for this GBS queue
+  uint16_t dtAlpha;                    // alpha << BUF_DT_ALPHA_SHIFT, 0 in the conf for the class default
+} QueueLimit;
+
+// Occupancy of a scheduler queue, in - out. The enqueue lcores and the dequeue lcore write separate cache
+// lines, so the enqueue side reads the dequeue side's line once per burst instead of the ring's consumer tail.
+typedef struct QueueOcc_s {
+  uint64_t bytesIn;                    // atomic add by the enqueue lcores, before the ring enqueue
+  uint64_t pktsIn;
+  uint64_t bytesOut __rte_cache_aligned;  // dequeue lcore only
+  uint64_t pktsOut;
+} __rte_cache_aligned QueueOcc;
+
+// Non-empty scheduler queues, one bit per qid, so that the dequeue lcore finds a backlog without reading the
+// ring tails written by the enqueue lcores. See TmBufferQueueActive().
+#define ACTIVE_MAP_WORDS(_n)            ((NUM_QIDS(_n) + 63) / 64)
+
+// Pkts the dequeue lcore pulls at once from the rxRing of a queue without FQ. They stay in the queue occupancy
+// until served, see TmFqQueuePeek().
+#define DEQ_BURST_PKTS_MAX              32
+
+typedef struct DeqBurst_s {
+  uint16_t head;                       // next pkt to serve
+  uint16_t count;
+  struct rte_mbuf *pkts[DEQ_BURST_PKTS_MAX];
+} DeqBurst;
+
+// Active queue management of a scheduler queue on the pkt sojourn time, see [QUEUE_AQM] and TmAqmDequeue()
+enum AqmMode_e
+{
+  AQM_NONE,
+  AQM_CODEL,                           // RFC 8289
+  AQM_PIE                              // RFC 8033, sojourn time variant
+};
+#define AQM_CODEL_TARGET_USEC_DEFAULT     5000
+#define AQM_CODEL_INTERVAL_USEC_DEFAULT   100000
+#define AQM_PIE_TARGET_USEC_DEFAULT       15000
+#define AQM_PIE_TUPDATE_USEC_DEFAULT      15000
+#define AQM_PIE_MAX_BURST_USEC            150000
+
+typedef struct AqmConf_s {
+  uint8_t  mode;                       // enum AqmMode_e
+  bool     ecn;                        // CE mark ECN-capable pkts instead of dropping them
+  uint32_t targetUsec;
+  uint32_t intervalUsec;               // CoDel interval or PIE update period
+  uint64_t targetTsc;                  // built by TmAqmBuild()
+  uint64_t intervalTsc;
+} AqmConf;
+
+// AQM state of a scheduler queue, owned by the dequeue lcore
+typedef struct AqmState_s {
+  uint8_t  mode;                       // AqmConf::mode the state was initialized for
+  union {
+    struct {
+      bool     dropping;
+      uint32_t count;                  // signals since entering the dropping state
+      uint32_t lastCount;
+      uint64_t firstAboveTsc;          // when sojourn above target turns into a signal, 0 if below target
+      uint64_t dropNextTsc;
+    } codel;
+    struct {
+      double   prob;                   // drop/mark probability
+      uint64_t qdelayOldTsc;
+      uint64_t lastUpdateTsc;
+      int64_t  burstAllowanceTsc;
+    } pie;
+  };
+} AqmState;
+
+// L4S DualQ coupled AQM (RFC 9332) over two EBS classes, see [EBS_DUALQ]. ECT(1) and CE pkts classified to
+// the classic class are steered to the L4S class; the pair is served at the priority of the classic class.
+#define DUALQ_TARGET_USEC_DEFAULT       15000
+#define DUALQ_TUPDATE_USEC              16000
+#define DUALQ_STEP_USEC_DEFAULT         1000
+#define DUALQ_COUPLING_DEFAULT          2
+#define DUALQ_C_PROTECT_PCT_DEFAULT     10
+
+typedef struct DualQConf_s {
+  bool     enabled;
+  uint8_t  cClass;                     // classic EBS class
+  uint8_t  lClass;                     // L4S EBS class
+  uint8_t  cProtectPct;                // share of the pair's services kept for a backlogged classic queue
+  uint16_t coupling;                   // k: L4S coupled probability is k * p'
+  uint32_t targetUsec;                 // classic queueing delay target
+  uint32_t stepUsec;                   // L4S queue step marking threshold
+  uint64_t targetTsc;                  // built by TmAqmBuild()
+  uint64_t stepTsc;
+  uint64_t tupdateTsc;
+  uint16_t lStreakMax;                 // L4S pkts served in a row while the classic queue waits
+} DualQConf;
+
+typedef struct DualQState_s {
+  double   prob;                       // base probability p', classic is p'^2
+  uint64_t qdelayOldTsc;
+  uint64_t lastUpdateTsc;
+  uint64_t sojournTsc[2];              // last sojourn dequeued from the classic [0] and L4S [1] queue
+  uint16_t lStreak;
+} DualQState;
+
+// Per-flow fair queuing of a scheduler queue, see [QUEUE_FQ]. The enqueue lcores hash each pkt to one of
+// numSub sub-rings, the dequeue lcore serves them by byte deficit round robin when the queue is picked.
+#define FQ_SUBQUEUES_MAX                64
+
+typedef struct FqConf_s {
+  uint16_t numSub;                     // power of 2, 0 without FQ; fixed at start-up
+  uint32_t quantumBytes;               // DRR quantum, 0 for maxPktSize
+} FqConf;
+
+typedef struct FqState_s {
+  struct rte_ring *sub[FQ_SUBQUEUES_MAX];
+  uint16_t numSub;
+  uint16_t mask;
+  uint16_t cur;                        // sub-queue in service, owned by the dequeue lcore as the fields below
+  bool     fresh;                      // cur not yet given its quantum in this round
+  int32_t  deficit[FQ_SUBQUEUES_MAX];
+  struct rte_mbuf *head[FQ_SUBQUEUES_MAX];  // taken from its sub-ring but not yet served
+} FqState;
+
+// EBS class scheduling, see [EBS_SCHEDULING]: strict priority between groups of classes of equal priority,
+// DRR inside a group, and optional token bucket rate caps per class and on all EBS traffic.
+#define EBS_TB_BURST_PKTS               8        // token bucket depth in maxPktSize pkts
+
+typedef struct EbsSchedConf_s {
+  uint8_t  prio[TM_NUM_CLASSES];       // higher first, default the class
+  uint32_t quantum[TM_NUM_CLASSES];    // DRR quantum in bytes, 0 for maxPktSize
+  uint32_t rateMbps[TM_NUM_CLASSES];   // 0 for uncapped
+  uint32_t aggRateMbps;                // all EBS classes, 0 for uncapped
+  uint8_t  numGroups;                  // built by TmEbsBuild(), highest priority group first
+  uint8_t  groupSize[TM_NUM_CLASSES];
+  uint8_t  groupClass[TM_NUM_CLASSES][TM_NUM_CLASSES];
+  uint8_t  groupOf[TM_NUM_CLASSES];
+  uint64_t tscPerByteQ16[TM_NUM_CLASSES];  // token cost, 0 for uncapped
+  uint64_t aggTscPerByteQ16;
+  uint64_t burstTsc[TM_NUM_CLASSES + 1];   // bucket depth per class, then aggregate
+} EbsSchedConf;
+
+// Meter of a GBS queue, shared by the enqueue lcores under lock so that a queue is policed at its full
+// rate whichever rx queues its flows hash to. Reconfigured only when its PolicerConf changes across a reload.
+typedef struct PolicerState_s {
+  rte_spinlock_t lock;
+  union {
+    struct rte_meter_srtcm srtcm;
+    struct rte_meter_trtcm trtcm;
+  } m;
+  uint64_t tsc;                        // latest time metered, the lcores' burst times are not ordered
+  uint32_t gen;                        // TmConf::policerGen the meter was configured with
+} __rte_cache_aligned PolicerState;
+
 typedef struct StreamCfg_s
 {
   int             streamId;
@@ -187,9 +457,20 @@ typedef struct BundleConf_s
   int32_t  numTimeslots;               // Number of timeslots for this bundle, derived from csv cfgfile
   uint32_t schedRate;                  // Scheduling rate of queue
   uint16_t queues[QUEUES_PER_BUNDLE_MAX];  // Map of flow queues to bundle
+  uint32_t quantum[QUEUES_PER_BUNDLE_MAX]; // DRR quantum in bytes of each queue, 0 for maxPktSize
   uint16_t pathId;		       // Path of the bundle
+  uint16_t pssFirst;                   // first and last PSS slot of the bundle, if numTimeslots > 0
+  uint16_t pssLast;
 } BundleConf;
 
+// Rx queue polling policy of the enqueue lcores, see SchedRxPoll()
+enum RxqPollMode_e
+{
+  RXQ_POLL_WRR,                        // weighted round robin, default with all weights 1
+  RXQ_POLL_SP                          // strict priority (higher q# first) with starvation guard
+};
+#define RXQ_STARVE_LIMIT_DEFAULT  64
+
 typedef struct RunConf_s 
 {
   uint8_t  initMask;                   // enum SchedInit_e
@@ -203,6 +484,11 @@ typedef struct RunConf_s
   uint16_t txqId;                      // tx queue id for scheduler tx pkts
   uint16_t rxFlows;
   RxFlow   rxFlow[RX_FLOWS_MAX];
+  bool     flowMarkOffload;            // install [FLOW_TABLE] entries as rte_flow MARK rules, see TmRxFlowMarkInstall()
+  uint8_t  rxqPollMode;                // enum RxqPollMode_e
+  uint16_t rxqWeight[NUM_RXQUEUES_MAX]; // RXQ_POLL_WRR: max consecutive full bursts taken from rx queue q per round
+  uint16_t rxqStarveLimit;             // RXQ_POLL_SP: polls a lower rx queue may be skipped before it is served first
+  uint32_t queueLatencyUsec;           // "--qlat": queueing delay sizing the queue limits not set in [QUEUE_BUFFER_LIMIT]
   unsigned statsTimerSec;              // Statistics display timer period in seconds
 } __rte_cache_aligned RunConf;
 
@@ -233,16 +519,92 @@ typedef struct IntfConf_s
   bool     updateSeqNo;
 } IntfConf;
 
+// VLAN lookup table entry, needed for packet classification based on VLAN ID and source MAC address
+// In the Bosch setup, packets are classified based on the VLAN PCP first, and then on the VLAN ID and
+// source MAC address.
+typedef struct VlanLookupEntry_s
+{
+  uint16_t vlanId;			// VlanId, should match the table index
+  struct rte_ether_addr	macaddr1;	// First source MAC address
+  struct rte_ether_addr macaddr2;	// Second source MAC address
+  uint16_t qid1;			// Queue ID of first MAC address
+  uint16_t qid2;			// Queue ID of second MAC address
+} VlanLookupEntry;
+
+#define VLAN_ID_NUM                     4096
+
+// A scheduler configuration: the cfg file, the stream file and all that is built from them. Each parse
+// allocates a new one, see TmConfAlloc(); it is not modified once published in SchedConf::conf and is
+// freed by TmConfReclaim() when no lcore can hold it anymore.
+typedef struct TmConf_s
+{
+  uint32_t version;                    // SchedConf::confVersion once published
+  uint8_t  schedMode;                  // [CONFIG_TOPLVL], schedMode to maxPktSize are fixed at start-up
+  uint16_t queuesNum;
+  uint16_t timeslotsPerSeq;
+  uint16_t maxPktSize;
+  uint16_t baseStreamId;
+  uint16_t classifierType;             // legacy classifier, see SchedRxClassifyAndUpdatePkt()
+  uint32_t ecnThresholdUsec;
+  VlanLookupEntry vlanTable[VLAN_ID_NUM];  // VLAN_ID_SRCMAC_CLASSIFIER lookup by VLAN id
+
+  uint16_t pss[NUM_TIMESLOTS_MAX];     // From csv file, Scheduling sequence of queues assignments indexed by fixed duration timeslot
+  uint16_t pssNextBusy[NUM_TIMESLOTS_MAX]; // slots from each timeslot to the next one with a bundle, 0 if none,
+  uint16_t pssNextSame[NUM_TIMESLOTS_MAX]; // and from each slot of a bundle to its next one, see app_parse_scf_row_GBS_PSS()
+
+  // Tables of the queuesNum GBS queue, bundle and path ids, or of the NUM_QIDS(queuesNum) qids, allocated
+  // by TmConfTablesAlloc() once [CONFIG_TOPLVL] is parsed
+  PathConf *pathConf;                  // Path configuration from cfg file; number of paths could equal queuesNum,
+                                       // i.e. each flow in its own path
+  BundleConf *bundleConf;              // Bundle configuration from csv file; number of bundles could equal queuesNum,
+                                       // i.e. each flow in its own bundle
+  uint16_t numClassifierRules;         // Number of [CLASSIFIER_RULES] rows, 0 if legacy classifier only
+  ClassifierRule classifierRule[CLASSIFIER_RULES_MAX];
+  struct rte_acl_ctx *aclCtx;          // IPv4 classifierRule[] compiled by TmClassifierBuild()
+  struct rte_acl_ctx *aclCtx6;         // IPv6 classifierRule[]
+  uint8_t  aclFamilies;                // CR_FAMILY_xxx bits of the contexts that hold compiled rules
+  struct rte_hash *flowTable;          // [FLOW_TABLE] FlowKey -> qid, looked up by TmFlowTableBurst()
+  uint8_t  flowKeyTypes;               // mask of (1 << enum FlowKeyType_e) present in flowTable
+  PolicerConf *policerConf;            // [GBS_QUEUE_POLICER] per GBS qid
+  uint32_t *policerGen;                // per GBS qid, bumped when a queue's policer changes on reload
+  QueueLimit *queueLimitConf;          // [QUEUE_BUFFER_LIMIT] per qid, 0 for derived
+  QueueLimit *queueLimit;              // per qid, in effect, built by TmBufferLimitBuild()
+  uint32_t bufSharedPkts;              // pool mbufs shared above the queue reserves
+  AqmConf  *aqmConf;                   // [QUEUE_AQM] per qid
+  DualQConf dualq;                     // [EBS_DUALQ]
+  EbsSchedConf ebsSched;               // [EBS_SCHEDULING]
+  FqConf   *fqConf;                    // [QUEUE_FQ] per qid
+  FlowAssignConf flowAssign;           // [FLOW_ASSIGN]
+
+  // stream config (from streams cfg file)
+  int      numStreams;                 // derived from number of streams in file
+  int      streamsBaseNum;             // stream number to stream position mapping; derived from streams file
+  StreamCfg streamCfg[NUM_STREAMS_MAX+1];
+  struct rte_mbuf *streamPktMbuf[NUM_STREAMS_MAX+1];  // see StreamPktInit()
+
+  uint64_t retireToken;                // rte_rcu_qsbr_start() of SchedConf::confRcu when replaced
+  struct TmConf_s *retireNext;         // SchedConf::confRetired list
+} __rte_cache_aligned TmConf;
+
+// SchedConf::confRcu readers: the enqueue lcores by enqIdx, then the dequeue and tx lcores
+#define CONF_RCU_DEQ_ID                 NUM_ENQ_LCORES_MAX
+#define CONF_RCU_TX_ID                  (NUM_ENQ_LCORES_MAX + 1)
+#define CONF_RCU_READERS                (NUM_ENQ_LCORES_MAX + 2)
+
 typedef struct SchedConf_s
 {
   uint8_t  schedId;                    // index to this instance
-  uint8_t  confId;		       // index to config settings for PSS, Bundle ... CRP
   time_t   lastUpdateTime;             // Time pss file was last updated
-  bool     newConfig;                  // Set if new config file is detected
+  TmConf  *conf;                       // config in effect, see TmConfPublish()
+  TmConf  *confRetired;                // replaced configs waiting for their grace period, main lcore only
+  uint32_t confVersion;                // number of configs published since start
+  struct rte_rcu_qsbr *confRcu;        // readers of conf, see CONF_RCU_READERS
   uint8_t  schedMode;                  // SchedMode_e
   uint8_t  rxPort;
   uint8_t  txPort;
   uint8_t  rxCore;
+  uint8_t  numRxCores;                 // enqueue lcores: rxCore plus the "--enq-lcores" list
+  uint8_t  rxCores[NUM_ENQ_LCORES_MAX]; // rxCores[0] is rxCore; rx queue q is polled by rxCores[q % numRxCores]
   uint8_t  tmCore;
   uint8_t  txCore;
   uint32_t linkSpeedMbps;              // in mbps
@@ -254,42 +616,18 @@ typedef struct SchedConf_s
   uint64_t tscHz;
   double   tscHzMeasured;
   uint64_t linkSpeedBpMTsc;             // Link speed in bits per million TSC tics
+  uint64_t txTscPerByteQ24;             // Wire time of a byte at linkSpeedMbps in TSC tics << TX_TSC_SHIFT, see txTimeTsc()
   uint16_t queuesNum;                   // number of logical queues; in case of bundling, this is the number of bundles
-  uint16_t baseStreamId;                // number of first stream id; used for mapping to queues
-  uint16_t classifierType;             // Type of classification used for queuing incoming packets [1, 3]
-  uint32_t ecnThreshold;    
 
-  
-  uint16_t pss[2][NUM_TIMESLOTS_MAX];     // From csv file, Scheduling sequence of queues assignments indexed by fixed duration timeslot
-  PathConf pathConf[2][NUM_GBSQUEUES_MAX]; // Path configuration from cfg file; number of bundles could equal NUM_QUEUES_MAX,
-                                           // i.e. each flow in its own path
-  BundleConf bundleConf[2][NUM_GBSQUEUES_MAX]; // Bundle configuration from csv file; number of bundles could equal NUM_QUEUES_MAX,
-                                            // i.e. each flow in its own bundle
+  struct rte_flow **flowMarkRule;           // rte_flow MARK rules installed on rxPort from TmConf::flowTable
+  uint32_t numFlowMarkRules;
   /* config file  info */
   char     schedCfgFile[SCHED_CONFIG_FILE_LEN_MAX];
   char     intfCfgFile[INTF_CONFIG_FILE_LEN_MAX];
   char     streamCfgFile[STREAM_CONFIG_FILE_LEN_MAX];
 
-  // stream config (from streams cfg file)
-  int      numStreams;                 // derived from number of streams in file
-  int      streamsBaseNum;             // stream number to stream position mapping; derived from streams file
-  StreamCfg streamCfg[2][NUM_STREAMS_MAX+1]; // allow stream config updates
-
 } __rte_cache_aligned SchedConf;
 
-
-// VLAN lookup table entry, needed for packet classification based on VLAN ID and source MAC address
-// In the Bosch setup, packets are classified based on the VLAN PCP first, and then on the VLAN ID and
-// source MAC address.
-typedef struct VlanLookupEntry_s
-{
-  uint16_t vlanId;			// VlanId, should match the table index
-  struct rte_ether_addr	macaddr1;	// First source MAC address
-  struct rte_ether_addr macaddr2;	// Second source MAC address
-  uint16_t qid1;			// Queue ID of first MAC address
-  uint16_t qid2;			// Queue ID of second MAC address
-} VlanLookupEntry;
-
 // ****************
 // State Parameters
 // ****************
@@ -306,32 +644,55 @@ typedef struct PathState_s
   CreditState pathCredit;
 } PathState;
 
+// Deficit round robin among the queues of a bundle, see getNextQueueToServed()
+typedef struct BundleDrr_s
+{
+  uint16_t cur;                        // index in BundleConf::queues[] of the queue holding the turn
+  int32_t  deficit[QUEUES_PER_BUNDLE_MAX];  // bytes, down to 1 - maxPktSize
+} BundleDrr;
+
 typedef struct BundleState_s
 {
   CreditState bundleCredit;
+  BundleDrr   drr;
 } BundleState;
 
+// EBS class scheduling state, see EbsSchedConf
+typedef struct EbsSchedState_s {
+  CreditState tb[TM_NUM_CLASSES + 1];  // tokens in tsc of the capped rate, per class then aggregate
+  int32_t  deficit[TM_NUM_CLASSES];
+  uint8_t  cur[TM_NUM_CLASSES];        // per group, index in groupClass[] of the class holding the turn
+} EbsSchedState;
+
 typedef struct QueueState_s
 {
   uint8_t          qtype;              // QUEUE_TYPE_xxx
   uint16_t         qid;                // static queue #. For reference only
   CreditState      queueCredit;        // Queue credit parameters
 
-  // For RX queue - note only 3 queues are set up - it may be better to create another data structure CRP
+  // For RX queue - the ring itself is in SchedState::rxRing, read by the enqueue lcores too
   uint32_t tsViolation;
-  struct rte_ring *rxRing;
   struct rte_mbuf *nextRxRingEntry;// if not NULL, a dequeued rxRing entry that is pending
   uint16_t nextMbufId;
-
-  struct rte_mbuf  *pktMbuf[TXDESC_PER_QUEUE_MAX];  // not used?
 } QueueState;
 
 typedef struct EnqueueThreadStats_s {
   uint64_t rxPkts;
   uint64_t rxqPkts[NUM_RXQUEUES_MAX];
+  uint64_t rxqEmptyPolls[NUM_RXQUEUES_MAX]; // rte_eth_rx_burst() returned no pkt
+  uint64_t rxqFullBursts[NUM_RXQUEUES_MAX]; // rte_eth_rx_burst() returned rxBurstSize pkts, i.e. queue backlogged
   uint64_t rxBytes;                // not implemented
   uint64_t rxFrameBytes;           // not implemented
   uint64_t rxRingDrops;
+  uint64_t rxMarkInvalid;              // NIC flow MARK ids that are no scheduler queue, sent to QID_CATCHALL
+  uint64_t policerColors[RTE_COLORS];  // GBS pkts metered per color
+  uint64_t policerRemarks;             // remarked to an EBS class
+  uint64_t policerDrops;
+  uint64_t *queueDrops;                // per qid, tail drops over the queue's QueueLimit, see TmSchedTablesAlloc()
+  uint64_t bufDtDrops;                 // of which over the shared buffer dynamic threshold
+  uint64_t flowAssignNew;              // [FLOW_ASSIGN] flows learned
+  uint64_t flowAssignAged;             // and aged out
+  uint64_t flowAssignFull;             // pkts left to the classifier's queue, table full
   uint64_t tscEnqLcoreBusy;        // cumulative tsc ticks that enqueue lcore pkt processing was performed
   uint64_t tscEnqLcoreBusyDPDK;    // cumulative tsc ticks that enqueue lcore pkt processing by DPDK driver
   uint64_t tscEnqLcoreIdle;        // cumulative tsc ticks that enqueue lcore pkt processing was idle (i.e. busy wait)
@@ -353,11 +714,20 @@ typedef struct DequeueThreadStats_s {
   uint64_t txSchedBytes;               // representing bytes/time on physical layer, i.e. scheduling rate
   uint64_t txGBSPkts;
   uint64_t txEBSPkts;
+  uint64_t txEbsClassPkts[TM_NUM_CLASSES];  // txEBSPkts per EBS class, a DualQ pair under its classic class
   uint64_t txSyncPkts;
   uint64_t tscDeqLcoreBusy;            // cumulative tsc ticks that dequeue lcore pkt processing was performed
   uint64_t tscDeqLcoreIdle;            // cumulative tsc ticks that dequeue lcore pkt processing was idle (i.e. busy wait)
   uint64_t tscSchedErrMax;
   uint64_t tscSchedErrExc;
+  uint64_t tscGbsSojournSum;           // cumulative ingress to dequeue delay of GBS pkts, see OrionMbufMeta::rxRtsc
+  uint64_t tscGbsSojournMax;           // max during stats period
+  uint64_t tscEbsSojournSum;           // cumulative ingress to dequeue delay of EBS pkts
+  uint64_t tscEbsSojournMax;           // max during stats period
+  uint64_t aqmMarks;                   // CE marked by the [QUEUE_AQM] or [EBS_DUALQ]
+  uint64_t aqmDrops;
+  uint64_t dualqLSignals;              // [EBS_DUALQ] L4S queue marks (or drops of non-ECT pkts)
+  uint64_t dualqCSignals;              // [EBS_DUALQ] classic queue marks or drops
 } __rte_cache_aligned DequeueThreadStats;
 
 // Per-port statistics struct - These are runnint counnters that do nto get cleared.
@@ -368,11 +738,13 @@ typedef struct TxThreadStats_s {
   uint64_t txSchedBytes;               // representing bytes/time on physical layer, i.e. scheduling rate
   uint64_t tscTxLcoreBusy;             // cumulative tsc ticks that dequeue lcore pkt processing was performed
   uint64_t tscTxLcoreIdle;             // cumulative tsc ticks that dequeue lcore pkt processing was idle (i.e. busy wait)
+  uint64_t tscLatencySum;              // cumulative ingress to transmit delay
+  uint64_t tscLatencyMax;              // max during stats period
 } __rte_cache_aligned TxThreadStats;
 
 #define  STATS_DEQUEUE _deqstats       // DequeueThreadStats
 #define  STATS_TX      _txstats        // TxThreadStats
-#define STATS_ENQUEUE _enqstats        // EnqueueThreadStats
+#define STATS_ENQUEUE _enqstats        // EnqueueThreadStats[NUM_ENQ_LCORES_MAX]
 
 typedef struct SchedState_s
 {
@@ -392,28 +764,45 @@ typedef struct SchedState_s
   struct timespec todSyncEnd;
   struct rte_ring *txRing;
 
-  PathState   gbsPath[2][NUM_GBSQUEUES_MAX];
-  BundleState gbsBundle[2][NUM_GBSQUEUES_MAX];
-  QueueState  gbsQueue[2][NUM_GBSQUEUES_MAX];
+  // Tables of the queuesNum GBS queue, bundle and path ids, or of the NUM_QIDS(queuesNum) qids, sized by
+  // TmSchedTablesAlloc(). Each is allocated apart and grouped by the lcore that writes it.
+  uint16_t    activeWords;              // ACTIVE_MAP_WORDS(queuesNum)
+  struct rte_ring **rxRing;             // per qid, read-only once created by CreateFifoRings()
+  FqState    **fq;                      // per qid, NULL for queues without FQ, see TmFqCreate()
+  QueueOcc    *queueOcc;                // per qid, enqueue and dequeue halves, see QueueOcc
+  QueueOcc    bufOcc;                   // pkts held by all the queues, the bytes are not kept
+  PolicerState *policer;                // per GBS qid, shared by the enqueue lcores, see TmPolicerCheck()
+  uint64_t    *activeMap;               // set by the enqueue lcores, cleared by the dequeue lcore
+  uint32_t    *flowAssignFlows;         // per GBS qid, flows pinned to it by all enqueue lcores
+  FlowAssignState flowAssign[NUM_ENQ_LCORES_MAX];  // owned by each enqueue lcore, see TmFlowAssignBuild()
+  PathState   *gbsPath;                 // per path id, owned by the dequeue lcore as the tables below
+  BundleState *gbsBundle;               // per bundle id
+  QueueState  *gbsQueue;                // per GBS qid
   QueueState  ebsQueue[TM_NUM_CLASSES];	// Low-priority queues, indexed by the priority bits of the classification header
+  uint64_t    *activeEmpty;             // see TmBufferActiveEmpty()
+  bool        activeEmptyAny;           // a bit of activeEmpty[] is set
+  AqmState    *aqm;                     // per qid
+  DualQState  dualq;
+  DeqBurst    *deqBurst;                // per qid
+  EbsSchedState ebsSched;
   
   uint32_t txPktsTotal;
   uint64_t timeslotsTotal;
   uint64_t schedSeqTotal;
+  uint64_t timeslotEndRtsc;            // next timeslot boundary of the time base, see SchedTimeslotTrack()
+  uint16_t timeslotIdxClock;           // timeslot of the current time in the scheduling sequence
   uint64_t schedSeqTotalPrev;
-
-  //struct rte_mbuf *streamPktMbuf[NUM_PORTSPERSCHED_MAX][NUM_STREAMS_MAX];
-  struct rte_mbuf *streamPktMbuf[2][NUM_STREAMS_MAX];  // Update stream cfg
+  uint64_t pssIdleEndRtsc;             // no GBS decision before, in a run of empty PSS slots
 
   // use above alias for stats below
   char pad1 __rte_cache_aligned;
-  EnqueueThreadStats  _enqstats;  char pad3 __rte_cache_aligned;
+  EnqueueThreadStats  _enqstats[NUM_ENQ_LCORES_MAX];  char pad3 __rte_cache_aligned;  // one per enqueue lcore
   DequeueThreadStats  _deqstats;  char pad2 __rte_cache_aligned;
   TxThreadStats       _txstats;   char pad4 __rte_cache_aligned;
 
 } __rte_cache_aligned SchedState;
 
-// OrionMbufUsr is 32-bit representation of rte_mbuf:hash.usr to carry Orion TM metadata with the packet.
+// OrionMbufUsr is 32-bit classification info carried with the packet in OrionMbufMeta::omu.
 typedef union OrionMbufUsr_u
 {
   uint32_t  usr;
@@ -425,28 +814,77 @@ typedef union OrionMbufUsr_u
   } u;
 } OrionMbufUsr;
 
+// OrionMbufMeta is the Orion TM metadata carried with each packet in a registered mbuf dynamic field,
+// see TmMbufMetaRegister(). It is written by the enqueue lcores and read by the dequeue and tx lcores.
+typedef struct OrionMbufMeta_s
+{
+  uint64_t     rxRtsc;                 // ingress time, tsc relative to SchedState::tscEpoch: NIC rx timestamp if available, else burst tsc
+  OrionMbufUsr omu;                    // classification info saved by the enqueue thread
+  uint16_t     qid;                    // scheduler queue selected by the enqueue thread
+  uint16_t     streamIdx;              // stream index of locally generated pkts
+} OrionMbufMeta;
+
+extern int orionMbufMetaOffset;
+#define ORION_MBUF_META(_mbuf)          RTE_MBUF_DYNFIELD((_mbuf), orionMbufMetaOffset, OrionMbufMeta *)
+
+/* NIC rx timestamp to tsc conversion: tsc = tscRef + ((nicTs - nicRef) * mult) >> RXCLOCK_MULT_SHIFT
+ * The main lcore re-anchors the reference every second with TmRxClockSync() and publishes it in the
+ * alternate ref[] entry, so that the enqueue lcores always read a complete one.
+ */
+#define RXCLOCK_MULT_SHIFT              24
+
+typedef struct RxClockRef_s
+{
+  uint64_t nicRef;                     // NIC clock read by rte_eth_read_clock()
+  uint64_t tscRef;                     // rte_rdtsc() read right after nicRef
+  uint64_t mult;                       // tsc ticks per NIC clock tick, fixed point with RXCLOCK_MULT_SHIFT fraction bits
+} RxClockRef;
+
+typedef struct RxClock_s
+{
+  bool          enabled;               // NIC rx timestamps are delivered and convertible
+  volatile uint8_t refId;              // active ref[] entry
+  int           tsOffset;              // rte_mbuf timestamp dynfield offset
+  uint64_t      tsFlag;                // RTE_MBUF_DYNFLAG_RX_TIMESTAMP_NAME flag mask
+  RxClockRef    ref[2];
+} RxClock;
+
+extern RxClock rxClock;
+
+static inline uint64_t
+RxClockNicToTsc(const RxClockRef *ref, uint64_t nicTs)
+{
+  // NIC timestamp may precede nicRef when the pkt was received before the last re-anchoring
+  if (likely(nicTs >= ref->nicRef))
+    return ref->tscRef + (((nicTs - ref->nicRef) * ref->mult) >> RXCLOCK_MULT_SHIFT);
+  return ref->tscRef - (((ref->nicRef - nicTs) * ref->mult) >> RXCLOCK_MULT_SHIFT);
+}
+
 extern volatile bool forceQuit;
 extern uint32_t   enabledPortsMask;
 
 extern RunConf    runConf;
 extern IntfConf   intfConf[];          // for multiple instances of interfaces.
-extern SchedConf  schedConf[];         // for multiple instances of scheduler.
-extern SchedState schedState[];        // for multiple instances of scheduler.
-extern uint16_t	  schedClassifierType; // Classification method
-extern VlanLookupEntry vlanid_table[]; // Lookup table for VLAN IDs
+extern SchedConf  *schedConf;         // for multiple instances of scheduler, see TmSchedAlloc()
+extern SchedState *schedState;        // for multiple instances of scheduler, see TmSchedAlloc()
+
+void TmSchedAlloc(uint16_t rxPort);    // Allocate the tables above on the NUMA node of rxPort
+void TmSchedTablesAlloc(SchedConf *sc); // Allocate the queue tables of sc's SchedState, sized by sc->queuesNum
 
 extern struct rte_mempool *pktmbufPool;
 
 //extern int InitTraffic(SchedConf *sc, SchedState *ss);
 extern void SchedThreadsDispatcher(void);
-extern int StreamPktInit(uint8_t confId, uint8_t sid); // update for stream config 
-extern int StreamRatesValidate(SchedConf *sc, uint8_t confId);
+extern int StreamPktInit(TmConf *cf, uint8_t sid); // update for stream config 
+extern int StreamRatesValidate(SchedConf *sc, TmConf *cf);
 extern int parse_args(int argc, char **argv);
 extern int ethdev_wait_all_ports_up(uint32_t portsMask, int maxSeconds);
 extern int ethdev_init(uint32_t cpuSocket, uint32_t portsMask, RunConf *rc);
 extern double tscClockCalibrate(bool verbose);
+extern void TmRxClockInit(uint16_t portId);
+extern void TmRxClockSync(uint16_t portId);
 
-extern int app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, uint8_t confId);
+extern int app_parse_scf_cfgfile(SchedConf *sc, const char *cfgfile, TmConf *cf);
 extern void mac_address_printf(struct rte_ether_addr *macaddr);
 
 #endif  //  _TM_DEFS_H_
@@ -0,0 +1,170 @@
+/* tmEbs.c
+**
+** EBS class scheduling of the dequeue lcore, when no GBS pkt is selected in a timeslot. The classes
+** are served in strict priority between groups of equal [EBS_SCHEDULING] priority, and by byte
+** deficit round robin inside a group. Optional token buckets cap the rate of a class and of all
+** EBS traffic, so that best effort cannot fill the NIC ahead of the GBS pkts that follow. Without
+** rows each class is its own group, i.e. strict priority from class 7 down to class 0.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include "tmEbs.h"
+#include "tmBuffer.h"
+
+void
+TmEbsConfReset(SchedConf *sc, TmConf *cf)
+{
+  EbsSchedConf *ec = &cf->ebsSched;
+
+  memset(ec, 0, sizeof(*ec));
+  for (uint8_t c = 0; c < TM_NUM_CLASSES; c++)
+    ec->prio[c] = c;
+}
+
+// Token cost in tsc per byte << 16 at rateMbps, 0 if uncapped
+static uint64_t
+TmEbsTscPerByteQ16(uint32_t rateMbps)
+{
+  return rateMbps ? ((rte_get_tsc_hz() * 8) << 16) / ((uint64_t) rateMbps * 1000000) : 0;
+}
+
+void
+TmEbsBuild(SchedConf *sc, TmConf *cf)
+{
+  EbsSchedConf *ec = &cf->ebsSched;
+  const DualQConf *dq = &cf->dualq;
+  uint64_t burstBytes = (uint64_t) EBS_TB_BURST_PKTS * (cf->maxPktSize + ETHER_PHY_FRAME_OVERHEAD);
+
+  // Groups of equal priority, highest first. The L4S class of a DualQ pair is served through its classic class.
+  ec->numGroups = 0;
+  for (int p = UINT8_MAX; p >= 0; p--)
+    {
+      uint8_t n = 0;
+      for (uint8_t c = 0; c < TM_NUM_CLASSES; c++)
+        {
+          if (ec->prio[c] != p || (dq->enabled && c == dq->lClass))
+            continue;
+          ec->groupClass[ec->numGroups][n++] = c;
+          ec->groupOf[c] = ec->numGroups;
+        }
+      if (n != 0)
+        ec->groupSize[ec->numGroups++] = n;
+    }
+
+  for (uint8_t c = 0; c < TM_NUM_CLASSES; c++)
+    {
+      ec->tscPerByteQ16[c] = TmEbsTscPerByteQ16(ec->rateMbps[c]);
+      ec->burstTsc[c] = (burstBytes * ec->tscPerByteQ16[c]) >> 16;
+    }
+  ec->aggTscPerByteQ16 = TmEbsTscPerByteQ16(ec->aggRateMbps);
+  ec->burstTsc[TM_NUM_CLASSES] = (burstBytes * ec->aggTscPerByteQ16) >> 16;
+
+  if (ec->numGroups != TM_NUM_CLASSES - (dq->enabled ? 1 : 0) || ec->aggRateMbps != 0)
+    printf("Conf #%u: %u EBS priority groups, EBS capped at %u mbps (0 for none)\n", cf->version, ec->numGroups,
+           ec->aggRateMbps);
+}
+
+// Refill a token bucket up to its depth, true if its rate allows a pkt now
+static inline bool
+TmEbsTbConform(CreditState *tb, uint64_t burstTsc, uint64_t now)
+{
+  int64_t value = tb->value + (int64_t) (now - tb->lastRtsc);
+
+  tb->value = RTE_MIN(value, (int64_t) burstTsc);
+  tb->lastRtsc = now;
+  return tb->value >= 0;
+}
+
+static inline bool
+TmEbsBacklog(const TmConf *cf, SchedState *ss, int cls)
+{
+  const DualQConf *dq = &cf->dualq;
+
+  if (TmBufferQueueActive(ss, QID_EBS(ss->queuesNum, cls)))
+    return true;
+  return dq->enabled && cls == dq->cClass && TmBufferQueueActive(ss, QID_EBS(ss->queuesNum, dq->lClass));
+}
+
+static inline bool
+TmEbsEligible(const EbsSchedConf *ec, EbsSchedState *es, int cls, uint64_t now)
+{
+  return ec->tscPerByteQ16[cls] == 0 || TmEbsTbConform(&es->tb[cls], ec->burstTsc[cls], now);
+}
+
+static inline int32_t
+TmEbsQuantum(SchedConf *sc, const EbsSchedConf *ec, int cls)
+{
+  return ec->quantum[cls] ? (int32_t) ec->quantum[cls] : sc->maxPktSize;
+}
+
+int
+TmEbsSelect(SchedConf *sc, SchedState *ss, const TmConf *cf, uint64_t rtscNow)
+{
+  const EbsSchedConf *ec = &cf->ebsSched;
+  EbsSchedState *es = &ss->ebsSched;
+
+  if (TmBufferEbsActive(ss) == 0)
+    return -1;
+  if (ec->aggTscPerByteQ16 != 0 &&
+      !TmEbsTbConform(&es->tb[TM_NUM_CLASSES], ec->burstTsc[TM_NUM_CLASSES], rtscNow))
+    return -1;
+
+  for (uint8_t g = 0; g < ec->numGroups; g++)
+    {
+      uint8_t n = ec->groupSize[g];
+
+      if (n == 1)
+        {
+          int c = ec->groupClass[g][0];
+          if (TmEbsBacklog(cf, ss, c) && TmEbsEligible(ec, es, c, rtscNow))
+            return c;
+          continue;
+        }
+
+      // DRR: the class holding the turn keeps it while its deficit is positive. Passes end once no class
+      // of the group is both backlogged and within its rate cap.
+      if (es->cur[g] >= n)
+        es->cur[g] = 0;
+      for (bool any = true; any; )
+        {
+          any = false;
+          for (uint8_t k = 0; k < n; k++)
+            {
+              int c = ec->groupClass[g][es->cur[g]];
+              if (!TmEbsBacklog(cf, ss, c))
+                es->deficit[c] = RTE_MIN(es->deficit[c], 0);  // an idle class banks no quanta
+              else if (!TmEbsEligible(ec, es, c, rtscNow))
+                es->deficit[c] = RTE_MIN(es->deficit[c], TmEbsQuantum(sc, ec, c));
+              else
+                {
+                  any = true;
+                  if (es->deficit[c] > 0)
+                    return c;
+                }
+              es->cur[g] = (es->cur[g] + 1 < n) ? es->cur[g] + 1 : 0;
+              int next = ec->groupClass[g][es->cur[g]];
+              es->deficit[next] += TmEbsQuantum(sc, ec, next);
+            }
+        }
+    }
+  return -1;
+}
+
+void
+TmEbsServed(SchedState *ss, const TmConf *cf, int cls, uint32_t pktLen)
+{
+  const EbsSchedConf *ec = &cf->ebsSched;
+  EbsSchedState *es = &ss->ebsSched;
+  uint64_t bytes = pktLen + ETHER_PHY_FRAME_OVERHEAD;
+
+  if (ec->groupSize[ec->groupOf[cls]] > 1)
+    es->deficit[cls] -= (int32_t) pktLen;
+  if (ec->tscPerByteQ16[cls] != 0)
+    es->tb[cls].value -= (int64_t) ((bytes * ec->tscPerByteQ16[cls]) >> 16);
+  if (ec->aggTscPerByteQ16 != 0)
+    es->tb[TM_NUM_CLASSES].value -= (int64_t) ((bytes * ec->aggTscPerByteQ16) >> 16);
+}
@@ -0,0 +1,27 @@
+/* tmEbs.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_EBS_H_
+#define TM_EBS_H_
+
+#include <inttypes.h>
+
+#include "tmDefs.h"
+
+void TmEbsConfReset(SchedConf *sc, TmConf *cf);                              // Default strict priority by class, uncapped
+void TmEbsBuild(SchedConf *sc, TmConf *cf);                                  // Groups and token bucket costs of cf->ebsSched
+
+/*
+ * Dequeue lcore: EBS class to serve at rtscNow, -1 if no backlogged class is within its rate caps.
+ * The classic class stands for a [EBS_DUALQ] pair.
+ */
+int TmEbsSelect(SchedConf *sc, SchedState *ss, const TmConf *cf, uint64_t rtscNow);
+
+void TmEbsServed(SchedState *ss, const TmConf *cf, int cls, uint32_t pktLen); // Charge a pkt of the class returned by TmEbsSelect()
+
+#endif // TM_EBS_H_
@@ -18,6 +18,12 @@
 struct rte_mempool *pktmbufPool = NULL;
 static struct rte_mempool *pktmbufPoolRxPort[SCHED_MAX_ETHPORTS];
 static struct rte_ether_addr portEtherAddr[SCHED_MAX_ETHPORTS];
+static bool portRxTimestamp[SCHED_MAX_ETHPORTS];	// RTE_ETH_RX_OFFLOAD_TIMESTAMP enabled
+
+int orionMbufMetaOffset = -1;
+RxClock rxClock;
+
+#define RXCLOCK_CALIBRATE_MSEC	100
 
 
 // Configurable number of RX/TX ring descriptors
@@ -102,6 +108,101 @@ tscClockCalibrate(bool verbose)
   return tscHz;
 }
 
+/*
+ * Register the OrionMbufMeta dynamic field. Must be done before any mbuf carrying metadata is allocated.
+ */
+static void
+TmMbufMetaRegister(void)
+{
+  static const struct rte_mbuf_dynfield metaDesc = {
+    .name  = "orion_tm_dynfield_meta",
+    .size  = sizeof(OrionMbufMeta),
+    .align = __alignof__(OrionMbufMeta),
+  };
+
+  orionMbufMetaOffset = rte_mbuf_dynfield_register(&metaDesc);
+  if (orionMbufMetaOffset < 0)
+    rte_exit(EXIT_FAILURE, "Cannot register mbuf metadata dynfield: %s\n", rte_strerror(rte_errno));
+}
+
+/*
+ * Read the NIC clock and tsc as close together as possible
+ */
+static int
+RxClockRead(uint16_t portId, uint64_t *nic, uint64_t *tsc)
+{
+  int ret = rte_eth_read_clock(portId, nic);
+  *tsc = rte_rdtsc();
+  return ret;
+}
+
+/*
+ * Enable NIC rx timestamps of portId for OrionMbufMeta::rxRtsc when the PMD provides them and its clock
+ * can be read. Otherwise the enqueue thread falls back to the rx burst tsc.
+ */
+void
+TmRxClockInit(uint16_t portId)
+{
+  uint64_t nic0, tsc0, nic1, tsc1;
+
+  rxClock.enabled = false;
+  if (portId >= SCHED_MAX_ETHPORTS || !portRxTimestamp[portId])
+    {
+      printf("INFO: port%u has no rx timestamp offload, ingress time taken from rx burst tsc\n", portId);
+      return;
+    }
+  if (rte_mbuf_dyn_rx_timestamp_register(&rxClock.tsOffset, &rxClock.tsFlag) != 0)
+    {
+      printf("WARNING: rx timestamp dynfield registration failed, ingress time taken from rx burst tsc\n");
+      return;
+    }
+  if (RxClockRead(portId, &nic0, &tsc0) != 0)
+    {
+      printf("WARNING: port%u clock cannot be read, ingress time taken from rx burst tsc\n", portId);
+      return;
+    }
+  rte_delay_ms(RXCLOCK_CALIBRATE_MSEC);
+  RxClockRead(portId, &nic1, &tsc1);
+  if (nic1 <= nic0)
+    {
+      printf("WARNING: port%u clock not running, ingress time taken from rx burst tsc\n", portId);
+      return;
+    }
+
+  RxClockRef *ref = &rxClock.ref[0];
+  ref->nicRef = nic1;
+  ref->tscRef = tsc1;
+  ref->mult   = ((tsc1 - tsc0) << RXCLOCK_MULT_SHIFT) / (nic1 - nic0);
+  rxClock.refId = 0;
+  rxClock.enabled = true;
+  printf("INFO: port%u rx timestamps enabled, NIC clock %.3f MHz\n", portId,
+         (double)(nic1 - nic0) / (RXCLOCK_CALIBRATE_MSEC * USEC_PER_MSEC));
+}
+
+/*
+ * Re-anchor the NIC to tsc conversion and refresh its rate. Called by the main lcore about every second.
+ */
+void
+TmRxClockSync(uint16_t portId)
+{
+  uint64_t nic, tsc;
+
+  if (!rxClock.enabled)
+    return;
+  if (RxClockRead(portId, &nic, &tsc) != 0)
+    return;
+
+  const RxClockRef *cur = &rxClock.ref[rxClock.refId];
+  RxClockRef *nxt = &rxClock.ref[!rxClock.refId];
+  if (nic <= cur->nicRef || tsc <= cur->tscRef)
+    return;
+  nxt->mult   = ((tsc - cur->tscRef) << RXCLOCK_MULT_SHIFT) / (nic - cur->nicRef);
+  nxt->nicRef = nic;
+  nxt->tscRef = tsc;
+  rte_smp_wmb();
+  rxClock.refId = !rxClock.refId;
+}
+
 static struct rte_eth_conf portConf = {
   // 	.rxmode = {
   // 		.split_hdr_size = 0, removed in 22.11
@@ -192,6 +293,8 @@ ethdev_init(uint32_t cpuSocket, uint32_t portsMask, RunConf *rc)
   uint32_t portId, numPorts;
   uint32_t numPortsAvail=0;
 
+  TmMbufMetaRegister();
+
   numPorts = rte_eth_dev_count_avail();
   if (numPorts == 0)
     rte_exit(EXIT_FAILURE, "No Ethernet ports - bye\n");
@@ -213,7 +316,7 @@ ethdev_init(uint32_t cpuSocket, uint32_t portsMask, RunConf *rc)
   */
 
   // int numMbuffs = numTxDesc + numRxDesc;
-  int numMbuffs = 400000;
+  int numMbuffs = TM_MBUF_POOL_SIZE;
 
   /* create the mbuf pool. The RTE_MBUF_DEFAULT_BUF_SIZE is defined to accomodate 2048 bytes pkt. */
   // pktmbufPool = rte_pktmbuf_pool_create("MbufPool", numMbuffs, MEMPOOL_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE, cpuSocket);
@@ -253,9 +356,23 @@ ethdev_init(uint32_t cpuSocket, uint32_t portsMask, RunConf *rc)
       {
 	rte_exit(EXIT_FAILURE, "Invalid port%u txq config range: txqNum=%u\n", portId, rc->txqNum);
       }
+    if (rc->rxqNum > devInfo.max_rx_queues)
+      {
+	rte_exit(EXIT_FAILURE, "Invalid port%u rxq config range: rxqNum=%u\n", portId, rc->rxqNum);
+      }
+    if (rc->rxqNum > 1)
+      {
+	// Spread flows over the rx queues, and so over the enqueue lcores, keeping each flow on a single queue
+	portConfLocal.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+	portConfLocal.rx_adv_conf.rss_conf.rss_key = NULL;
+	portConfLocal.rx_adv_conf.rss_conf.rss_hf = (RTE_ETH_RSS_IP | RTE_ETH_RSS_UDP | RTE_ETH_RSS_TCP) & devInfo.flow_type_rss_offloads;
+	if (portConfLocal.rx_adv_conf.rss_conf.rss_hf == 0)
+	  rte_exit(EXIT_FAILURE, "Port%u does not support RSS for %u rx queues\n", portId, rc->rxqNum);
+      }
     if (devInfo.rx_offload_capa & RTE_ETH_RX_OFFLOAD_TIMESTAMP)
       {
 	portConfLocal.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+	portRxTimestamp[portId] = true;
 	//printf("DBG: rx_offloads=0x%lx with DEV_RX_OFFLOAD_TIMESTAMP enabled\n", portConfLocal.rxmode.offloads);
       }
     else
@@ -277,6 +394,17 @@ ethdev_init(uint32_t cpuSocket, uint32_t portsMask, RunConf *rc)
 	//printf("DBG: tx_offloads_capability=0x%lx DEV_TX_OFFLOAD_MBUF_FAST_FREE not supported!\n", devInfo.tx_offload_capa);
       }
 
+    if (rc->flowMarkOffload)
+      {
+	// Must be negotiated before rte_eth_dev_configure() for the PMD to deliver the MARK id in mbuf->hash.fdir.hi
+	uint64_t rxMetadata = RTE_ETH_RX_METADATA_USER_MARK;
+	int ret = rte_eth_rx_metadata_negotiate(portId, &rxMetadata);
+	if (ret != 0 && ret != -ENOTSUP)
+	  rte_exit(EXIT_FAILURE, "Cannot negotiate rx metadata: err=%d, port=%u\n", ret, portId);
+	if ((rxMetadata & RTE_ETH_RX_METADATA_USER_MARK) == 0)
+	  printf("WARNING: port%u does not deliver flow MARK, flows are classified in software\n", portId);
+      }
+
     int ret = rte_eth_dev_configure(portId, rc->rxqNum, rc->txqNum, &portConfLocal);	// 1 RxQ and specified number of scheduler TxQ's
     //int ret = rte_eth_dev_configure(portId, 0, rc->txqNum, &portConfLocal);	// 1 RxQ and specified number of scheduler TxQ's
     if (ret < 0)
@@ -306,7 +434,7 @@ ethdev_init(uint32_t cpuSocket, uint32_t portsMask, RunConf *rc)
     //uint16_t numRxDescPerRxQ = RoundDownToPowerOf2(numRxDesc / 1);	// Derive the numRxDescPerRxQ from total numRxDesc 
 
     //printf("DBG: Total Rx descriptors=%u, numRxDescPerRxQ=%u for %u rxQueues!\n", numRxDesc, numRxDescPerRxQ, rc->rxqNum);
-    printf("DBG: Total Rx descriptors=%u, numRxDescPerRxQ=%u for %u rxQueues!\n", numRxDesc, numRxDescPerRxQ, 1);
+    printf("DBG: Total Rx descriptors=%u, numRxDescPerRxQ=%u for %u rxQueues!\n", numRxDesc, numRxDescPerRxQ, rc->rxqNum);
     for (uint16_t q=0; q<rc->rxqNum; q++)
       {
 	ret = rte_eth_rx_queue_setup(portId, q, numRxDescPerRxQ, rte_eth_dev_socket_id(portId), &rxqConf, pktmbufPoolRxPort[portId]);
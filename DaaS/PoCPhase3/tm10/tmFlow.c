@@ -9,6 +9,8 @@
 #include "tmDefs.h"
 #include "tmFlow.h"
 #include "parserLib.h"
+#include <rte_hash.h>
+#include <rte_malloc.h>
 
 /**
  * Create a flow rule that sends packets with matching vlans to selected queue.
@@ -92,3 +94,185 @@ TmRxFlowConfig(uint16_t port_id, uint16_t rxQueueId, uint16_t vlanTci, uint16_t
 
 	return flow;
 }
+
+/**
+ * Create a flow rule that marks packets of one flow table entry with markId.
+ * Flow action RTE_FLOW_ACTION_TYPE_MARK is reported in mbuf->hash.fdir.hi with RTE_MBUF_F_RX_FDIR_ID set,
+ * so the enqueue thread gets the scheduler queue without parsing the packet headers.
+ *
+ * @param port_id
+ *   The selected port.
+ * @param rxqNum
+ *   number of rx queues: matching packets are spread by RSS when > 1, else sent to queue 0
+ *   (most PMDs require a fate action along with MARK)
+ * @param key
+ *   flow table key: IPv4 5-tuple or VLAN ID + source MAC
+ * @param markId
+ *   mark value, the scheduler qid
+ * @return
+ *   A flow if the rule could be created else return NULL.
+ */
+struct rte_flow *
+TmRxFlowMarkConfig(uint16_t port_id, uint16_t rxqNum, const FlowKey *key, uint32_t markId)
+{
+#define MARK_PATTERN_NUM	4
+#define MARK_ACTION_NUM		3
+	struct rte_flow_attr attr;
+	struct rte_flow_item pattern[MARK_PATTERN_NUM];
+	struct rte_flow_action action[MARK_ACTION_NUM];
+	struct rte_flow_action_queue queue;
+	struct rte_flow_action_rss rss;
+	uint16_t rssQueues[NUM_RXQUEUES_MAX];
+	struct rte_flow_action_mark mark;
+	struct rte_flow_item_eth  eth_spec, eth_mask;
+	struct rte_flow_item_vlan vlan_spec, vlan_mask;
+	struct rte_flow_item_ipv4 ip_spec, ip_mask;
+	struct rte_flow_item_udp  l4_spec, l4_mask;
+	struct rte_flow_item_tcp  tcp_spec, tcp_mask;
+	struct rte_flow_error err;
+	int p = 0;
+
+	memset(pattern, 0, sizeof(pattern));
+	memset(action, 0, sizeof(action));
+	memset(&eth_spec, 0, sizeof(eth_spec));
+	memset(&eth_mask, 0, sizeof(eth_mask));
+	memset(&attr, 0, sizeof(struct rte_flow_attr));
+	attr.ingress = 1;
+
+	mark.id        = markId;
+	action[0].type = RTE_FLOW_ACTION_TYPE_MARK;
+	action[0].conf = &mark;
+	if (rxqNum > 1)
+	{
+		memset(&rss, 0, sizeof(rss));
+		for (uint16_t q = 0; q < rxqNum; q++)
+			rssQueues[q] = q;
+		rss.types      = RTE_ETH_RSS_IP | RTE_ETH_RSS_UDP | RTE_ETH_RSS_TCP;
+		rss.queue_num  = rxqNum;
+		rss.queue      = rssQueues;
+		action[1].type = RTE_FLOW_ACTION_TYPE_RSS;
+		action[1].conf = &rss;
+	}
+	else
+	{
+		queue.index    = 0;
+		action[1].type = RTE_FLOW_ACTION_TYPE_QUEUE;
+		action[1].conf = &queue;
+	}
+	action[2].type = RTE_FLOW_ACTION_TYPE_END;
+
+	pattern[p].type = RTE_FLOW_ITEM_TYPE_ETH;
+	pattern[p].spec = &eth_spec;
+	pattern[p].mask = &eth_mask;
+	p++;
+
+	if (key->type == FLOW_KEY_VLANMAC)
+	{
+		rte_ether_addr_copy(&key->srcMac, &eth_spec.src);
+		memset(&eth_mask.src, 0xff, sizeof(eth_mask.src));
+
+		memset(&vlan_spec, 0, sizeof(vlan_spec));
+		memset(&vlan_mask, 0, sizeof(vlan_mask));
+		vlan_spec.tci = rte_cpu_to_be_16(key->vlanId);
+		vlan_mask.tci = RTE_BE16(0x0fff);
+		pattern[p].type = RTE_FLOW_ITEM_TYPE_VLAN;
+		pattern[p].spec = &vlan_spec;
+		pattern[p].mask = &vlan_mask;
+		p++;
+	}
+	else
+	{
+		memset(&ip_spec, 0, sizeof(ip_spec));
+		memset(&ip_mask, 0, sizeof(ip_mask));
+		ip_spec.hdr.src_addr = key->srcIp;
+		ip_spec.hdr.dst_addr = key->dstIp;
+		ip_spec.hdr.next_proto_id = key->proto;
+		ip_mask.hdr.src_addr = RTE_BE32(0xffffffff);
+		ip_mask.hdr.dst_addr = RTE_BE32(0xffffffff);
+		ip_mask.hdr.next_proto_id = 0xff;
+		pattern[p].type = RTE_FLOW_ITEM_TYPE_IPV4;
+		pattern[p].spec = &ip_spec;
+		pattern[p].mask = &ip_mask;
+		p++;
+
+		if (key->proto == IPPROTO_UDP)
+		{
+			memset(&l4_spec, 0, sizeof(l4_spec));
+			memset(&l4_mask, 0, sizeof(l4_mask));
+			l4_spec.hdr.src_port = key->srcPort;
+			l4_spec.hdr.dst_port = key->dstPort;
+			l4_mask.hdr.src_port = RTE_BE16(0xffff);
+			l4_mask.hdr.dst_port = RTE_BE16(0xffff);
+			pattern[p].type = RTE_FLOW_ITEM_TYPE_UDP;
+			pattern[p].spec = &l4_spec;
+			pattern[p].mask = &l4_mask;
+			p++;
+		}
+		else if (key->proto == IPPROTO_TCP)
+		{
+			memset(&tcp_spec, 0, sizeof(tcp_spec));
+			memset(&tcp_mask, 0, sizeof(tcp_mask));
+			tcp_spec.hdr.src_port = key->srcPort;
+			tcp_spec.hdr.dst_port = key->dstPort;
+			tcp_mask.hdr.src_port = RTE_BE16(0xffff);
+			tcp_mask.hdr.dst_port = RTE_BE16(0xffff);
+			pattern[p].type = RTE_FLOW_ITEM_TYPE_TCP;
+			pattern[p].spec = &tcp_spec;
+			pattern[p].mask = &tcp_mask;
+			p++;
+		}
+	}
+
+	/* the final level must be always type end */
+	pattern[p].type = RTE_FLOW_ITEM_TYPE_END;
+
+	if (rte_flow_validate(port_id, &attr, pattern, action, &err) != 0)
+		return NULL;
+	return rte_flow_create(port_id, &attr, pattern, action, &err);
+}
+
+/**
+ * Replace the MARK rules of sc->rxPort with the entries of cf->flowTable.
+ * Installation stops at the first rule rejected by the PMD (unsupported pattern or rule table full);
+ * the remaining flows are then classified in software by the enqueue thread.
+ *
+ * @return
+ *   Number of rules installed.
+ */
+int
+TmRxFlowMarkInstall(SchedConf *sc, const TmConf *cf)
+{
+	struct rte_flow_error err;
+	const void *key;
+	void *data;
+	uint32_t next = 0;
+
+	if (sc->flowMarkRule == NULL)
+	{
+		sc->flowMarkRule = rte_zmalloc("flowMarkRule", FLOW_TABLE_ENTRIES_MAX * sizeof(struct rte_flow *), 0);
+		if (sc->flowMarkRule == NULL)
+			rte_exit(EXIT_FAILURE, "Cannot allocate flow MARK rule table\n");
+	}
+
+	for (uint32_t r = 0; r < sc->numFlowMarkRules; r++)
+		rte_flow_destroy(sc->rxPort, sc->flowMarkRule[r], &err);
+	sc->numFlowMarkRules = 0;
+
+	if (cf->flowKeyTypes == 0)
+		return 0;
+
+	while (rte_hash_iterate(cf->flowTable, &key, &data, &next) >= 0)
+	{
+		struct rte_flow *flow = TmRxFlowMarkConfig(sc->rxPort, runConf.rxqNum, (const FlowKey *) key, (uint32_t)(uintptr_t) data);
+		if (flow == NULL)
+		{
+			printf("WARNING: port%u accepted %u flow MARK rules, the other flows are classified in software\n",
+			       sc->rxPort, sc->numFlowMarkRules);
+			break;
+		}
+		sc->flowMarkRule[sc->numFlowMarkRules++] = flow;
+	}
+
+	printf("INFO: port%u %u flow MARK rules installed for conf #%u\n", sc->rxPort, sc->numFlowMarkRules, cf->version);
+	return (int) sc->numFlowMarkRules;
+}
@@ -10,5 +10,7 @@
 #define FLOW_DEF_H_
 
 struct rte_flow* TmRxFlowConfig(uint16_t port_id, uint16_t rxQueueId, uint16_t vlanTci, uint16_t vlanTciMask);
+struct rte_flow* TmRxFlowMarkConfig(uint16_t port_id, uint16_t rxqNum, const FlowKey *key, uint32_t markId);
+int TmRxFlowMarkInstall(SchedConf *sc, const TmConf *cf);
 
 #endif // FLOW_DEF_H_
@@ -0,0 +1,230 @@
+/* tmFlowAssign.c
+**
+** Dynamic flow to queue assignment. The legacy classifiers map flows to GBS queues by a modulo of the
+** source port, VLAN ID or TTL, so that colliding flows share a queue while other queues of the bundle stay
+** empty. For the bundles of [FLOW_ASSIGN], the enqueue lcore rather pins each new IPv4 flow to the queue of
+** that bundle holding the fewest flows (then the fewest bytes), and releases it after an idle timeout.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include <arpa/inet.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_malloc.h>
+
+#include "tmFlowAssign.h"
+#include "tmFlowTable.h"
+#include "tmBuffer.h"
+
+static int
+TmFlowAssignCreate(FlowAssignState *fa, unsigned schedId, unsigned enqIdx)
+{
+  char name[RTE_HASH_NAMESIZE];
+  snprintf(name, sizeof(name), "tmAssign-%u-e%u", schedId, enqIdx);
+
+  struct rte_hash_parameters param =
+  {
+    .name = name,
+    .entries = FLOW_ASSIGN_ENTRIES_MAX,
+    .key_len = sizeof(FlowKey),
+    .hash_func = rte_hash_crc,
+    .hash_func_init_val = 0,
+    .socket_id = rte_socket_id(),
+  };
+  fa->hash = rte_hash_create(&param);
+  if (fa->hash == NULL)
+    {
+      printf("ERROR: rte_hash_create(%s) failed: %s\n", name, rte_strerror(rte_errno));
+      return -1;
+    }
+  fa->entry = rte_zmalloc_socket("FlowAssignEntry", FLOW_ASSIGN_ENTRIES_MAX * sizeof(FlowAssignEntry),
+                                 RTE_CACHE_LINE_SIZE, (int) rte_socket_id());
+  if (fa->entry == NULL)
+    {
+      printf("ERROR: flow assignment table alloc failed for sid%u enqueue lcore #%u\n", schedId, enqIdx);
+      rte_hash_free(fa->hash);
+      fa->hash = NULL;
+      return -1;
+    }
+  return 0;
+}
+
+int
+TmFlowAssignBuild(SchedConf *sc, TmConf *cf)
+{
+  FlowAssignConf *fc = &cf->flowAssign;
+  SchedState *ss = &schedState[sc->schedId];
+
+  fc->numBundles = 0;
+  memset(fc->bundleOf, 0xFF, cf->queuesNum * sizeof(*fc->bundleOf));  // FLOW_ASSIGN_NO_BUNDLE
+  for (uint16_t b = 0; b < cf->queuesNum; b++)
+    {
+      const BundleConf *bc = &cf->bundleConf[b];
+      uint16_t numQueues = 0;
+      if (fc->idleUsec[b] == 0)
+        continue;
+      for (uint16_t i = 0; i < bc->numQueues; i++)
+        numQueues += (bc->queues[i] != QID_DROP);
+      if (numQueues < 2)
+        {
+          printf("WARNING: Conf #%u: [FLOW_ASSIGN] bundle %u has %u queue(s), flows are not assigned\n", cf->version, b,
+                 numQueues);
+          continue;
+        }
+      for (uint16_t i = 0; i < bc->numQueues; i++)
+        if (bc->queues[i] != QID_DROP)
+          fc->bundleOf[bc->queues[i]] = b;
+      fc->idleTsc[b] = (uint64_t) fc->idleUsec[b] * rte_get_tsc_hz() / US_PER_S;
+      fc->numBundles++;
+    }
+  if (fc->numBundles == 0)
+    return 0;
+
+  // The tables are kept across reloads: pinned flows follow the new bundle map on their next pkt
+  for (unsigned e = 0; e < RTE_MAX(sc->numRxCores, 1); e++)
+    if (ss->flowAssign[e].hash == NULL && TmFlowAssignCreate(&ss->flowAssign[e], sc->schedId, e) != 0)
+      return -1;
+  printf("Conf #%u: flows of %u bundles assigned to their least loaded queue\n", cf->version, fc->numBundles);
+  return 0;
+}
+
+// Queue of bundle bid with the fewest pinned flows, ties broken on the queued bytes
+static uint16_t
+TmFlowAssignLeastLoaded(const TmConf *cf, SchedState *ss, uint16_t bid)
+{
+  const BundleConf *bc = &cf->bundleConf[bid];
+  uint16_t best = QID_DROP;
+  uint32_t bestFlows = UINT32_MAX;
+  uint64_t bestBytes = UINT64_MAX;
+
+  for (uint16_t i = 0; i < bc->numQueues; i++)
+    {
+      uint16_t qid = bc->queues[i];
+      uint32_t pkts;
+      uint64_t bytes;
+
+      if (qid == QID_DROP)
+        continue;
+      uint32_t flows = __atomic_load_n(&ss->flowAssignFlows[qid], __ATOMIC_RELAXED);
+      TmBufferOcc(ss, qid, &pkts, &bytes);
+      if (flows < bestFlows || (flows == bestFlows && bytes < bestBytes))
+        {
+          best = qid;
+          bestFlows = flows;
+          bestBytes = bytes;
+        }
+    }
+  return best;
+}
+
+static inline void
+TmFlowAssignPin(SchedState *ss, FlowAssignEntry *fe, uint16_t qid)
+{
+  fe->qid = qid;
+  __atomic_fetch_add(&ss->flowAssignFlows[qid], 1, __ATOMIC_RELAXED);
+}
+
+static inline void
+TmFlowAssignUnpin(SchedState *ss, FlowAssignEntry *fe)
+{
+  __atomic_fetch_sub(&ss->flowAssignFlows[fe->qid], 1, __ATOMIC_RELAXED);
+}
+
+uint16_t
+TmFlowAssign(const TmConf *cf, SchedState *ss, FlowAssignState *fa, struct rte_mbuf *mbuf,
+             uint16_t qid, uint64_t tsc, EnqueueThreadStats *es)
+{
+  const FlowAssignConf *fc = &cf->flowAssign;
+  FlowKey key;
+
+  if (qid >= cf->queuesNum || fc->bundleOf[qid] == FLOW_ASSIGN_NO_BUNDLE || fa->hash == NULL ||
+      !TmFlowKeyGet(mbuf, FLOW_KEY_5TUPLE, &key))
+    return qid;
+  uint16_t bid = fc->bundleOf[qid];
+
+  int32_t pos = rte_hash_lookup(fa->hash, &key);
+  if (pos >= 0)
+    {
+      FlowAssignEntry *fe = &fa->entry[pos];
+      fe->lastTsc = tsc;
+      if (likely(fc->bundleOf[fe->qid] == bid))
+        return fe->qid;
+
+      // A reload moved the queue out of the flow's bundle
+      TmFlowAssignUnpin(ss, fe);
+      TmFlowAssignPin(ss, fe, TmFlowAssignLeastLoaded(cf, ss, bid));
+      return fe->qid;
+    }
+
+  pos = rte_hash_add_key(fa->hash, &key);
+  if (unlikely(pos < 0))
+    {
+      es->flowAssignFull++;
+      return qid;
+    }
+  FlowAssignEntry *fe = &fa->entry[pos];
+  fe->key = key;
+  fe->lastTsc = tsc;
+  TmFlowAssignPin(ss, fe, TmFlowAssignLeastLoaded(cf, ss, bid));
+  fa->numFlows++;
+  es->flowAssignNew++;
+  return fe->qid;
+}
+
+void
+TmFlowAssignAge(const TmConf *cf, SchedState *ss, FlowAssignState *fa, uint64_t tsc,
+                EnqueueThreadStats *es)
+{
+  const FlowAssignConf *fc = &cf->flowAssign;
+
+  if (fa->numFlows == 0)
+    return;
+  for (unsigned k = 0; k < FLOW_ASSIGN_AGE_SCAN; k++)
+    {
+      FlowAssignEntry *fe = &fa->entry[fa->ageCursor];
+      fa->ageCursor = (fa->ageCursor + 1) & (FLOW_ASSIGN_ENTRIES_MAX - 1);
+      if (fe->lastTsc == 0)
+        continue;
+
+      // Flows of a bundle no longer assigned are released at once
+      uint16_t bid = fc->bundleOf[fe->qid];
+      if (bid != FLOW_ASSIGN_NO_BUNDLE && tsc - fe->lastTsc < fc->idleTsc[bid])
+        continue;
+      rte_hash_del_key(fa->hash, &fe->key);
+      TmFlowAssignUnpin(ss, fe);
+      fe->lastTsc = 0;
+      fa->numFlows--;
+      es->flowAssignAged++;
+    }
+}
+
+void
+TmFlowAssignDump(SchedConf *sc, SchedState *ss)
+{
+  uint64_t now = rte_rdtsc();
+  char src[INET_ADDRSTRLEN], dst[INET_ADDRSTRLEN];
+
+  // Read while the enqueue lcores run: an entry may be printed half updated
+  for (unsigned e = 0; e < RTE_MAX(sc->numRxCores, 1); e++)
+    {
+      FlowAssignState *fa = &ss->flowAssign[e];
+      if (fa->entry == NULL)
+        continue;
+      printf("Flow assignments of enqueue lcore %u: %u flows\n", sc->rxCores[e], fa->numFlows);
+      for (uint32_t pos = 0; pos < FLOW_ASSIGN_ENTRIES_MAX; pos++)
+        {
+          const FlowAssignEntry *fe = &fa->entry[pos];
+          if (fe->lastTsc == 0)
+            continue;
+          inet_ntop(AF_INET, &fe->key.srcIp, src, sizeof(src));
+          inet_ntop(AF_INET, &fe->key.dstIp, dst, sizeof(dst));
+          printf("  %s:%u > %s:%u proto %u -> q%u idle %"PRIu64" msec\n", src, rte_be_to_cpu_16(fe->key.srcPort),
+                 dst, rte_be_to_cpu_16(fe->key.dstPort), fe->key.proto, fe->qid,
+                 (now > fe->lastTsc) ? (now - fe->lastTsc) * MS_PER_S / rte_get_tsc_hz() : 0);
+        }
+    }
+}
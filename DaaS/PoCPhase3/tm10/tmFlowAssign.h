@@ -0,0 +1,30 @@
+/* tmFlowAssign.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_FLOW_ASSIGN_H_
+#define TM_FLOW_ASSIGN_H_
+
+#include <inttypes.h>
+
+#include "tmDefs.h"
+
+int TmFlowAssignBuild(SchedConf *sc, TmConf *cf);                           // Bundle map of cf->flowAssign, tables on first use
+
+/*
+ * Enqueue lcores: queue of the flow of mbuf, which the legacy classifier mapped to qid. Flows of an assigned
+ * bundle are learned and pinned to its least loaded queue, other pkts keep qid.
+ */
+uint16_t TmFlowAssign(const TmConf *cf, SchedState *ss, FlowAssignState *fa, struct rte_mbuf *mbuf,
+                      uint16_t qid, uint64_t tsc, EnqueueThreadStats *es);
+
+void TmFlowAssignAge(const TmConf *cf, SchedState *ss,                      // Enqueue lcores: release the idle flows
+                     FlowAssignState *fa, uint64_t tsc, EnqueueThreadStats *es); // of the next FLOW_ASSIGN_AGE_SCAN positions
+
+void TmFlowAssignDump(SchedConf *sc, SchedState *ss);                       // Print the pinned flows of every enqueue lcore
+
+#endif // TM_FLOW_ASSIGN_H_
@@ -0,0 +1,139 @@
+/* tmFlowTable.c
+**
+** Exact-match flow table. The [FLOW_TABLE] entries of the scheduler config file are loaded into an
+** rte_hash, keyed by IPv4 5-tuple or by VLAN ID + source MAC, which is looked up once per rx burst.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+
+#include "tmFlowTable.h"
+#include "tmPkt.h"
+
+int
+TmFlowTableReset(SchedConf *sc, TmConf *cf)
+{
+  cf->flowKeyTypes = 0;
+
+  if (cf->flowTable)
+    {
+      rte_hash_reset(cf->flowTable);
+      return 0;
+    }
+
+  char name[RTE_HASH_NAMESIZE];
+  snprintf(name, sizeof(name), "tmFlow-%u-v%u", sc->schedId, cf->version);
+
+  struct rte_hash_parameters param =
+  {
+    .name = name,
+    .entries = FLOW_TABLE_ENTRIES_MAX,
+    .key_len = sizeof(FlowKey),
+    .hash_func = rte_hash_crc,
+    .hash_func_init_val = 0,
+    .socket_id = rte_socket_id(),
+  };
+  cf->flowTable = rte_hash_create(&param);
+  if (cf->flowTable == NULL)
+    {
+      printf("ERROR: rte_hash_create(%s) failed: %s\n", name, rte_strerror(rte_errno));
+      return -1;
+    }
+  return 0;
+}
+
+int
+TmFlowTableAdd(SchedConf *sc, TmConf *cf, const FlowKey *key, uint16_t qid)
+{
+  if (cf->flowTable == NULL && TmFlowTableReset(sc, cf) != 0)
+    return -1;
+
+  int ret = rte_hash_add_key_data(cf->flowTable, key, (void *)(uintptr_t) qid);
+  if (ret != 0)
+    {
+      printf("ERROR: flow table add failed (%d), max %u entries\n", ret, FLOW_TABLE_ENTRIES_MAX);
+      return -1;
+    }
+
+  cf->flowKeyTypes |= (uint8_t) (1 << key->type);
+  return 0;
+}
+
+bool
+TmFlowKeyGet(struct rte_mbuf *mbuf, uint8_t type, FlowKey *key)
+{
+  char *pkt = rte_pktmbuf_mtod(mbuf, char *);
+  bool vlan = is_vlan_pkt(pkt);
+
+  memset(key, 0, sizeof(*key));
+  key->type = type;
+
+  if (type == FLOW_KEY_VLANMAC)
+    {
+      if (!vlan)
+        return false;
+      key->vlanId = GET_VLANID_FROM_TCI(rte_be_to_cpu_16(get_vlanhdr_ptr(pkt)->tci));
+      rte_ether_addr_copy(&((EtherHdr *)pkt)->src_addr, &key->srcMac);
+      return true;
+    }
+
+  // IPv4 only, IPv6 flows are matched by [CLASSIFIER_RULES]
+  PktL3Info pi;
+  if (!TmPktParseL3(mbuf, &pi) || pi.ipVersion != 4)
+    return false;
+
+  Ipv4Hdr *ipv4Hdr = (Ipv4Hdr *) pi.l3Hdr;
+  key->proto = pi.proto;
+  key->srcIp = ipv4Hdr->src_addr;
+  key->dstIp = ipv4Hdr->dst_addr;
+  if (pi.l4Hdr && (key->proto == IPPROTO_UDP || key->proto == IPPROTO_TCP))
+    {
+      // NOTE: The srcPort and dstPort are in same L4 offset location for UDP and TCP headers!!
+      UdpHdr *l4Hdr = (UdpHdr *) pi.l4Hdr;
+      key->srcPort = l4Hdr->src_port;
+      key->dstPort = l4Hdr->dst_port;
+    }
+  return true;
+}
+
+void
+TmFlowTableBurst(const struct rte_hash *ft, uint8_t keyTypes, struct rte_mbuf **mbufs, uint16_t *qids, uint16_t num)
+{
+  static const uint8_t types[] = { FLOW_KEY_5TUPLE, FLOW_KEY_VLANMAC };  // 5-tuple is the more specific key
+  FlowKey keys[num];
+  const void *keyPtrs[num];
+  void *data[num];
+  uint16_t idx[num];
+
+  for (unsigned t = 0; t < RTE_DIM(types); t++)
+    {
+      if ((keyTypes & (1 << types[t])) == 0)
+        continue;
+
+      uint16_t n = 0;
+      for (uint16_t i = 0; i < num; i++)
+        {
+          if (qids[i] == QID_NONE && TmFlowKeyGet(mbufs[i], types[t], &keys[n]))
+            {
+              keyPtrs[n] = &keys[n];
+              idx[n++] = i;
+            }
+        }
+      if (n == 0)
+        continue;
+
+      uint64_t hits = 0;
+      rte_hash_lookup_bulk_data(ft, keyPtrs, n, &hits, data);
+      while (hits)
+        {
+          unsigned k = __builtin_ctzll(hits);
+          hits &= hits - 1;
+          qids[idx[k]] = (uint16_t) (uintptr_t) data[k];
+        }
+    }
+}
@@ -0,0 +1,24 @@
+/* tmFlowTable.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_FLOW_TABLE_H_
+#define TM_FLOW_TABLE_H_
+
+#include <inttypes.h>
+
+#include "tmDefs.h"
+
+int TmFlowTableReset(SchedConf *sc, TmConf *cf);                                   // Empty (or create) cf->flowTable
+int TmFlowTableAdd(SchedConf *sc, TmConf *cf, const FlowKey *key, uint16_t qid); // Add one [FLOW_TABLE] entry
+
+bool TmFlowKeyGet(struct rte_mbuf *mbuf, uint8_t type, FlowKey *key);               // false if the pkt has no such key
+
+void TmFlowTableBurst(const struct rte_hash *ft, uint8_t keyTypes,                 // qids[i] set for the matched pkts,
+                      struct rte_mbuf **mbufs, uint16_t *qids, uint16_t num);        // others are left unchanged
+
+#endif // TM_FLOW_TABLE_H_
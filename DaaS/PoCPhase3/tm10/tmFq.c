@@ -0,0 +1,146 @@
+/* tmFq.c
+**
+** Per-flow fair queuing inside a scheduler queue. A [QUEUE_FQ] GBS queue or EBS class is split into
+** sub-rings selected by a flow hash on the enqueue lcores. When the scheduler picks the queue, the
+** dequeue lcore serves its sub-rings by byte deficit round robin, so that a heavy flow cannot starve
+** the other flows of the same queue. Limits, AQM and credits still apply to the queue as a whole.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include <rte_malloc.h>
+
+#include "tmFq.h"
+
+uint32_t
+TmFqCreate(SchedConf *sc, SchedState *ss, uint16_t qid, unsigned socket, unsigned ringFlags)
+{
+  const FqConf *fc = &sc->conf->fqConf[qid];
+  char name[32];
+
+  if (fc->numSub == 0)
+    return 0;
+
+  FqState *fq = rte_zmalloc_socket("FqState", sizeof(FqState), RTE_CACHE_LINE_SIZE, (int) socket);
+  if (fq == NULL)
+    rte_exit(EXIT_FAILURE, "ERROR: FQ state alloc failed for sid%u qid %u!\n", sc->schedId, qid);
+  fq->numSub = fc->numSub;
+  fq->mask = fc->numSub - 1;
+  fq->fresh = true;
+
+  // The sub-rings share the queue limit: each holds an equal part of it, so that a heavy flow cannot take
+  // the buffer of the others and the ring memory stays that of the queue
+  uint32_t maxPkts = sc->conf->queueLimit[qid].maxPkts;
+  uint32_t ringSize = rte_align32pow2((maxPkts + fq->numSub - 1) / fq->numSub + 1);
+  for (uint16_t s = 0; s < fq->numSub; s++)
+    {
+      snprintf(name, sizeof(name), "fqRing-%u-q%u-%u", sc->schedId, qid, s);
+      fq->sub[s] = rte_ring_create(name, ringSize, socket, ringFlags);
+      if (fq->sub[s] == NULL)
+        rte_exit(EXIT_FAILURE, "ERROR: FQ ring create failed for sid%u qid %u sub %u!\n", sc->schedId, qid, s);
+    }
+  ss->fq[qid] = fq;
+  printf("qid %u: %u FQ sub-rings of %u entries\n", qid, fq->numSub, ringSize);
+  return ringSize * fq->numSub;
+}
+
+int
+TmFqBuild(SchedConf *sc, TmConf *cf)
+{
+  SchedState *ss = &schedState[sc->schedId];
+
+  // A smaller quantum could leave a whole DRR round without a pkt served
+  for (uint16_t qid = 0; qid < NUM_QIDS(cf->queuesNum); qid++)
+    {
+      uint32_t quantumBytes = cf->fqConf[qid].quantumBytes;
+      if (quantumBytes != 0 && quantumBytes < cf->maxPktSize)
+        {
+          printf("ERROR: qid %u FQ quantum %u is below the max pkt size %u\n", qid, quantumBytes, cf->maxPktSize);
+          return -1;
+        }
+    }
+
+  // Sub-rings exist once the dequeue lcore started: a reload can only change the quanta
+  if (ss->txRing == NULL)
+    return 0;
+  for (uint16_t qid = 0; qid < NUM_QIDS(cf->queuesNum); qid++)
+    {
+      uint16_t numSub = (ss->fq[qid] != NULL) ? ss->fq[qid]->numSub : 0;
+      if (cf->fqConf[qid].numSub != numSub)
+        printf("WARNING: qid %u FQ sub-queues stay %u until restart\n", qid, numSub);
+    }
+  return 0;
+}
+
+int
+TmFqDequeue(SchedConf *sc, SchedState *ss, const TmConf *cf, uint16_t qid, struct rte_mbuf **mbuf)
+{
+  FqState *fq = ss->fq[qid];
+  uint32_t quantumBytes = cf->fqConf[qid].quantumBytes;
+  int32_t quantum = (int32_t) (quantumBytes ? quantumBytes : sc->maxPktSize);
+
+  // With a quantum of at least maxPktSize, a backlogged sub-ring is served within one round
+  unsigned empty = 0;                  // consecutive empty sub-rings
+  for (unsigned visits = 0; visits <= 2u * fq->numSub; visits++)
+    {
+      uint16_t s = fq->cur;
+
+      if (fq->head[s] == NULL && rte_ring_sc_dequeue(fq->sub[s], (void **) &fq->head[s]) != 0)
+        {
+          // Idle sub-rings keep no deficit
+          fq->head[s] = NULL;
+          fq->deficit[s] = 0;
+          fq->cur = (s + 1) & fq->mask;
+          fq->fresh = true;
+          if (++empty == fq->numSub)
+            {
+              TmBufferActiveEmpty(ss, qid);
+              break;
+            }
+          continue;
+        }
+      empty = 0;
+      if (fq->fresh)
+        {
+          fq->deficit[s] += quantum;
+          fq->fresh = false;
+        }
+      if ((int32_t) fq->head[s]->pkt_len <= fq->deficit[s])
+        {
+          fq->deficit[s] -= (int32_t) fq->head[s]->pkt_len;
+          *mbuf = fq->head[s];
+          fq->head[s] = NULL;
+          return 0;
+        }
+      fq->cur = (s + 1) & fq->mask;
+      fq->fresh = true;
+    }
+  return -EAGAIN;
+}
+
+uint32_t
+TmFqDrain(SchedState *ss, uint16_t qid)
+{
+  DeqBurst *db = &ss->deqBurst[qid];
+  FqState *fq = ss->fq[qid];
+  uint32_t freed = 0;
+
+  for (uint16_t i = db->head; i < db->count; i++, freed++)
+    TmBufferOccDeq(ss, qid, db->pkts[i]->pkt_len);
+  rte_pktmbuf_free_bulk(&db->pkts[db->head], db->count - db->head);
+  db->head = db->count = 0;
+
+  if (fq != NULL)
+    for (uint16_t s = 0; s < fq->numSub; s++)
+      if (fq->head[s] != NULL)
+        {
+          TmBufferOccDeq(ss, qid, fq->head[s]->pkt_len);
+          rte_pktmbuf_free(fq->head[s]);
+          fq->head[s] = NULL;
+          freed++;
+        }
+  return freed;
+}
@@ -0,0 +1,119 @@
+/* tmFq.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_FQ_H_
+#define TM_FQ_H_
+
+#include <inttypes.h>
+#include <rte_hash_crc.h>
+
+#include "tmDefs.h"
+#include "tmBuffer.h"
+#include "tmPkt.h"
+
+uint32_t TmFqCreate(SchedConf *sc, SchedState *ss, uint16_t qid, unsigned socket, unsigned ringFlags); // Sub-rings of qid, returns their entries
+int TmFqBuild(SchedConf *sc, TmConf *cf);                                    // Check cf->fqConf quanta and running sub-rings
+
+/*
+ * Dequeue lcore: next pkt of FQ queue qid by DRR over its sub-rings. Returns -EAGAIN when no pkt can be
+ * served yet, e.g. when the queue occupancy was accounted before the pkts reached their sub-ring. Sub-rings
+ * all found empty make qid no longer active.
+ */
+int TmFqDequeue(SchedConf *sc, SchedState *ss, const TmConf *cf, uint16_t qid, struct rte_mbuf **mbuf);
+
+// Dequeue lcore: free the pkts of qid already taken from its rings, its DeqBurst stash and FQ sub-ring heads.
+// Returns the pkts freed.
+uint32_t TmFqDrain(SchedState *ss, uint16_t qid);
+
+// Flow hash of a pkt: the RSS hash when the port provides it, else the IP addresses and L4 ports
+static inline uint32_t
+TmFqHash(struct rte_mbuf *mbuf)
+{
+  PktL3Info pi;
+  uint32_t h;
+
+  if (mbuf->ol_flags & RTE_MBUF_F_RX_RSS_HASH)
+    h = mbuf->hash.rss;
+  else if (!TmPktParseL3(mbuf, &pi))
+    return 0;
+  else
+    {
+      // Source then destination address are contiguous in both headers
+      if (pi.ipVersion == 4)
+        h = rte_hash_crc(&((Ipv4Hdr *) pi.l3Hdr)->src_addr, 2 * sizeof(uint32_t), pi.proto);
+      else
+        h = rte_hash_crc(&((Ipv6Hdr *) pi.l3Hdr)->src_addr, 32, pi.proto);
+      if (pi.l4Hdr != NULL && (pi.proto == IPPROTO_TCP || pi.proto == IPPROTO_UDP))
+        {
+          uint32_t ports;
+          memcpy(&ports, pi.l4Hdr, sizeof(ports));
+          h = rte_hash_crc_4byte(ports, h);
+        }
+    }
+  // The low RSS hash bits also pick the rx queue: fold in the high bits
+  return h ^ (h >> 16);
+}
+
+// Enqueue lcores: ring of mbuf in scheduler queue qid
+static inline struct rte_ring *
+TmFqRing(SchedState *ss, uint16_t qid, struct rte_mbuf *mbuf)
+{
+  FqState *fq = ss->fq[qid];
+
+  if (likely(fq == NULL))
+    return ss->rxRing[qid];
+  return fq->sub[TmFqHash(mbuf) & fq->mask];
+}
+
+// Dequeue lcore: head pkt of queue qid without FQ, left in the queue. The rxRing is read DEQ_BURST_PKTS_MAX
+// pkts at a time. NULL when the ring is empty, qid is then no longer active.
+static inline struct rte_mbuf *
+TmFqQueuePeek(SchedState *ss, uint16_t qid)
+{
+  DeqBurst *db = &ss->deqBurst[qid];
+
+  if (db->head == db->count)
+    {
+      db->head = 0;
+      db->count = (uint16_t) rte_ring_sc_dequeue_burst(ss->rxRing[qid], (void **) db->pkts, DEQ_BURST_PKTS_MAX, NULL);
+      if (db->count == 0)
+        {
+          TmBufferActiveEmpty(ss, qid);
+          return NULL;
+        }
+    }
+  return db->pkts[db->head];
+}
+
+// Dequeue lcore: next pkt of scheduler queue qid, 0 on success. Returns -EAGAIN when the queue is marked
+// active before its pkts reached the ring, see TmBufferQueueActive().
+static inline int
+TmFqQueueDequeue(SchedConf *sc, SchedState *ss, const TmConf *cf, uint16_t qid, struct rte_mbuf **mbuf)
+{
+  if (likely(ss->fq[qid] == NULL))
+    {
+      *mbuf = TmFqQueuePeek(ss, qid);
+      if (*mbuf == NULL)
+        return -EAGAIN;
+      ss->deqBurst[qid].head++;
+      return 0;
+    }
+  return TmFqDequeue(sc, ss, cf, qid, mbuf);
+}
+
+// Dequeue lcore: bytes of the next pkt of qid, 0 if none. FQ queues are not read ahead: maxPktSize.
+static inline uint32_t
+TmFqQueueNextLen(SchedConf *sc, SchedState *ss, uint16_t qid)
+{
+  if (unlikely(ss->fq[qid] != NULL))
+    return sc->maxPktSize;
+  struct rte_mbuf *mbuf = TmFqQueuePeek(ss, qid);
+  return (mbuf != NULL) ? mbuf->pkt_len : 0;
+}
+
+#endif // TM_FQ_H_
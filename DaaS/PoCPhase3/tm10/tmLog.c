@@ -0,0 +1,245 @@
+/* tmLog.c
+**
+** Asynchronous logging backend for OrionLog.h (ORION_LOG_ASYNC): per-lcore lock-free record rings
+** filled by the lcores and drained/formatted by the main lcore.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include "tmDefs.h"
+#include "../common/OrionLog.h"
+#include <stdio.h>
+#include <string.h>
+#include <rte_malloc.h>
+
+#ifdef ORION_LOG_ASYNC
+
+#define LOG_RING_SIZE   1024                   // records per lcore, power of 2
+#define LOG_LINE_MAX    512
+
+typedef struct LogRec_s
+{
+  const OrionLogSite *site;
+  uint64_t tsc;
+  uint32_t pktCntr;
+  uint16_t nargs;
+  uint32_t suppressed;                         // records of this site suppressed before this one
+  uint64_t args[ORION_LOG_ARGS_MAX];
+} LogRec;
+
+// Single producer (owner lcore), single consumer (OrionLogDrain on the main lcore)
+typedef struct LogRing_s
+{
+  uint32_t head __rte_cache_aligned;           // written by owner lcore only
+  uint64_t lost;                               // records lost because the ring was full
+  uint32_t tail __rte_cache_aligned;           // written by OrionLogDrain() only
+  uint64_t lostReported;
+  LogRec   rec[LOG_RING_SIZE] __rte_cache_aligned;
+} LogRing;
+
+static LogRing *logRing[RTE_MAX_LCORE];
+static uint64_t logTscHz;                      // 0 until OrionLogInit(): no rate limiting yet
+static uint64_t logTsc0;
+
+int
+OrionLogInit(void)
+{
+  unsigned lcoreId;
+
+  RTE_LCORE_FOREACH(lcoreId)
+    {
+      logRing[lcoreId] = rte_zmalloc_socket("OrionLogRing", sizeof(LogRing), RTE_CACHE_LINE_SIZE,
+                                            rte_lcore_to_socket_id(lcoreId));
+      if (logRing[lcoreId] == NULL)
+        {
+          printf("ERROR: cannot allocate log ring for lcore %u\n", lcoreId);
+          return -1;
+        }
+    }
+
+  logTsc0 = rte_rdtsc();
+  logTscHz = rte_get_tsc_hz();
+  return 0;
+}
+
+// printf() of one record, the conversion specs of site->fmt are applied one at a time to the 64-bit args
+static void
+LogRecPrint(const LogRec *rec, unsigned lcoreId)
+{
+  const OrionLogSite *site = rec->site;
+  char out[LOG_LINE_MAX];
+  char spec[32];
+  size_t len = 0;
+  unsigned a = 0;
+
+  if (rec->suppressed)
+    printf("%s:%u lcore%u %u messages suppressed\n", site->level, site->line, lcoreId, rec->suppressed);
+
+  int w = snprintf(out, sizeof(out), "%s:%u Pkt%u lcore%u +%.6fs ", site->level, site->line, rec->pktCntr,
+                   lcoreId, logTscHz ? (double) (rec->tsc - logTsc0) / logTscHz : 0.0);
+  len = (w > 0) ? RTE_MIN((size_t) w, sizeof(out) - 1) : 0;
+
+  const char *p = site->fmt;
+  while (*p != '\0' && len < sizeof(out) - 1)
+    {
+      if (*p != '%')
+        {
+          out[len++] = *p++;
+          continue;
+        }
+      if (p[1] == '%')
+        {
+          out[len++] = '%';
+          p += 2;
+          continue;
+        }
+
+      // Keep flags, width and precision; replace the length modifier by the one of the 64-bit slot
+      const char *q = p + 1;
+      size_t s = 0;
+      int h = 0, l = 0;
+      spec[s++] = '%';
+      while (*q != '\0' && strchr("-+ #0123456789.", *q) && s < sizeof(spec) - 4)
+        spec[s++] = *q++;
+      while (*q != '\0' && strchr("hlLqjzt", *q))
+        {
+          h += (*q == 'h');
+          l += (*q != 'h');
+          q++;
+        }
+      char conv = *q;
+      if (conv != '\0')
+        q++;
+
+      uint64_t v = (a < rec->nargs) ? rec->args[a++] : 0;
+      w = 0;
+      switch (conv)
+        {
+        case 'd': case 'i':
+          {
+            int64_t sv = (h >= 2) ? (int64_t)(int8_t) v : (h == 1) ? (int64_t)(int16_t) v :
+                         (l == 0) ? (int64_t)(int32_t) v : (int64_t) v;
+            spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+            w = snprintf(out + len, sizeof(out) - len, spec, (long long) sv);
+          }
+          break;
+        case 'u': case 'x': case 'X': case 'o':
+          {
+            uint64_t uv = (h >= 2) ? (uint8_t) v : (h == 1) ? (uint16_t) v : (l == 0) ? (uint32_t) v : v;
+            spec[s++] = 'l'; spec[s++] = 'l'; spec[s++] = conv; spec[s] = '\0';
+            w = snprintf(out + len, sizeof(out) - len, spec, (unsigned long long) uv);
+          }
+          break;
+        case 'c':
+          spec[s++] = conv; spec[s] = '\0';
+          w = snprintf(out + len, sizeof(out) - len, spec, (int) v);
+          break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+          {
+            union { uint64_t u; double d; } x = { .u = v };
+            spec[s++] = conv; spec[s] = '\0';
+            w = snprintf(out + len, sizeof(out) - len, spec, x.d);
+          }
+          break;
+        case 's':
+          spec[s++] = conv; spec[s] = '\0';
+          w = snprintf(out + len, sizeof(out) - len, spec, v ? (const char *)(uintptr_t) v : "(null)");
+          break;
+        case 'p':
+          spec[s++] = conv; spec[s] = '\0';
+          w = snprintf(out + len, sizeof(out) - len, spec, (void *)(uintptr_t) v);
+          break;
+        default:
+          // Unsupported spec (e.g. '*' width): print it verbatim
+          w = snprintf(out + len, sizeof(out) - len, "%.*s", (int)(q - p), p);
+          break;
+        }
+      if (w > 0)
+        len = RTE_MIN(len + (size_t) w, sizeof(out) - 1);
+      p = q;
+    }
+  out[len] = '\0';
+  fputs(out, stdout);
+}
+
+void
+OrionLogPost(OrionLogSite *site, uint32_t pktCntr, uint32_t nargs, const uint64_t *args)
+{
+  uint64_t tsc = rte_rdtsc();
+
+  // Per-site rate limiting. A site is normally hit by one lcore only, a race would only skew the counts.
+  if (tsc - site->windowTsc > logTscHz)
+    {
+      site->windowTsc = tsc;
+      site->windowCnt = 0;
+    }
+  if (site->windowCnt >= ORION_LOG_SITE_RATE)
+    {
+      __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  site->windowCnt++;
+
+  LogRec *rec, local;
+  unsigned lcoreId = rte_lcore_id();
+  LogRing *r = (lcoreId < RTE_MAX_LCORE) ? logRing[lcoreId] : NULL;
+  if (r == NULL)
+    {
+      rec = &local;                                     // Before OrionLogInit() or non-EAL thread: print now
+    }
+  else
+    {
+      uint32_t head = r->head;
+      if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE)
+        {
+          r->lost++;
+          return;
+        }
+      rec = &r->rec[head & (LOG_RING_SIZE - 1)];
+    }
+
+  rec->site = site;
+  rec->tsc = tsc;
+  rec->pktCntr = pktCntr;
+  rec->nargs = (uint16_t) RTE_MIN(nargs, ORION_LOG_ARGS_MAX);
+  rec->suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+  memcpy(rec->args, args, rec->nargs * sizeof(uint64_t));
+
+  if (r == NULL)
+    LogRecPrint(rec, lcoreId);
+  else
+    __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+unsigned
+OrionLogDrain(void)
+{
+  unsigned num = 0;
+
+  for (unsigned lcoreId = 0; lcoreId < RTE_MAX_LCORE; lcoreId++)
+    {
+      LogRing *r = logRing[lcoreId];
+      if (r == NULL)
+        continue;
+
+      uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+      uint32_t tail = r->tail;
+      for (; tail != head; tail++, num++)
+        LogRecPrint(&r->rec[tail & (LOG_RING_SIZE - 1)], lcoreId);
+      __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+      uint64_t lost = r->lost;
+      if (lost != r->lostReported)
+        {
+          printf("ERROR: lcore%u log ring full, %"PRIu64" messages lost\n", lcoreId, lost - r->lostReported);
+          r->lostReported = lost;
+        }
+    }
+
+  return num;
+}
+
+#endif  // ORION_LOG_ASYNC
@@ -6,11 +6,14 @@
 **
 */
 
+#include <rte_malloc.h>
+
 #include "tmDefs.h"
 #include "tmFlow.h"
 #include "parserLib.h"
 
 #include "../common/OrionDpdk.h"
+#include "../common/OrionLog.h"
 
 // debug
 #include "dumpLib.h"
@@ -20,8 +23,8 @@ volatile bool forceQuit;
 uint32_t enabledPortsMask = 0;    // mask of enabled ports
 RunConf runConf;
 IntfConf intfConf[NUM_SCHED_MAX];
-SchedConf schedConf[NUM_SCHED_MAX];
-SchedState schedState[NUM_SCHED_MAX];
+SchedConf *schedConf;
+SchedState *schedState;
 
 static int
 app_launch_one_lcore(__attribute__((unused)) void *dummy)
@@ -41,40 +44,40 @@ signal_handler(int signum)
 }
 
 int
-StreamRatesValidate(SchedConf *sc, uint8_t confId)
+StreamRatesValidate(SchedConf *sc, TmConf *cf)
 {
         // validate total stream rates and set other stream 0 values as well
-        sc->streamCfg[confId][0].streamId = 0;
-        sc->streamCfg[confId][0].srcIP[0] = sc->streamCfg[confId][1].srcIP[0];
-        sc->streamCfg[confId][0].srcIP[1] = sc->streamCfg[confId][1].srcIP[1];
-        sc->streamCfg[confId][0].srcIP[2] = sc->streamCfg[confId][1].srcIP[2];
-        sc->streamCfg[confId][0].srcIP[3] = sc->streamCfg[confId][1].srcIP[3];
-        sc->streamCfg[confId][0].dstIP[0] = sc->streamCfg[confId][1].dstIP[0];
-        sc->streamCfg[confId][0].dstIP[1] = sc->streamCfg[confId][1].dstIP[1];
-        sc->streamCfg[confId][0].dstIP[2] = sc->streamCfg[confId][1].dstIP[2];
-        sc->streamCfg[confId][0].dstIP[3] = sc->streamCfg[confId][1].dstIP[3];
-
-	sc->numStreams++;
+        cf->streamCfg[0].streamId = 0;
+        cf->streamCfg[0].srcIP[0] = cf->streamCfg[1].srcIP[0];
+        cf->streamCfg[0].srcIP[1] = cf->streamCfg[1].srcIP[1];
+        cf->streamCfg[0].srcIP[2] = cf->streamCfg[1].srcIP[2];
+        cf->streamCfg[0].srcIP[3] = cf->streamCfg[1].srcIP[3];
+        cf->streamCfg[0].dstIP[0] = cf->streamCfg[1].dstIP[0];
+        cf->streamCfg[0].dstIP[1] = cf->streamCfg[1].dstIP[1];
+        cf->streamCfg[0].dstIP[2] = cf->streamCfg[1].dstIP[2];
+        cf->streamCfg[0].dstIP[3] = cf->streamCfg[1].dstIP[3];
+
+	cf->numStreams++;
 
         float total=0;
-        for (int i=0; i<sc->numStreams; i++)
-                total += sc->streamCfg[confId][i].rate;
+        for (int i=0; i<cf->numStreams; i++)
+                total += cf->streamCfg[i].rate;
         if (total > (float)(sc->linkSpeedMbps))
                 rte_panic(" Error: total rate %.3f Mb/s of all streams exceeds link capacity %u Mbps\n", total, sc->linkSpeedMbps);
-        if (sc->streamCfg[confId][0].rate == 0)
+        if (cf->streamCfg[0].rate == 0)
         {
-                sc->streamCfg[confId][0].rate =  sc->linkSpeedMbps - total;
-                printf("INFO: stream 0 get leftover bandwidth of %.3f\n", sc->streamCfg[confId][0].rate);
+                cf->streamCfg[0].rate =  sc->linkSpeedMbps - total;
+                printf("INFO: stream 0 get leftover bandwidth of %.3f\n", cf->streamCfg[0].rate);
         }
-        sc->streamCfg[confId][0].pktsize =  PKT_SIZE_DEFAULT;
-        sc->streamCfg[confId][0].vlanId =  0x100;
+        cf->streamCfg[0].pktsize =  PKT_SIZE_DEFAULT;
+        cf->streamCfg[0].vlanId =  0x100;
         //sc->streamCfg[0].vlanPri =  0;
-        sc->streamCfg[confId][0].vlanPri =  7;
+        cf->streamCfg[0].vlanPri =  7;
 //        sc->streamCfg[0].ttl =  32;// AF221201: Removing old behavior
-        sc->streamCfg[confId][0].ttl =  128;
-        sc->streamCfg[confId][0].protocol =  IPPROTO_UDP;
-        sc->streamCfg[confId][0].avg_on_time =  1.0;
-        sc->streamCfg[confId][0].avg_off_time =  0.0;
+        cf->streamCfg[0].ttl =  128;
+        cf->streamCfg[0].protocol =  IPPROTO_UDP;
+        cf->streamCfg[0].avg_on_time =  1.0;
+        cf->streamCfg[0].avg_off_time =  0.0;
         return 0;
 }
 
@@ -124,13 +127,95 @@ TmCpuSocketCheck(SchedConf *sc)
   return txCoreSocket;  // pick this as expected to have rx/tx lcores and ports all on same cpu socket!!
 }
 
+/*
+ * Scheduler tables are allocated once the rx port is known, before any config file is parsed, rather than
+ * in BSS: zeroed on hugepages of the port's NUMA node, so that the lcores take neither a first-touch page
+ * fault nor 4K TLB misses on them.
+ */
+void
+TmSchedAlloc(uint16_t rxPort)
+{
+  if (schedConf != NULL)
+    return;
+
+  int socket = rte_eth_dev_socket_id(rxPort);
+  if (socket < 0)
+    socket = (int) rte_socket_id();
+
+  schedConf = rte_zmalloc_socket("SchedConf", NUM_SCHED_MAX * sizeof(SchedConf), RTE_CACHE_LINE_SIZE, socket);
+  schedState = rte_zmalloc_socket("SchedState", NUM_SCHED_MAX * sizeof(SchedState), RTE_CACHE_LINE_SIZE, socket);
+  if (schedConf == NULL || schedState == NULL)
+    rte_exit(EXIT_FAILURE, "ERROR: scheduler tables alloc of %zu bytes failed on socket%d!\n",
+             NUM_SCHED_MAX * (sizeof(SchedConf) + sizeof(SchedState)), socket);
+  for (unsigned sid = 0; sid < NUM_SCHED_MAX; sid++)
+    {
+      size_t sz = rte_rcu_qsbr_get_memsize(CONF_RCU_READERS);
+      schedConf[sid].confRcu = rte_zmalloc_socket("ConfRcu", sz, RTE_CACHE_LINE_SIZE, socket);
+      if (schedConf[sid].confRcu == NULL || rte_rcu_qsbr_init(schedConf[sid].confRcu, CONF_RCU_READERS) != 0)
+        rte_exit(EXIT_FAILURE, "ERROR: config RCU alloc failed for sid%u!\n", sid);
+    }
+  printf("INFO: scheduler tables of %zu bytes on socket%d\n",
+         NUM_SCHED_MAX * (sizeof(SchedConf) + sizeof(SchedState)), socket);
+}
+
+static void *
+TmSchedTableAlloc(const char *name, size_t num, size_t size, int socket, size_t *bytes)
+{
+  void *t = rte_zmalloc_socket(name, num * size, RTE_CACHE_LINE_SIZE, socket);
+  if (t == NULL)
+    rte_exit(EXIT_FAILURE, "ERROR: %s table alloc of %zu entries failed on socket%d!\n", name, num, socket);
+  *bytes += RTE_CACHE_LINE_ROUNDUP(num * size);
+  return t;
+}
+
+/*
+ * Queue, bundle and path tables of the scheduler, sized from the [CONFIG_TOPLVL] queues of the first config,
+ * which a reload cannot change. Each table is its own allocation on the rx port's socket, so that the tables
+ * written by the enqueue lcores never share a cache line with those of the dequeue lcore.
+ */
+void
+TmSchedTablesAlloc(SchedConf *sc)
+{
+  SchedState *ss = &schedState[sc->schedId];
+  uint16_t n = sc->queuesNum;
+  size_t numQids = NUM_QIDS(n);
+  size_t bytes = 0;
+
+  int socket = rte_eth_dev_socket_id(sc->rxPort);
+  if (socket < 0)
+    socket = (int) rte_socket_id();
+
+  ss->queuesNum = n;
+  ss->activeWords = ACTIVE_MAP_WORDS(n);
+
+  // Read-only once the rings exist
+  ss->rxRing = TmSchedTableAlloc("RxRing", numQids, sizeof(*ss->rxRing), socket, &bytes);
+  ss->fq = TmSchedTableAlloc("FqState", numQids, sizeof(*ss->fq), socket, &bytes);
+
+  // Enqueue lcores
+  ss->queueOcc = TmSchedTableAlloc("QueueOcc", numQids, sizeof(*ss->queueOcc), socket, &bytes);
+  ss->policer = TmSchedTableAlloc("PolicerState", n, sizeof(*ss->policer), socket, &bytes);
+  ss->activeMap = TmSchedTableAlloc("ActiveMap", ss->activeWords, sizeof(*ss->activeMap), socket, &bytes);
+  ss->flowAssignFlows = TmSchedTableAlloc("FlowAssignFlows", n, sizeof(*ss->flowAssignFlows), socket, &bytes);
+  for (unsigned e = 0; e < NUM_ENQ_LCORES_MAX; e++)
+    ss->STATS_ENQUEUE[e].queueDrops = TmSchedTableAlloc("QueueDrops", numQids, sizeof(uint64_t), socket, &bytes);
+
+  // Dequeue lcore
+  ss->gbsPath = TmSchedTableAlloc("PathState", n, sizeof(*ss->gbsPath), socket, &bytes);
+  ss->gbsBundle = TmSchedTableAlloc("BundleState", n, sizeof(*ss->gbsBundle), socket, &bytes);
+  ss->gbsQueue = TmSchedTableAlloc("QueueState", n, sizeof(*ss->gbsQueue), socket, &bytes);
+  ss->activeEmpty = TmSchedTableAlloc("ActiveEmpty", ss->activeWords, sizeof(*ss->activeEmpty), socket, &bytes);
+  ss->aqm = TmSchedTableAlloc("AqmState", numQids, sizeof(*ss->aqm), socket, &bytes);
+  ss->deqBurst = TmSchedTableAlloc("DeqBurst", numQids, sizeof(*ss->deqBurst), socket, &bytes);
+
+  printf("INFO: tables of %u GBS queues, %zu qids: %zu bytes on socket%d\n", n, numQids, bytes, socket);
+}
+
 static void
 TmAppPreinit(void)
 {
   memset(&runConf,    0, sizeof(runConf));
   memset(&intfConf,   0, sizeof(intfConf));
-  memset(&schedConf,  0, sizeof(schedConf));
-  memset(&schedState, 0, sizeof(schedState));
 
   // parse_arg() and config files may subsequently modify default settings!
 
@@ -139,6 +224,11 @@ TmAppPreinit(void)
   runConf.txqId  = 0;
   //  runConf.rxqNum = 3;
   runConf.rxqNum = 1;
+  runConf.rxqPollMode = RXQ_POLL_WRR;
+  for (unsigned q=0; q<NUM_RXQUEUES_MAX; q++)
+    runConf.rxqWeight[q] = 1;
+  runConf.rxqStarveLimit = RXQ_STARVE_LIMIT_DEFAULT;
+  runConf.queueLatencyUsec = QUEUE_LATENCY_USEC_DEFAULT;
   runConf.rxFlows = 0;
   runConf.promiscuous=true;  // true for DPDK to receive all traffic. Disable if unmatched dstMac unicast traffic also handled
 }
@@ -155,6 +245,7 @@ TmAppInit(unsigned portsMask)
   ethdev_init(cpuSocket, portsMask, rc);
 
   sc->tscHzMeasured = tscClockCalibrate(true);  // Another method of TSC calibaration for comparison
+  TmRxClockInit(sc->rxPort);
 
   sc->tscHz = rte_get_tsc_hz();
   sc->timeslotNsec = (uint32_t) sc->maxPktSize * 8 * 1000 / (uint32_t) rc->linkSpeedMbpsConf;
@@ -184,6 +275,7 @@ TmAppInit(unsigned portsMask)
   }
 
   sc->linkSpeedBpMTsc = ((uint64_t) sc->linkSpeedMbps * 1E6 * 1E6) / sc->tscHz;
+  sc->txTscPerByteQ24 = ((sc->tscHz * 8) << TX_TSC_SHIFT) / ((uint64_t) sc->linkSpeedMbps * 1000000);
 
   for (unsigned f=0; rc->rxFlows > f; f++)
   {
@@ -199,9 +291,12 @@ TmAppInit(unsigned portsMask)
       rte_exit(EXIT_FAILURE, "Port%u Flow%u initialization failed!\n", sc->rxPort, f);
   }
 
+  if (rc->flowMarkOffload)
+    TmRxFlowMarkInstall(sc, sc->conf);
+
   printf("INFO: dequeue thread found link speed in %u mbps for port %u\n", sc->linkSpeedMbps, sc->txPort);
 
-  int ret = StreamPktInit(0,0);
+  int ret = StreamPktInit(sc->conf, 0);
   if (ret < 0)
     rte_exit(EXIT_FAILURE, "Error TmStreamsInit\n");
 
@@ -227,6 +322,9 @@ main(int argc, char **argv)
 
   TmAppPreinit();
 
+  if (OrionLogInit() < 0)
+    rte_exit(EXIT_FAILURE, "OrionLogInit() failed!\n");
+
   parse_args(argc, argv);
 
   ethdev_wait_all_ports_up(enabledPortsMask, 5);
@@ -235,7 +333,7 @@ main(int argc, char **argv)
   if (ret < 0)
     rte_exit(EXIT_FAILURE, "TmAppInit(0 failed!\n");
 
-  StreamRatesValidate(&schedConf[0], 0);
+  StreamRatesValidate(&schedConf[0], schedConf[0].conf);  // lcores not launched yet
 
   // debug
   dumpRunConf(&runConf);
@@ -0,0 +1,153 @@
+/* tmPkt.h
+**
+** L3/L4 header parsing shared by the classifiers and the ECN marking. Handles IPv4 with options
+** and IPv6 with extension headers, optionally behind a single VLAN tag.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_PKT_H_
+#define TM_PKT_H_
+
+#include <rte_ip.h>
+
+#include "tmDefs.h"
+
+#define IPV6_EXTHDRS_MAX        4       // extension headers skipped before giving up on the L4 header
+
+typedef struct PktL3Info_s
+{
+  uint8_t  ipVersion;                  // 4, 6 or 0 if not an IP packet
+  uint8_t  proto;                      // IPv4 protocol or IPv6 upper layer next header
+  uint8_t  tos;                        // IPv4 type of service or IPv6 traffic class: dscp(6) ecn(2)
+  uint8_t  ttl;                        // IPv4 time to live or IPv6 hop limit
+  uint32_t flowLabel;                  // IPv6 flow label in host order, 0 for IPv4
+  char    *l3Hdr;                      // Ipv4Hdr or Ipv6Hdr
+  char    *l4Hdr;                      // NULL for non-first fragments or headers beyond the first segment
+} PktL3Info;
+
+static inline bool
+TmPktIpv6ExtHdr(uint8_t nh)
+{
+  return nh == IPPROTO_HOPOPTS || nh == IPPROTO_ROUTING || nh == IPPROTO_DSTOPTS ||
+         nh == IPPROTO_FRAGMENT || nh == IPPROTO_AH;
+}
+
+/*
+ * Parse the IP header of mbuf. Returns false if the packet is neither IPv4 nor IPv6.
+ */
+static inline bool
+TmPktParseL3(struct rte_mbuf *mbuf, PktL3Info *pi)
+{
+  char *pkt = rte_pktmbuf_mtod(mbuf, char *);
+  char *end = pkt + rte_pktmbuf_data_len(mbuf);
+  bool vlan = is_vlan_pkt(pkt);
+  uint16_t etherType = vlan ? get_vlanhdr_ptr(pkt)->type : ((EtherHdr *)pkt)->ether_type;
+
+  pi->l3Hdr = pkt + get_ipv4hdr_offset(vlan);
+  pi->l4Hdr = NULL;
+  pi->flowLabel = 0;
+
+  if (likely(etherType == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)))
+    {
+      Ipv4Hdr *ipv4Hdr = (Ipv4Hdr *) pi->l3Hdr;
+      unsigned ihl = (ipv4Hdr->version_ihl & 0x0f) * 4;
+
+      if ((ipv4Hdr->version_ihl >> 4) != 4 || ihl < sizeof(Ipv4Hdr))
+        {
+          pi->ipVersion = 0;
+          return false;
+        }
+      pi->ipVersion = 4;
+      pi->proto = ipv4Hdr->next_proto_id;
+      pi->tos = ipv4Hdr->type_of_service;
+      pi->ttl = ipv4Hdr->time_to_live;
+      // Ports are only in the first fragment
+      if ((ipv4Hdr->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) == 0 &&
+          pi->l3Hdr + ihl + sizeof(UdpHdr) <= end)
+        pi->l4Hdr = pi->l3Hdr + ihl;
+      return true;
+    }
+
+  if (etherType == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6))
+    {
+      Ipv6Hdr *ipv6Hdr = (Ipv6Hdr *) pi->l3Hdr;
+      uint32_t vtcFlow = rte_be_to_cpu_32(ipv6Hdr->vtc_flow);
+      char *hdr = pi->l3Hdr + sizeof(Ipv6Hdr);
+      uint8_t nh = ipv6Hdr->proto;
+
+      pi->ipVersion = 6;
+      pi->tos = (uint8_t) (vtcFlow >> IPV6_VTC_TC_SHIFT);
+      pi->ttl = ipv6Hdr->hop_limits;
+      pi->flowLabel = vtcFlow & IPV6_VTC_FLOW_MASK;
+
+      for (unsigned e = 0; TmPktIpv6ExtHdr(nh); e++)
+        {
+          if (e == IPV6_EXTHDRS_MAX || hdr + 8 > end)
+            {
+              pi->proto = nh;
+              return true;
+            }
+          uint8_t next = (uint8_t) hdr[0];
+          if (nh == IPPROTO_FRAGMENT)
+            {
+              // Ports are only in the first fragment
+              if ((rte_be_to_cpu_16(*(uint16_t *)(hdr + 2)) & 0xfff8) != 0)
+                {
+                  pi->proto = next;
+                  return true;
+                }
+              hdr += 8;
+            }
+          else if (nh == IPPROTO_AH)
+            hdr += ((unsigned) (uint8_t) hdr[1] + 2) * 4;
+          else
+            hdr += ((unsigned) (uint8_t) hdr[1] + 1) * 8;
+          nh = next;
+        }
+      pi->proto = nh;
+      if (hdr + sizeof(UdpHdr) <= end)
+        pi->l4Hdr = hdr;
+      return true;
+    }
+
+  pi->ipVersion = 0;
+  return false;
+}
+
+/*
+ * Set ECN CE on an ECT(0) or ECT(1) packet. Returns false if the packet is not ECN-capable.
+ */
+static inline bool
+TmPktMarkCE(PktL3Info *pi)
+{
+  uint8_t ecn = pi->tos & 0x03;
+  if (ecn != 0x01 && ecn != 0x02)
+    return false;
+
+  if (pi->ipVersion == 4)
+    {
+      // RFC 1624 incremental update of the checksum for the version_ihl/tos word: HC' = ~(~HC + ~m + m')
+      Ipv4Hdr *ip = (Ipv4Hdr *) pi->l3Hdr;
+      uint16_t old = (uint16_t) (ip->version_ihl << 8 | ip->type_of_service);
+      ip->type_of_service |= 0x03;
+      uint16_t new = (uint16_t) (ip->version_ihl << 8 | ip->type_of_service);
+      uint32_t sum = (uint16_t) ~rte_be_to_cpu_16(ip->hdr_checksum) + (uint16_t) ~old + new;
+      sum = (sum & 0xffff) + (sum >> 16);
+      sum = (sum & 0xffff) + (sum >> 16);
+      ip->hdr_checksum = rte_cpu_to_be_16((uint16_t) ~sum);
+    }
+  else
+    {
+      // ECN is the low 2 bits of the traffic class, no checksum
+      Ipv6Hdr *ip6 = (Ipv6Hdr *) pi->l3Hdr;
+      ip6->vtc_flow |= rte_cpu_to_be_32(0x03 << IPV6_VTC_TC_SHIFT);
+    }
+  pi->tos |= 0x03;
+  return true;
+}
+
+#endif // TM_PKT_H_
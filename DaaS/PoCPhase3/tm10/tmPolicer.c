@@ -0,0 +1,67 @@
+/* tmPolicer.c
+**
+** Per GBS queue ingress policer. The [GBS_QUEUE_POLICER] rows of the scheduler config file
+** are turned into rte_meter srTCM/trTCM profiles, metered by the enqueue lcores before a
+** packet is admitted to its rxRing. The enqueue lcores share one meter per queue.
+**
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#include "tmPolicer.h"
+#include "tmBundle.h"
+
+int
+TmPolicerBuild(SchedConf *sc, TmConf *cf)
+{
+  static const PolicerConf unset;
+  const TmConf *prev = sc->conf;      // NULL for the start-up config
+  uint16_t numPolicers = 0;
+
+  for (uint16_t q = 1; q < cf->queuesNum; q++)
+    {
+      PolicerConf *pc = &cf->policerConf[q];
+      memset(&pc->profile, 0, sizeof(pc->profile));
+
+      if (pc->mode != POLICER_NONE)
+        {
+          uint32_t cirMbps = pc->cirMbps ? pc->cirMbps : bundleRateOfQueue(cf, q);
+          if (cirMbps == 0)
+            {
+              printf("ERROR: GBS queue %u policer has no rate and is not in a rated bundle\n", q);
+              return -1;
+            }
+
+          int ret;
+          uint64_t cir = (uint64_t) cirMbps * 1000000 / 8;  // bytes per second
+          if (pc->mode == POLICER_SRTCM)
+            {
+              struct rte_meter_srtcm_params params = { .cir = cir, .cbs = pc->cbs, .ebs = pc->ebs };
+              ret = rte_meter_srtcm_profile_config(&pc->profile.srtcm, &params);
+            }
+          else
+            {
+              uint64_t pir = (uint64_t) pc->pirMbps * 1000000 / 8;
+              struct rte_meter_trtcm_params params = { .cir = cir, .pir = pir, .cbs = pc->cbs, .pbs = pc->ebs };
+              ret = (pir < cir) ? -EINVAL : rte_meter_trtcm_profile_config(&pc->profile.trtcm, &params);
+            }
+          if (ret != 0)
+            {
+              printf("ERROR: GBS queue %u policer profile config failed: %d\n", q, ret);
+              return -1;
+            }
+          numPolicers++;
+        }
+
+      // Running meters are kept when a reload leaves the queue's policer unchanged
+      const PolicerConf *cur = (prev != NULL) ? &prev->policerConf[q] : &unset;
+      uint32_t gen = (prev != NULL) ? prev->policerGen[q] : 0;
+      cf->policerGen[q] = gen + ((memcmp(pc, cur, sizeof(*pc)) != 0) ? 1 : 0);
+    }
+
+  if (numPolicers != 0)
+    printf("Conf #%u: %u GBS queue policers\n", cf->version, numPolicers);
+  return 0;
+}
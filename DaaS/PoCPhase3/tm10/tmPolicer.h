@@ -0,0 +1,73 @@
+/* tmPolicer.h
+*
+**              © 2025 Nokia
+**              Licensed under the BSD 3-Clause Clear License
+**              SPDX-License-Identifier: BSD-3-Clause-Clear
+**
+*/
+
+#ifndef TM_POLICER_H_
+#define TM_POLICER_H_
+
+#include <inttypes.h>
+#include <rte_meter.h>
+#include <rte_spinlock.h>
+
+#include "tmDefs.h"
+
+int TmPolicerBuild(SchedConf *sc, TmConf *cf);                               // Build rte_meter profiles of cf->policerConf
+
+/*
+ * Meter one pkt of GBS queue qid with the queue's shared meter ps.
+ * Returns qid if accepted, otherwise the color action: QID_EBS(class) to remark or QID_DROP.
+ */
+static inline uint16_t
+TmPolicerCheck(const TmConf *cf, PolicerState *ps, uint16_t qid, uint64_t tsc, uint32_t pktLen,
+               EnqueueThreadStats *es)
+{
+  const PolicerConf *pc = &cf->policerConf[qid];
+  // rte_meter only reads the profiles, it just does not declare them const
+  struct rte_meter_srtcm_profile *srtcm = (struct rte_meter_srtcm_profile *) &pc->profile.srtcm;
+  struct rte_meter_trtcm_profile *trtcm = (struct rte_meter_trtcm_profile *) &pc->profile.trtcm;
+  enum rte_color color;
+
+  if (likely(pc->mode == POLICER_NONE))
+    return qid;
+
+  rte_spinlock_lock(&ps->lock);
+  // A burst time older than the last metered one would underflow the meter's time delta
+  if (unlikely(tsc < ps->tsc))
+    tsc = ps->tsc;
+  ps->tsc = tsc;
+  if (pc->mode == POLICER_SRTCM)
+    {
+      if (unlikely(ps->gen != cf->policerGen[qid]))
+        {
+          rte_meter_srtcm_config(&ps->m.srtcm, srtcm);
+          ps->gen = cf->policerGen[qid];
+        }
+      color = rte_meter_srtcm_color_blind_check(&ps->m.srtcm, srtcm, tsc, pktLen);
+    }
+  else
+    {
+      if (unlikely(ps->gen != cf->policerGen[qid]))
+        {
+          rte_meter_trtcm_config(&ps->m.trtcm, trtcm);
+          ps->gen = cf->policerGen[qid];
+        }
+      color = rte_meter_trtcm_color_blind_check(&ps->m.trtcm, trtcm, tsc, pktLen);
+    }
+  rte_spinlock_unlock(&ps->lock);
+
+  es->policerColors[color]++;
+  uint16_t action = pc->action[color];
+  if (likely(action == QID_NONE))
+    return qid;
+  if (action == QID_DROP)
+    es->policerDrops++;
+  else
+    es->policerRemarks++;
+  return action;
+}
+
+#endif // TM_POLICER_H_
@@ -7,7 +7,18 @@
 
 #include "tmDefs.h"
 #include "tmBundle.h"
+#include "tmClassifier.h"
+#include "tmFlowTable.h"
+#include "tmFlow.h"
 #include "tmStats.h"
+#include "tmPkt.h"
+#include "tmPolicer.h"
+#include "tmBuffer.h"
+#include "tmAqm.h"
+#include "tmFq.h"
+#include "tmEbs.h"
+#include "tmFlowAssign.h"
+#include "tmConf.h"
 #include "parserLib.h"
 #include "../common/OrionLog.h"
 #include <stdio.h> 
@@ -15,15 +26,6 @@
 
 #include <stdint.h>
     
-// dropping threshold
-#define DROP_QUEUE_THRESHOLD  128
-
-// #define ECN_MARK_THRESHOLD    4053
-
-uint32_t ecn_mark_threshold = 0;
-
-
-
 
 // debug
 //#include "dumpLib.h"
@@ -32,9 +34,6 @@ int debugLog = 0;
 int errorLog = 1;
 int infoLog = 1;
 
-uint16_t	schedClassifierType;
-VlanLookupEntry vlanid_table[4096];
-
 extern void SummaryEnqueueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint64_t *drops);
 extern void SummaryDequeueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint64_t *drops);
 extern void SummaryTxStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs);
@@ -52,22 +51,14 @@ update_sched_mac(struct rte_mbuf *m, uint8_t sid)
 
 
 static inline void
-maybe_mark_ecn(struct rte_mbuf *m, struct rte_ring *r)
+maybe_mark_ecn(struct rte_mbuf *m, uint64_t qbytes, uint32_t ecnBytes)
 {
-    if (ecn_mark_threshold == 0 || unlikely(rte_ring_count(r) < ecn_mark_threshold))
+    if (ecnBytes == 0 || likely(qbytes < ecnBytes))
         return;
 
-    char     *pkt  = rte_pktmbuf_mtod(m, char *);
-    bool      vlan = is_vlan_pkt(pkt);
-    Ipv4Hdr  *ip   = get_ipv4hdr_ptr(pkt, vlan);
-
-    /* Only IPv4 is shown – add IPv6 flow‑label code if you need it */
-    uint8_t ecn = ip->type_of_service & 0x03;     /* lower 2 bits */
-    if (ecn == 0x01 || ecn == 0x02) {             /* ECT(1) or ECT(0) */
-        ip->type_of_service |= 0x03;              /* set CE (11b)     */
-        ip->hdr_checksum     = 0;
-        ip->hdr_checksum     = rte_ipv4_cksum(ip); 
-    }
+    PktL3Info pi;
+    if (TmPktParseL3(m, &pi))
+        TmPktMarkCE(&pi);                         /* ECT(0)/ECT(1) only */
 }
 
 
@@ -79,13 +70,13 @@ dump_queues(const SchedState *ss, const SchedConf *sc, uint64_t now_us)
     /* Print timestamp first */
     printf("%" PRIu64, now_us);
 
-    /* active GBS set == confId 0; skip Q0 (drop queue) */
+    /* skip Q0 (drop queue) */
     for (int q = 1; q < sc->queuesNum; q++)
-        printf(",%u", rte_ring_count(ss->gbsQueue[0][q].rxRing));
+        printf(",%u", rte_ring_count(ss->rxRing[q]));
 
     /* EBS classes 0‑(TM_NUM_CLASSES‑1) */
     for (int c = 0; c < TM_NUM_CLASSES; c++)
-        printf(",%u", rte_ring_count(ss->ebsQueue[c].rxRing));
+        printf(",%u", rte_ring_count(ss->rxRing[QID_EBS(sc->queuesNum, c)]));
 
     printf("\n");
 }
@@ -113,10 +104,10 @@ void mac_address_printf(struct rte_ether_addr *macaddr)
 }
 
 static inline bool
-mac_address_is_same(struct rte_ether_addr *mac1, struct rte_ether_addr *mac2)
+mac_address_is_same(const struct rte_ether_addr *mac1, const struct rte_ether_addr *mac2)
 {
-  uint8_t *locaddr1 = (uint8_t *)mac1;
-  uint8_t *locaddr2 = (uint8_t *)mac2;
+  const uint8_t *locaddr1 = (const uint8_t *)mac1;
+  const uint8_t *locaddr2 = (const uint8_t *)mac2;
   
   int ii = 0;
   for (; (ii < 6) && (locaddr1[ii] == locaddr2[ii]); ii++);
@@ -160,32 +151,38 @@ SchedTxThreadInit(void)
     }
 }
 
-// Create a single txRing for scheduler output to tx thread.
+// Create the rxRing of each GBS queue and EBS class, sized by its buffer limit, and a single txRing
+// for scheduler output to tx thread.
 static void
 CreateFifoRings(unsigned sid)
 {
-#define APP_RING_SIZE (262144)    // TESTING
 #define MAX_NAME_LEN  32
   SchedConf  *sc = &schedConf[sid];
   SchedState *ss = &schedState[sid];
   char ring_name[MAX_NAME_LEN];
 
   uint32_t socket = rte_lcore_to_socket_id(sc->rxCore);  // Needed in case of NUMA. We should keep both lcores on same CPU socket!!
-  uint32_t ringSize = APP_RING_SIZE;
+  uint32_t ringSize;
+  uint64_t ringEntries = 0;
   struct rte_ring *ring;
 
+  // Several enqueue lcores share the scheduler queues: multi-producer rings. Each flow stays on one rx queue
+  // (RSS) and thus on one producer, so per-flow ordering is kept.
+  unsigned rxRingFlags = (sc->numRxCores > 1) ? RING_F_SC_DEQ : (RING_F_SP_ENQ | RING_F_SC_DEQ);
+
   printf("CreateFifoRings(): Creating Fifo Rings for GBS queues\n");
-  for (unsigned i=0; i<TM_NUM_RX_RINGS; i++)
+  for (unsigned i=0; i<sc->queuesNum; i++)
     {
       snprintf(ring_name, MAX_NAME_LEN, "rxRing-%u-q%u", sc->schedId, i);
       ring = rte_ring_lookup(ring_name);
       if (ring)
 	rte_exit(EXIT_FAILURE, "ERROR: rxRing exist for sid%u queue#%u!\n", sid, i);
-      ring = rte_ring_create(ring_name, ringSize, socket, RING_F_SP_ENQ | RING_F_SC_DEQ);
+      ringSize = TmBufferRingSize(sc, (uint16_t) i);
+      ringEntries += ringSize;
+      ring = rte_ring_create(ring_name, ringSize, socket, rxRingFlags);
       if (ring == NULL)
 	rte_exit(EXIT_FAILURE, "ERROR: rxRing create failed for sid%u queue#%u!\n", sid, i);
-      // RX queue does not need to switch between configs so hard code confId
-      ss->gbsQueue[0][i].rxRing = ring;
+      ss->rxRing[i] = ring;
       //printf("CreateFifoRings(): Created %s size=%u, socket=%u, lcore=%u\n", ring_name, ringSize, socket, rte_lcore_id());
     }
   printf("CreateFifoRings(): LAST GBS Created %s size=%u, socket=%u, lcore=%u\n", ring_name, ringSize, socket, rte_lcore_id());
@@ -197,15 +194,21 @@ CreateFifoRings(unsigned sid)
       ring = rte_ring_lookup(ring_name);
       if (ring)
 	rte_exit(EXIT_FAILURE, "ERROR: rxRing exists for sid%u EBS queue#%u!\n", sid, i);
-      ring = rte_ring_create(ring_name, ringSize, socket, RING_F_SP_ENQ | RING_F_SC_DEQ);
+      ringSize = TmBufferRingSize(sc, QID_EBS(sc->queuesNum, i));
+      ringEntries += ringSize;
+      ring = rte_ring_create(ring_name, ringSize, socket, rxRingFlags);
       if (ring == NULL)
 	rte_exit(EXIT_FAILURE, "ERROR: rxRing create failed for sid%u EBS queue#%u!\n", sid, i);
-      // RX queue does not need to switch between configs so hard code confId
-      ss->ebsQueue[i].rxRing = ring;
+      ss->rxRing[QID_EBS(sc->queuesNum, i)] = ring;
       //printf("CreateFifoRings(): Created %s size=%u, socket=%u, lcore=%u\n", ring_name, ringSize, socket, rte_lcore_id());
     }
   printf("CreateFifoRings(): LAST EBS Created %s size=%u, socket=%u, lcore=%u\n", ring_name, ringSize, socket, rte_lcore_id());
 
+  // Per-flow sub-rings of the [QUEUE_FQ] queues
+  for (uint16_t qid = 1; qid < NUM_QIDS(sc->queuesNum); qid++)
+    ringEntries += TmFqCreate(sc, ss, qid, socket, rxRingFlags);
+  printf("CreateFifoRings(): %"PRIu64" rxRing entries in total for --qlat %u usec\n", ringEntries, runConf.queueLatencyUsec);
+
   if (TM_NUM_TX_RINGS != 1)
     {
       rte_exit(EXIT_FAILURE, "ERROR: only single txRing supported!\n");  
@@ -217,6 +220,7 @@ CreateFifoRings(unsigned sid)
       ring = rte_ring_lookup(ring_name);
       if (ring)
 	rte_exit(EXIT_FAILURE, "ERROR: txRing exist for sid%u queue#%u!\n", sid, i);
+      ringSize = TM_TX_RING_SIZE;
       ring = rte_ring_create(ring_name, ringSize, socket, RING_F_SP_ENQ | RING_F_SC_DEQ);
       if (ring == NULL)
 	rte_exit(EXIT_FAILURE, "ERROR: txRing create failed for sid%u queue#%u!\n", sid, i);
@@ -227,7 +231,7 @@ CreateFifoRings(unsigned sid)
 }
 
 static void
-SchedDequeueGbsInit(unsigned sid, uint8_t confId)
+SchedDequeueGbsInit(unsigned sid)
 {
   SchedConf  *sc = &schedConf[sid];
   SchedState *ss = &schedState[sid];
@@ -235,7 +239,7 @@ SchedDequeueGbsInit(unsigned sid, uint8_t confId)
 
   for (int q=0; q<sc->queuesNum; q++)
     {
-      qs = &ss->gbsQueue[confId][q];
+      qs = &ss->gbsQueue[q];
       //memset(qs, 0, sizeof(QueueState));  // Not required as done by SchedState init
       qs->qtype = QUEUE_TYPE_GBS;    
       qs->qid = (uint16_t) q & 0xffff;
@@ -257,11 +261,14 @@ SchedDequeueInit(unsigned lcoreId)
   ss->timeslotIdx   = 0;
   ss->timeslotIdxSeq = 0;
   ss->schedSeqTotal = 0;
+  ss->timeslotsTotal = 0;
+  ss->timeslotEndRtsc = sc->timeslotTsc;
+  ss->timeslotIdxClock = 0;
   ss->queuesNum     = sc->queuesNum;
   ss->txqId         = runConf.txqId;    // all ports use the same tx qeueue id to schedule output pkts!
   ss->txqNum        = runConf.txqNum;    // info only
 
-  SchedDequeueGbsInit(sid, 0);
+  SchedDequeueGbsInit(sid);
 
   runConf.initMask |= INIT_MASK_STRUCT;
 
@@ -275,11 +282,9 @@ SchedDequeueInit(unsigned lcoreId)
  * NOTE: tm3 had alternate qid assignment when testing with iperf3, see "PoCPhase1/tm3/README.TODO.TM3c" TEST9
  */
 static inline uint16_t
-SchedRxClassifyAndUpdatePkt(struct rte_mbuf *mbuf, uint64_t rxRtsc)
+SchedRxClassifyAndUpdatePkt(const TmConf *cf, struct rte_mbuf *mbuf, uint64_t rxRtsc)
 {
   uint16_t qid;
-#define QID_CATCHALL  NUM_GBSQUEUES_MAX  // First queue in EBS set
-#define QID_DROP      0
   
 #if 0
   static uint32_t rxSeqNum[TM_NUM_RX_RINGS];
@@ -287,11 +292,10 @@ SchedRxClassifyAndUpdatePkt(struct rte_mbuf *mbuf, uint64_t rxRtsc)
   
   char *pkt = rte_pktmbuf_mtod(mbuf, char *);
   bool vlan = is_vlan_pkt((char *)pkt);
-  mbuf->hash.usr = 0;
   
-  // Get the IP header, useful in any case
-  Ipv4Hdr *ipv4Hdr = get_ipv4hdr_ptr(pkt, vlan);
-  if (ipv4Hdr->version_ihl != 0x45 || (ipv4Hdr->next_proto_id!=IPPROTO_UDP && ipv4Hdr->next_proto_id!=IPPROTO_TCP))
+  // Get the IP header, useful in any case. IPv4 options and IPv6 extension headers are skipped.
+  PktL3Info pi;
+  if (!TmPktParseL3(mbuf, &pi) || (pi.proto!=IPPROTO_UDP && pi.proto!=IPPROTO_TCP))
     {
       // DEBUG
       // printf("Packet sent to DROP queue #1\n");
@@ -307,20 +311,10 @@ SchedRxClassifyAndUpdatePkt(struct rte_mbuf *mbuf, uint64_t rxRtsc)
   // Classify:
   // NOTE: The srcPort and dstPort are in same L4 offset location for UDP and TCP headers!! 
   typedef UdpHdr L4Hdr;
-  L4Hdr *l4Hdr = get_udphdr_ptr(pkt, vlan);
-  uint16_t dstPort = rte_cpu_to_be_16(l4Hdr->dst_port);
-  uint16_t srcPort = rte_cpu_to_be_16(l4Hdr->src_port);
-
-    
-
-if (srcPort >= 32768) {
-    return QID_CATCHALL;
-}
-
-if (srcPort >= 30000 && srcPort <= 31000) {
-    return 1;  // send all 30000..31000 to GBS queue 1
-}
-
+  // Ports are 0 for non-first fragments
+  L4Hdr *l4Hdr = (L4Hdr *) pi.l4Hdr;
+  uint16_t dstPort = l4Hdr ? rte_cpu_to_be_16(l4Hdr->dst_port) : 0;
+  uint16_t srcPort = l4Hdr ? rte_cpu_to_be_16(l4Hdr->src_port) : 0;
 
 #if 0
   if (srcPort==5201 || dstPort==5201)
@@ -329,12 +323,12 @@ if (srcPort >= 30000 && srcPort <= 31000) {
       //      printf("Packet sent to CATCHALL queue #2\n");
       // END DEBUG
       
-      return QID_CATCHALL;  // iperf3 port
+      return QID_CATCHALL(cf->queuesNum);  // iperf3 port
     }
 #endif
 
   // For packet classification, only one of the following definitions muyst be present
-  switch(schedClassifierType)
+  switch(cf->classifierType)
     {
     case VLANID_SRCMAC_CLASSIFIER:
       // VLAN ID first, then Source MAC Address
@@ -353,15 +347,10 @@ if (srcPort >= 30000 && srcPort <= 31000) {
 	  uint16_t vlanpcp = GET_VLANPRI_FROM_TCI(cputci);
 
 	  // DEBUG
-	  printf("VLAN TCI: %u  -  VLANID: %u  -  VLAN PCP: %u", cputci, vlanid, vlanpcp);
-	  printf("  -  MAC Address: ");
-	  mac_address_printf(macsrcaddr);
-	  if (vlanid == (uint16_t)101)
-	    {
-	      printf(" Classifier MAC Address: ");
-	      mac_address_printf(&(vlanid_table[vlanid].macaddr1));
-	    }
-	  printf("\n");
+	  DBGLOG("VLANID: %u  -  VLAN PCP: %u  -  MAC Address: %02x:%02x:%02x:%02x:%02x:%02x\n",
+		 vlanid, vlanpcp,
+		 macsrcaddr->addr_bytes[0], macsrcaddr->addr_bytes[1], macsrcaddr->addr_bytes[2],
+		 macsrcaddr->addr_bytes[3], macsrcaddr->addr_bytes[4], macsrcaddr->addr_bytes[5]);
 	  // END DEBUG
 
 	  // DEBUG
@@ -370,31 +359,31 @@ if (srcPort >= 30000 && srcPort <= 31000) {
 	  // Classify based on VLAN ID and SRC MAC only if PCP = 7 (top-priority packet)
 	  if (vlanpcp == 7)
 	    {
-	      if (mac_address_is_same(macsrcaddr, &(vlanid_table[vlanid].macaddr1)))
+	      if (mac_address_is_same(macsrcaddr, &(cf->vlanTable[vlanid].macaddr1)))
 		{
-		  qid = vlanid_table[vlanid].qid1;
+		  qid = cf->vlanTable[vlanid].qid1;
 		}
-	      else if (mac_address_is_same(macsrcaddr, &(vlanid_table[vlanid].macaddr2)))
+	      else if (mac_address_is_same(macsrcaddr, &(cf->vlanTable[vlanid].macaddr2)))
 		{
-		  qid = vlanid_table[vlanid].qid2;
+		  qid = cf->vlanTable[vlanid].qid2;
 		}
 	      else
 		{
 		  // AF250619: The value of QID_CATCHALL points to the lowest-priority EBS queue
 		  // It is chosen if the packet matches the VLAN ID but neither MAC address
-		  qid = QID_CATCHALL;
+		  qid = QID_CATCHALL(cf->queuesNum);
 		}
 	    }
 	  else
 	    {
 	      // Lower-priority packet: place in the corresponding class queue
-	      qid = NUM_GBSQUEUES_MAX + vlanpcp;
+	      qid = QID_EBS(cf->queuesNum, vlanpcp);
 	    }
 	}
       else
 	{
 	  // Not a VLAN packet: send it to the catch-all queue (lowest-priority class queue)
-	  qid = QID_CATCHALL;
+	  qid = QID_CATCHALL(cf->queuesNum);
 	}
 	  
 
@@ -428,54 +417,53 @@ if (srcPort >= 30000 && srcPort <= 31000) {
 	  uint16_t vlanpcp = GET_VLANPRI_FROM_TCI(cputci);
 
 	  // DEBUG
-	  printf("VLAN TCI: %u  -  VLANID: %u  -  VLAN PCP: %u", cputci, vlanid, vlanpcp);
-	  printf("\n");
+	  DBGLOG("VLAN TCI: %u  -  VLANID: %u  -  VLAN PCP: %u\n", cputci, vlanid, vlanpcp);
 	  // END DEBUG
 
 	  // Classify based on VLAN ID and SRC MAC only if PCP = 7 (top-priority packet)
 	  if (vlanpcp == 7)
 	    {
-	      qid = rte_cpu_to_be_16(GET_VLANID_FROM_TCI(vlanHdr->tci)) % NUM_GBSQUEUES_MAX;
+	      qid = rte_cpu_to_be_16(GET_VLANID_FROM_TCI(vlanHdr->tci)) % cf->queuesNum;
 	      if (qid == 0)
 		{
 		  // QID 0 is never server: move the packet to the top-priority EBS queue
-		  qid = NUM_GBSQUEUES_MAX + vlanpcp;
+		  qid = QID_EBS(cf->queuesNum, vlanpcp);
 		}
 	    }
 	  else
 	    {
 	      // Send the packet to an EBS queue if not top-priority
-	      qid = NUM_GBSQUEUES_MAX + vlanpcp;
+	      qid = QID_EBS(cf->queuesNum, vlanpcp);
 	    }
 	  // DEBUG
-	  printf("Packet (VLAN) sent to Queue %u #3\n", qid);
+	  DBGLOG("Packet (VLAN) sent to Queue %u #3\n", qid);
 	  // END DEBUG
 	}
       else
 	{
-	  // Not a VLAN packet: classify based on TTL
-	  qid = ipv4Hdr->time_to_live % NUM_GBSQUEUES_MAX;
+	  // Not a VLAN packet: classify based on TTL (IPv6 hop limit)
+	  qid = pi.ttl % cf->queuesNum;
 	  
 	  if (qid == 0)
 	    {
 	      // QID 0 is never served: move the packet to the top-priority EBS queue
-	      qid = NUM_GBSQUEUES_MAX + TM_NUM_CLASSES - 1;
+	      qid = QID_EBS(cf->queuesNum, TM_NUM_CLASSES - 1);
 	    }
 	  
 	  // DEBUG
-	  printf("Packet (not VLAN) sent to Queue %u #4\n", qid);
+	  DBGLOG("Packet (not VLAN) sent to Queue %u #4\n", qid);
 	  // END DEBUG
 	}
       break;
 
     case SRCPORT_CLASSIFIER:
       // VLAN ID is ignored, look directly at Source Port (TCP or UDP)
-      qid = srcPort % NUM_GBSQUEUES_MAX;
+      qid = srcPort % cf->queuesNum;
 
       if (qid == 0)
 	{
 	  // QID 0 is never served: move the packet to the top-priority EBS queue
-	  qid = NUM_GBSQUEUES_MAX + TM_NUM_CLASSES - 1;
+	  qid = QID_EBS(cf->queuesNum, TM_NUM_CLASSES - 1);
 	}
 
       // CRP force PCP for test
@@ -493,8 +481,8 @@ if (srcPort >= 30000 && srcPort <= 31000) {
 
     default:
       // Unknown classification criterion: send to catch-all queue
-      printf("ERROR: Unknown Classification Method (%d)! - Packet sent to CATCHALL queue\n", schedClassifierType);
-      qid = QID_CATCHALL;
+      ERRLOG("Unknown Classification Method (%d)! - Packet sent to CATCHALL queue\n", cf->classifierType);
+      qid = QID_CATCHALL(cf->queuesNum);
       
       // DEBUG
       // printf("Packet sent to Queue %u #6\n", qid);
@@ -505,17 +493,16 @@ if (srcPort >= 30000 && srcPort <= 31000) {
   
 #if 0
   // Ingress Packet Metadata Update
-  // Save classification info in mbuf for use by dequeue thread!
-  // NOTE: We can use private data instead by reserving its space with rte_pktmbuf_pool_create()
+  // Save classification info in mbuf metadata for use by dequeue thread!
   OrionMbufUsr omu;
-  omu.u.addTMINT = ((ipv4Hdr->type_of_service >> 2)==DSCP_ORION_TM) ? 1 : 0;
+  omu.u.addTMINT = (TOS_TO_DSCP(pi.tos)==DSCP_ORION_TM) ? 1 : 0;
   omu.u.vlan = vlan;
   omu.u.rsvd = 0;
-  mbuf->hash.usr = omu.usr;
+  ORION_MBUF_META(mbuf)->omu = omu;
 #endif
   // Comment out if not connected to XConnect switch that adds shim headers
 #if 0
-  bool addSeqno = ((ipv4Hdr->type_of_service >> 2)==DSCP_ORION_MDINT) ? 1 : 0;
+  bool addSeqno = (TOS_TO_DSCP(pi.tos)==DSCP_ORION_MDINT) ? 1 : 0;
   if (addSeqno)
     {
       // locate inserted P4 headers
@@ -546,6 +533,8 @@ if (srcPort >= 30000 && srcPort <= 31000) {
 
       if (dstPort!=UDPPORT_ORION_TMINT)
 	{
+	  // TLV insertion is IPv4 only
+	  Ipv4Hdr *ipv4Hdr = (Ipv4Hdr *) pi.l3Hdr;
 	  // Save original protocol type before SchedAddGbsTLVEncap() that moves headers which invalidates ipv4Hdr
 	  uint8_t origProtocol = ipv4Hdr->next_proto_id;
 	  ipv4Hdr->next_proto_id = IPPROTO_UDP;  // TLV is over UDP header that we are inserting
@@ -606,63 +595,258 @@ if (srcPort >= 30000 && srcPort <= 31000) {
   return qid;
 }
 
-// qid is scheduler's queue specified by SchedRxClassifyPkt() and "--pfc" config file
+// Packets of one rx burst staged by destination queue, so that each queue is served with a single ring operation
+typedef struct EnqueueBurst_s
+{
+  uint16_t numGroups;                                               // number of distinct queues hit by the burst
+  uint16_t numDrops;
+  uint64_t rxBytes;
+  struct rte_ring *groupRing[TM_RX_PKT_BURST_MAX];                  // destination rxRing or FQ sub-ring of each group
+  uint16_t groupQid[TM_RX_PKT_BURST_MAX];
+  uint16_t groupLen[TM_RX_PKT_BURST_MAX];
+  uint32_t groupBytes[TM_RX_PKT_BURST_MAX];
+  uint32_t groupQlen[TM_RX_PKT_BURST_MAX];                          // queue occupancy found by the burst, in pkts
+  uint64_t groupQbytes[TM_RX_PKT_BURST_MAX];                        // and in bytes, see TmBufferOcc()
+  struct rte_mbuf *group[TM_RX_PKT_BURST_MAX][TM_RX_PKT_BURST_MAX];
+  struct rte_mbuf *drops[TM_RX_PKT_BURST_MAX];                      // freed in bulk once the burst is flushed
+  const TmConf *cf;                                                 // queue policers and limits in effect
+  PolicerState *policer;                                            // queue meters, indexed by qid
+  uint64_t tsc;                                                     // burst rx time for the meters
+  uint32_t bufFree;                                                 // free shared mbufs, see TmBufferFree()
+  EnqueueThreadStats *es;
+} EnqueueBurst;
+
+// qid is scheduler's queue specified by SchedRxClassifyPkt() and "--pfc" config file.
+// The packet is only staged here: SchedRxEnqueueFlush() performs the ring enqueues for the whole burst.
 static inline void
-SchedRxEnqueuePkt(SchedState *ss, uint16_t qid, struct rte_mbuf *mbuf)
+SchedRxEnqueuePkt(SchedState *ss, uint16_t qid, struct rte_mbuf *mbuf, EnqueueBurst *eb)
 {
-  QueueState *qs;
-
-  if (qid < NUM_GBSQUEUES_MAX)
+  if (qid < ss->queuesNum)
     {
       if (likely(qid == 0))
 	{
 	  // Drop the packet if destined for Queue 0
-	  printf("Dropped packet to QID 0\n");
-	  rte_pktmbuf_free(mbuf);
-	  ss->STATS_ENQUEUE.rxRingDrops++;
+	  DBGLOG("Dropped packet to QID 0\n");
+	  eb->drops[eb->numDrops++] = mbuf;
+	  return;
+	}
+      // Ingress policer: accept, remark to an EBS class or drop before the pkt takes ring space
+      qid = TmPolicerCheck(eb->cf, &eb->policer[qid], qid, eb->tsc, mbuf->pkt_len, eb->es);
+      if (unlikely(qid == QID_DROP))
+	{
+	  eb->drops[eb->numDrops++] = mbuf;
 	  return;
 	}
-      qs = &ss->gbsQueue[0][qid];
-
-      // DEBUG
-      // printf("Enqueuing to GBS queue %u\n", qid);
-      // END DEBUG
-	
     }
-  else
+  // L4S pkts of the [EBS_DUALQ] classic class go to its L4S class, also when remarked by the policer
+  if (qid >= ss->queuesNum)
+    qid = TmAqmDualQSteer(eb->cf, qid, mbuf);
+
+  // Consecutive packets of a burst usually go to the same ring: check the most recent group first.
+  // Groups of sibling FQ sub-rings only see each other's pkts staged before them, so the limits of an
+  // FQ queue may be passed by part of one burst.
+  struct rte_ring *ring = TmFqRing(ss, qid, mbuf);
+  int g = eb->numGroups - 1;
+  if (g < 0 || eb->groupRing[g] != ring)
     {
-      qs = &ss->ebsQueue[qid - NUM_GBSQUEUES_MAX];
+      for (g = 0; g < eb->numGroups && eb->groupRing[g] != ring; g++);
+      if (g == eb->numGroups)
+	{
+	  eb->groupRing[g] = ring;
+	  eb->groupQid[g] = qid;
+	  eb->groupLen[g] = 0;
+	  eb->groupBytes[g] = 0;
+	  TmBufferOcc(ss, qid, &eb->groupQlen[g], &eb->groupQbytes[g]);
+	  for (int o = 0; o < g; o++)
+	    if (eb->groupQid[o] == qid)
+	      {
+		eb->groupQlen[g] += eb->groupLen[o];
+		eb->groupQbytes[g] += eb->groupBytes[o];
+	      }
+	  eb->numGroups++;
+	}
+    }
 
-      // DEBUG
-      // printf("Enqueuing to EBS queue %u\n", qid - NUM_GBSQUEUES_MAX);
-      // END DEBUG
+  // Tail drop once the pkts already queued plus those staged by this burst reach the queue limits
+  const QueueLimit *ql = &eb->cf->queueLimit[qid];
+  if (unlikely(eb->groupQlen[g] + eb->groupLen[g] >= ql->maxPkts ||
+	       eb->groupQbytes[g] + eb->groupBytes[g] + mbuf->pkt_len > ql->maxBytes))
+    {
+      eb->es->queueDrops[qid]++;
+      eb->drops[eb->numDrops++] = mbuf;
+      return;
+    }
+
+  // Dynamic threshold: above its reserve a queue holds at most alpha times the free shared mbufs
+  uint32_t qlen = eb->groupQlen[g] + eb->groupLen[g];
+  if (qlen >= ql->reservePkts &&
+      unlikely(qlen - ql->reservePkts >= (((uint64_t) eb->bufFree * ql->dtAlpha) >> BUF_DT_ALPHA_SHIFT)))
+    {
+      eb->es->queueDrops[qid]++;
+      eb->es->bufDtDrops++;
+      eb->drops[eb->numDrops++] = mbuf;
+      return;
     }
+  if (eb->bufFree != 0)
+    eb->bufFree--;
 
-        
+  eb->rxBytes += mbuf->pkt_len;
+  eb->groupBytes[g] += mbuf->pkt_len;
+  eb->group[g][eb->groupLen[g]++] = mbuf;
+}
 
-  ss->STATS_ENQUEUE.rxBytes += mbuf->pkt_len;
-  ss->STATS_ENQUEUE.rxFrameBytes += (mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD);
+// Push every staged group to its rxRing with one burst enqueue, then release rejected mbufs and update stats once
+static inline void
+SchedRxEnqueueFlush(SchedState *ss, EnqueueThreadStats *es, EnqueueBurst *eb, uint16_t nb_rx)
+{
+  ActiveBatch active = { 0 };
 
-  
-  // Reference code from DPDK_TM/qosms_demo10/
-  if (unlikely(rte_ring_sp_enqueue(qs->rxRing, (void *)mbuf) != 0))
+  for (int g = 0; g < eb->numGroups; g++)
+    {
+      uint16_t len = eb->groupLen[g];
+
+      if (len == 0)
+	continue;  // every pkt tail dropped
+
+      // ECN marking is decided on the bytes each packet will find queued, before the dequeue thread can see it
+      uint32_t ecnBytes = eb->cf->queueLimit[eb->groupQid[g]].ecnBytes;
+      if (ecnBytes != 0)
+	{
+	  uint64_t qbytes = eb->groupQbytes[g];
+	  for (uint16_t i = 0; i < len; i++)
+	    {
+	      maybe_mark_ecn(eb->group[g][i], qbytes, ecnBytes);
+	      qbytes += eb->group[g][i]->pkt_len;
+	    }
+	}
+
+      // Occupancy is accounted before the pkts become visible to the dequeue lcore
+      TmBufferOccEnq(ss, eb->groupQid[g], len, eb->groupBytes[g]);
+
+      // Reference code from DPDK_TM/qosms_demo10/. SP or MP enqueue according to the ring flags.
+      unsigned n = rte_ring_enqueue_burst(eb->groupRing[g], (void * const *)eb->group[g], len, NULL);
+      if (likely(n != 0))
+	TmBufferActiveAdd(&active, eb->groupQid[g]);
+      if (unlikely(n < len))
+	{
+	  int64_t rejected = 0;
+	  int32_t rejectedPkts = (int32_t) (len - n);
+	  for (; n < len; n++)
+	    {
+	      rejected += eb->group[g][n]->pkt_len;
+	      eb->drops[eb->numDrops++] = eb->group[g][n];
+	    }
+	  eb->rxBytes -= rejected;
+	  TmBufferOccEnq(ss, eb->groupQid[g], -rejectedPkts, -rejected);
+	}
+    }
+
+  // Queues that got pkts become visible to the scheduler with one atomic per bitmap word
+  TmBufferActiveSet(ss, &active);
+
+  uint16_t enqueued = nb_rx - eb->numDrops;
+  if (unlikely(eb->numDrops > 0))
     {
-      rte_pktmbuf_free(mbuf);
-      ss->STATS_ENQUEUE.rxRingDrops++;
-      return;  // caller does not check for return condition!
+      rte_pktmbuf_free_bulk(eb->drops, eb->numDrops);
+      es->rxRingDrops += eb->numDrops;
     }
-  maybe_mark_ecn(mbuf, qs->rxRing);
+  es->rxBytes += eb->rxBytes;
+  es->rxFrameBytes += eb->rxBytes + (uint64_t)enqueued * ETHER_PHY_FRAME_OVERHEAD;
 
   // DEBUG
-  //printf("DBG: SchedRxEnqueuePkt(qid %u) enqueued mbuf %p, entries = %u\n", qid, mbuf, rte_ring_count(qs->rxRing));
-  //printf("DBG: SchedRxEnqueuePkt: qid %u  pktsize: %u  qlen %u\n", qid, mbuf->pkt_len, rte_ring_count(qs->rxRing));
+  //printf("DBG: SchedRxEnqueueFlush() %u groups, %u pkts enqueued, %u dropped\n", eb->numGroups, enqueued, eb->numDrops);
   // END DEBUG
 }
 
 
+// Index of lcoreId in sc->rxCores[], -1 if not an enqueue lcore
+static int
+LcoreIdToEnqIdx(SchedConf *sc, unsigned lcoreId)
+{
+  for (int e=0; e<sc->numRxCores; e++)
+    if (sc->rxCores[e] == lcoreId)
+      return e;
+  return -1;
+}
+
+// Rx queue polling state of one enqueue lcore
+typedef struct RxPoll_s
+{
+  uint16_t rxqNum;                     // rx queues owned by this lcore
+  uint16_t rxqList[NUM_RXQUEUES_MAX];  // in increasing q# order
+  uint16_t cur;                        // RXQ_POLL_WRR: rxqList[] index being served
+  uint16_t budget;                     // RXQ_POLL_WRR: full bursts left for rxqList[cur] in this round
+  uint16_t skipped[NUM_RXQUEUES_MAX];  // RXQ_POLL_SP: consecutive polls that did not reach rxqList[r]
+} RxPoll;
+
+static inline uint16_t
+SchedRxPollQueue(uint16_t rxPort, uint16_t q, struct rte_mbuf **rxMbufs, uint16_t rxBurstSize, EnqueueThreadStats *es)
+{
+  uint16_t nb_rx = rte_eth_rx_burst(rxPort, q, rxMbufs, rxBurstSize);
+  if (nb_rx == 0)
+    es->rxqEmptyPolls[q]++;
+  else if (nb_rx == rxBurstSize)
+    es->rxqFullBursts[q]++;
+  return nb_rx;
+}
+
+// Select and poll the rx queues of this lcore per runConf.rxqPollMode. Returns the number of pkts and their queue in *rxq.
+static inline uint16_t
+SchedRxPoll(RxPoll *rp, uint16_t rxPort, struct rte_mbuf **rxMbufs, uint16_t rxBurstSize, EnqueueThreadStats *es, uint16_t *rxq)
+{
+  uint16_t nb_rx = 0;
+
+  if (runConf.rxqPollMode == RXQ_POLL_WRR)
+    {
+      // A queue keeps being served while it returns full bursts, up to its weight; any other result moves on
+      for (uint16_t n = 0; n < rp->rxqNum && nb_rx == 0; n++)
+	{
+	  uint16_t q = rp->rxqList[rp->cur];
+	  nb_rx = SchedRxPollQueue(rxPort, q, rxMbufs, rxBurstSize, es);
+	  *rxq = q;
+	  if (nb_rx < rxBurstSize || --rp->budget == 0)
+	    {
+	      rp->cur = (rp->cur + 1 == rp->rxqNum) ? 0 : rp->cur + 1;
+	      rp->budget = runConf.rxqWeight[rp->rxqList[rp->cur]];
+	    }
+	}
+      return nb_rx;
+    }
+
+  // RXQ_POLL_SP: serve first the lowest queue that has been skipped for too long
+  int r;
+  for (r = 0; r < rp->rxqNum - 1; r++)
+    {
+      if (rp->skipped[r] >= runConf.rxqStarveLimit)
+	{
+	  rp->skipped[r] = 0;
+	  *rxq = rp->rxqList[r];
+	  nb_rx = SchedRxPollQueue(rxPort, *rxq, rxMbufs, rxBurstSize, es);
+	  if (nb_rx > 0)
+	    return nb_rx;
+	  break;
+	}
+    }
+
+  // Higher q# has higher priority
+  for (r = rp->rxqNum - 1; r >= 0; r--)
+    {
+      rp->skipped[r] = 0;
+      *rxq = rp->rxqList[r];
+      nb_rx = SchedRxPollQueue(rxPort, *rxq, rxMbufs, rxBurstSize, es);
+      if (nb_rx > 0)
+	break;
+    }
+  for (r--; r >= 0; r--)
+    rp->skipped[r]++;
+
+  return nb_rx;
+}
+
 /* 
  * Enqueue thread:
  * Enqueue Rx pkts to one of the rxRing (i.e. queues) for GBS/EBS scheduler or SRR scheduler.
+ * Each enqueue lcore polls the rx queues q with (q % numRxCores) == its index in sc->rxCores[].
  * If L2FWD: then bypass the other threads and forward packet directly to DPDK tx driver
  */
 static void
@@ -673,13 +857,23 @@ SchedEnqueueThread(unsigned lcoreId)
   SchedState *ss = &schedState[sid];
 
   uint16_t rxPort = sc->rxPort;
-  uint16_t rxBurstSize = sc->rxBurstSize;
+  uint16_t rxBurstSize = RTE_MIN(sc->rxBurstSize, TM_RX_PKT_BURST_MAX);  // EnqueueBurst groups are sized for TM_RX_PKT_BURST_MAX
   struct rte_mbuf *rxMbufs[rxBurstSize] __rte_cache_aligned;
-  uint16_t rxqNum = runConf.rxqNum; 
+  int enqIdx = LcoreIdToEnqIdx(sc, lcoreId);
+  EnqueueThreadStats *es = &ss->STATS_ENQUEUE[enqIdx];
+
+  // rx queues owned by this enqueue lcore, in increasing order
+  RxPoll rp;
+  memset(&rp, 0, sizeof(rp));
+  for (uint16_t q = enqIdx; q < runConf.rxqNum; q += sc->numRxCores)
+    rp.rxqList[rp.rxqNum++] = q;
+  rp.budget = runConf.rxqWeight[rp.rxqList[0]];
 
   SchedEnqueueThreadInit();
 
   uint64_t epoch = ss->tscEpoch;
+  rte_rcu_qsbr_thread_register(sc->confRcu, enqIdx);
+  rte_rcu_qsbr_thread_online(sc->confRcu, enqIdx);
   runConf.initMask |= INIT_MASK_ENQRUNNING;
 
   RTE_LOG(INFO, SCHED, "Enqueue thread completed init (0x%02x) on lcore %u\n", runConf.initMask, lcoreId);
@@ -696,20 +890,8 @@ SchedEnqueueThread(unsigned lcoreId)
   while (!forceQuit)
     {
       uint64_t rtscCurr = RTE_RDTSC(epoch);
-      int nb_rx = 0;
-      uint16_t q;
-
-      // NOTE: For now, assume higher q# has higher priority
-      q = rxqNum - 1;
-      while (1)
-	{
-	  nb_rx = rte_eth_rx_burst(rxPort, q, rxMbufs, rxBurstSize);
-	  if (nb_rx > 0 || q == 0)
-	    {
-	      break;
-	    }
-	  q--;
-	}
+      uint16_t q = 0;
+      int nb_rx = SchedRxPoll(&rp, rxPort, rxMbufs, rxBurstSize, es, &q);
 
       // DEBUG
       //printf("Packets extracted from RX queue: %d\n", nb_rx);
@@ -721,34 +903,108 @@ SchedEnqueueThread(unsigned lcoreId)
 	  /* 6/21/21: Testing show no performance improvement at 18Gbps with prefetch below
 	   * rte_prefetch0(rte_pktmbuf_mtod(rxMbufs[0], void *));    // prefetch the first mbuf to optimize most frequent case!
 	   */
-	  ss->STATS_ENQUEUE.rxqPkts[q] += nb_rx;
-	  ss->STATS_ENQUEUE.rxPkts += nb_rx;
+	  es->rxqPkts[q] += nb_rx;
+	  es->rxPkts += nb_rx;
 
+	  // Ingress time: NIC rx timestamp when delivered, else this burst tsc. A converted NIC timestamp
+	  // is capped by rxRtsc so that clock conversion error never yields a negative sojourn time.
+	  if (rxClock.enabled)
+	    {
+	      const RxClockRef *ref = &rxClock.ref[rxClock.refId];
+	      for(int i = 0; i < nb_rx; i++)
+		{
+		  OrionMbufMeta *meta = ORION_MBUF_META(rxMbufs[i]);
+		  meta->rxRtsc = rxRtsc;
+		  if (rxMbufs[i]->ol_flags & rxClock.tsFlag)
+		    {
+		      uint64_t nicTs = *RTE_MBUF_DYNFIELD(rxMbufs[i], rxClock.tsOffset, rte_mbuf_timestamp_t *);
+		      uint64_t tsc = RxClockNicToTsc(ref, nicTs);
+		      if (tsc > epoch && tsc - epoch < rxRtsc)
+			meta->rxRtsc = tsc - epoch;
+		    }
+		}
+	    }
+	  else
+	    for(int i = 0; i < nb_rx; i++)
+	      ORION_MBUF_META(rxMbufs[i])->rxRtsc = rxRtsc;
+
+	  // Stage 1: classify the whole burst into per-queue groups
+	  // NIC flow MARK first (no header access), then [FLOW_TABLE] exact matches (bulk hash lookup),
+	  // then [CLASSIFIER_RULES] (one rte_acl call). Packets matched by none use the legacy classifier.
+	  uint16_t qids[TM_RX_PKT_BURST_MAX];
+	  const TmConf *cf = TmConfGet(sc);  // held until the quiescent state below
+	  if (runConf.flowMarkOffload)
+	    for(int i = 0; i < nb_rx; i++)
+	      {
+		// The MARK id comes from the NIC: anything that is not a scheduler queue goes to the catch-all
+		// queue, including the ids between the last GBS queue and the EBS classes, which have no ring
+		uint32_t mark = rxMbufs[i]->hash.fdir.hi;
+		if (!(rxMbufs[i]->ol_flags & RTE_MBUF_F_RX_FDIR_ID))
+		  qids[i] = QID_NONE;
+		else if (likely(mark < cf->queuesNum ||
+				(mark >= QID_EBS_BASE(cf->queuesNum) && mark < NUM_QIDS(cf->queuesNum))))
+		  qids[i] = (uint16_t) mark;
+		else
+		  {
+		    qids[i] = QID_CATCHALL(cf->queuesNum);
+		    es->rxMarkInvalid++;
+		  }
+	      }
+	  else
+	    for(int i = 0; i < nb_rx; i++)
+	      qids[i] = QID_NONE;
+	  if (cf->flowKeyTypes != 0)
+	    TmFlowTableBurst(cf->flowTable, cf->flowKeyTypes, rxMbufs, qids, nb_rx);
+	  if (cf->aclFamilies != 0)
+	    TmClassifierBurst(cf->aclCtx, cf->aclCtx6, cf->aclFamilies, rxMbufs, qids, nb_rx);
+
+	  EnqueueBurst eb;
+	  eb.numGroups = 0;
+	  eb.numDrops = 0;
+	  eb.rxBytes = 0;
+	  eb.cf = cf;
+	  eb.policer = ss->policer;
+	  eb.tsc = rxRtsc + epoch;
+	  eb.bufFree = TmBufferFree(cf, ss);
+	  eb.es = es;
 	  for(int i = 0; i < nb_rx; i++)
 	    {
-	      // WARNING: Pkt headers may be modified on return when insert new headers for TMGbsTLV.
-	      // Do not use any old pkt pointers!
-	      uint16_t qid = SchedRxClassifyAndUpdatePkt(rxMbufs[i], rxRtsc);  // scheduler queue for SHPS forwarding
-
-	      // DEBUG
-	      //printf("About to call SchedRxEnqueuePkt\n");
-	      // END DEBUG
-	      
-	      SchedRxEnqueuePkt(ss, qid, rxMbufs[i]);  // mbuf may be freed upon return when ring is full!
+	      uint16_t qid = qids[i];
+	      OrionMbufMeta *meta = ORION_MBUF_META(rxMbufs[i]);
+	      meta->omu.usr = 0;
+	      if (qid == QID_NONE)
+		{
+		  // WARNING: Pkt headers may be modified on return when insert new headers for TMGbsTLV.
+		  // Do not use any old pkt pointers!
+		  qid = SchedRxClassifyAndUpdatePkt(cf, rxMbufs[i], meta->rxRtsc);  // scheduler queue for SHPS forwarding
+		  if (cf->flowAssign.numBundles != 0)
+		    qid = TmFlowAssign(cf, ss, &ss->flowAssign[enqIdx], rxMbufs[i], qid, eb.tsc, es);
+		}
+	      meta->qid = qid;
+	      SchedRxEnqueuePkt(ss, qid, rxMbufs[i], &eb);
 	    }
+
+	  // Stage 2: one ring enqueue per group, one bulk free for all rejected mbufs
+	  SchedRxEnqueueFlush(ss, es, &eb, nb_rx);  // mbufs may be freed upon return when rings are full!
+
+	  if (cf->flowAssign.numBundles != 0)
+	    TmFlowAssignAge(cf, ss, &ss->flowAssign[enqIdx], eb.tsc, es);
 	}
 
       uint64_t tscDelta = RTE_RDTSC(epoch) - rtscCurr;
       if (likely(nb_rx != 0))
 	{
-	  ss->STATS_ENQUEUE.tscEnqLcoreBusy += tscDelta;
+	  es->tscEnqLcoreBusy += tscDelta;
 	}
       else
 	{
-	  ss->STATS_ENQUEUE.tscEnqLcoreIdle += tscDelta;
+	  es->tscEnqLcoreIdle += tscDelta;
 	}
+      rte_rcu_qsbr_quiescent(sc->confRcu, enqIdx);  // no reference to cf past this point
 
     }
+  rte_rcu_qsbr_thread_offline(sc->confRcu, enqIdx);
+  rte_rcu_qsbr_thread_unregister(sc->confRcu, enqIdx);
   printf("SchedEnqueueThread() exiting!\n");
 }
 
@@ -816,9 +1072,7 @@ SchedDequeueThreadSimpleRR(unsigned lcoreId)
 
   printf("====== Dequeue Thread running Simple Round Robin Scheduler ======\n");
 
-  struct rte_ring *rxRingCached[TM_NUM_RX_RINGS];
-  for (int i=0; i<TM_NUM_RX_RINGS; i++)
-    rxRingCached[i] = ss->gbsQueue[i].rxRing;
+  struct rte_ring **rxRingCached = ss->rxRing;
 
   bool hasRunLimit = (runConf.maxRunPkts!=0 || runConf.maxRunTimeslots!=0);  // Run time is constrained by # of packets or # of timeslots
   if (hasRunLimit)
@@ -895,6 +1149,60 @@ SchedDequeueThreadSimpleRR(unsigned lcoreId)
 }
 #endif
 
+/*
+ * Advance the time base of the dequeue lcore to rtscCurr by comparing against the next timeslot boundary,
+ * instead of dividing rtscCurr by the timeslot and sequence lengths on every iteration. Divides only when
+ * the lcore fell a whole scheduling sequence behind.
+ */
+static inline void
+SchedTimeslotTrack(SchedState *ss, uint64_t rtscCurr, uint32_t timeslotTsc, uint16_t timeslotsPerSeq)
+{
+  if (likely(rtscCurr < ss->timeslotEndRtsc))
+    return;
+  if (unlikely(rtscCurr - ss->timeslotEndRtsc >= (uint64_t) timeslotTsc * timeslotsPerSeq))
+    {
+      ss->timeslotsTotal = rtscCurr / timeslotTsc;
+      ss->schedSeqTotal = ss->timeslotsTotal / timeslotsPerSeq;
+      ss->timeslotIdxClock = ss->timeslotsTotal % timeslotsPerSeq;
+      ss->timeslotEndRtsc = (ss->timeslotsTotal + 1) * timeslotTsc;
+      return;
+    }
+  do
+    {
+      ss->timeslotsTotal++;
+      ss->timeslotEndRtsc += timeslotTsc;
+      if (++ss->timeslotIdxClock == timeslotsPerSeq)
+        {
+          ss->timeslotIdxClock = 0;
+          ss->schedSeqTotal++;
+        }
+    }
+  while (rtscCurr >= ss->timeslotEndRtsc);
+}
+
+// Dequeue lcore: free the pkts held back in the stash of the GBS queues that cf no longer serves, so that
+// their mbufs go back to the shared pool instead of waiting for a config that serves the queue again
+static void
+SchedDequeueDrainUnserved(SchedState *ss, const TmConf *cf)
+{
+  static bool served[NUM_GBSQUEUES_MAX];  // only the cf->queuesNum first are used
+  uint32_t freed = 0;
+
+  memset(served, 0, cf->queuesNum * sizeof(served[0]));
+  for (uint16_t b = 0; b < cf->queuesNum; b++)
+    {
+      const BundleConf *bc = &cf->bundleConf[b];
+      if (bc->numTimeslots > 0)
+	for (uint16_t i = 0; i < bc->numQueues; i++)
+	  served[bc->queues[i]] = true;
+    }
+  for (uint16_t qid = 1; qid < cf->queuesNum; qid++)
+    if (!served[qid])
+      freed += TmFqDrain(ss, qid);
+  if (freed != 0)
+    printf("Conf #%u: %u held back pkts of unserved GBS queues freed\n", cf->version, freed);
+}
+
 static void
 SchedDequeueThreadDCB_Q(unsigned lcoreId)
 {
@@ -910,28 +1218,29 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
   bool hasRunLimit = (runConf.maxRunPkts!=0 || runConf.maxRunTimeslots!=0);  // Run time is constrained by # of packets or # of timeslots
   if (hasRunLimit)
     INFOLOG("Run duration Limited with maxPkts=%u or maxTimeslots=%u (0 for unlimited)\n", runConf.maxRunPkts, runConf.maxRunTimeslots);
+
+  // The config in use; a newer one is picked up at the end of an iteration, after the quiescent report
+  rte_rcu_qsbr_thread_register(sc->confRcu, CONF_RCU_DEQ_ID);
+  rte_rcu_qsbr_thread_online(sc->confRcu, CONF_RCU_DEQ_ID);
+  const TmConf *cf = TmConfGet(sc);
   
   // DCB_Q dequeue loop
   while (!forceQuit)
     {
     
-#ifdef INCLUDE_MEMORY_BARRIERS
-      rte_mb();
-#endif
 
 
       uint8_t  deqStates=0;                                            // DEQ_STATE_MASK_xxx
       uint64_t rtscCurr = RTE_RDTSC(epoch);                            // NS3:schedtime
 
       uint64_t rtscRxDeq=0;
+      uint64_t tscSojourn=0;                                           // ingress to dequeue delay of the selected pkt
       uint8_t  pktType = PKTTYPE_UNKNOWN;
       
       struct rte_mbuf *mbuf;
 
-      ss->timeslotsTotal = rtscCurr / timeslotTsc;                     // total number of timeslots processed (for metrics?)
-      ss->schedSeqTotal  = ss->timeslotsTotal / timeslotsPerSeq;       // total number of sequences processed (for metrics?)
-
-      ss->timeslotIdx = ss->timeslotsTotal % timeslotsPerSeq;          // Index of timeslot corresponding to current time
+      SchedTimeslotTrack(ss, rtscCurr, timeslotTsc, timeslotsPerSeq);  // timeslotsTotal, schedSeqTotal (for metrics?)
+      ss->timeslotIdx = ss->timeslotIdxClock;                          // Index of timeslot corresponding to current time
 
       if (ss->timeslotIdx != ss->timeslotIdxPrev)
 	{
@@ -972,16 +1281,18 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 	    }
 	}
 
-      uint16_t gbsBundleId = sc->pss[sc->confId][ss->timeslotIdx]; // id of scheduled bundle; NS3:schedqueueid (in DCB_Q)
+      // Within a run of empty PSS slots the loop goes straight to EBS, see the empty slot case below
+      bool pssIdle = (rtscCurr < ss->pssIdleEndRtsc);
+      uint16_t gbsBundleId = pssIdle ? 0 : cf->pss[ss->timeslotIdx]; // id of scheduled bundle; NS3:schedqueueid (in DCB_Q)
 
       // Bundle configuration and state
-      BundleConf *bc = &(sc->bundleConf[sc->confId][gbsBundleId]);
-      BundleState *bs = &(ss->gbsBundle[sc->confId][gbsBundleId]);
+      const BundleConf *bc = &(cf->bundleConf[gbsBundleId]);
+      BundleState *bs = &(ss->gbsBundle[gbsBundleId]);
       
       // Path configuration and state
       uint16_t gbsPathId = bc->pathId;
-      PathConf *pc = &(sc->pathConf[sc->confId][gbsPathId]);
-      PathState *ps = &(ss->gbsPath[sc->confId][gbsPathId]);
+      const PathConf *pc = &(cf->pathConf[gbsPathId]);
+      PathState *ps = &(ss->gbsPath[gbsPathId]);
       
       // AF DEBUG
       /*
@@ -1032,6 +1343,70 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 	      */
 	      // END DEBUG
 	      
+	      // Look ahead at the next slot only if it holds another bundle: an empty slot or another slot of
+	      // the same bundle cannot be served in place of the bundle that just relinquished
+	      if (cf->pssNextBusy[ss->timeslotIdx] != 1 || cf->pssNextSame[ss->timeslotIdx] == 1)
+		{
+		  gbsBundleId = 0;
+		}
+	      else
+		{
+		  // Advance the selection to the next slot
+		  ss->timeslotIdxPrev = ss->timeslotIdx;
+		  ss->timeslotIdx++;
+		  deqStates |= DEQ_STATE_MASK_NEW_TIMESLOT;
+		  ss->STATS_DEQUEUE.timeslots++;
+		  if (ss->timeslotIdx >= timeslotsPerSeq)
+		    {
+		      ss->timeslotIdx = ss->timeslotIdx - timeslotsPerSeq;
+		      deqStates |= DEQ_STATE_MASK_NEW_SCHEDSEQ;
+		      ss->STATS_DEQUEUE.schedSequences++;
+		      ss->schedSeqTotalPrev = ss->schedSeqTotal;
+		    }
+
+		  // Update the GBS credits for the bundle of the newly identified slot.
+		  gbsBundleId = cf->pss[ss->timeslotIdx];                 // id of next scheduled bundle
+		  bc = &(cf->bundleConf[gbsBundleId]);
+		  bs = &(ss->gbsBundle[gbsBundleId]);
+
+		  gbsPathId = bc->pathId;
+		  pc = &(cf->pathConf[gbsPathId]);
+		  ps = &(ss->gbsPath[gbsPathId]);
+
+		  // If a new bundle is found...
+		  if (gbsBundleId > 0)
+		    {
+		      // ... update its bundle credit
+		      increaseBundleCredit(sc, bs, bc->numTimeslots, rtscCurr);
+
+		      // If the bundle has a path...
+		      if (gbsPathId > 0)
+			{
+			  // ... update its path credit
+			  increasePathCredit(sc, ps, pc->numTimeslots, rtscCurr);
+			}
+		    }
+		}
+	    }
+	}
+      else if (likely(!pssIdle))
+	{
+	  uint16_t dist = cf->pssNextBusy[ss->timeslotIdx];
+	  if (dist != 1)
+	    {
+	      // The next slot is empty too: no GBS decision is due before the start of the slot preceding the
+	      // next busy one, which looks ahead at it. Up to then the loop serves EBS without reading the PSS.
+	      // With no bundle in the PSS at all, up to the next config.
+	      ss->pssIdleEndRtsc = (dist == 0) ? UINT64_MAX : ss->timeslotEndRtsc + (uint64_t) (dist - 2) * timeslotTsc;
+	    }
+	  else
+	    {
+	      // AF250623: If the current slot is assigned to the virtual empty queue, the GBS queue
+	      // of the next slot should be checked for service eligibility before the service is granted to
+	      // a lower-priority queue. Otherwise, the queues that follow virtual empty queue services may
+	      // suffer for excessive services given to the lower-priority queue, becasue there is no credit
+	      // maintenance for the virtual empty queue.
+	      
 	      // Advance the selection to the next slot
 	      ss->timeslotIdxPrev = ss->timeslotIdx;
 	      ss->timeslotIdx++;
@@ -1044,22 +1419,22 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 		  ss->STATS_DEQUEUE.schedSequences++;
 		  ss->schedSeqTotalPrev = ss->schedSeqTotal;
 		}
-
+	      
 	      // Update the GBS credits for the bundle of the newly identified slot.
-	      gbsBundleId = sc->pss[sc->confId][ss->timeslotIdx];                 // id of next scheduled bundle
-	      bc = &(sc->bundleConf[sc->confId][gbsBundleId]);
-	      bs = &(ss->gbsBundle[sc->confId][gbsBundleId]);
-
+	      gbsBundleId = cf->pss[ss->timeslotIdx];                 // id of next scheduled bundle
+	      bc = &(cf->bundleConf[gbsBundleId]);
+	      bs = &(ss->gbsBundle[gbsBundleId]);
+	      
 	      gbsPathId = bc->pathId;
-	      pc = &(sc->pathConf[sc->confId][gbsPathId]);
-	      ps = &(ss->gbsPath[sc->confId][gbsPathId]);
-
+	      pc = &(cf->pathConf[gbsPathId]);
+	      ps = &(ss->gbsPath[gbsPathId]);
+	      
 	      // If a new bundle is found...
 	      if (gbsBundleId > 0)
 		{
 		  // ... update its bundle credit
 		  increaseBundleCredit(sc, bs, bc->numTimeslots, rtscCurr);
-
+		  
 		  // If the bundle has a path...
 		  if (gbsPathId > 0)
 		    {
@@ -1069,50 +1444,6 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 		}
 	    }
 	}
-      else
-	{
-	  // AF250623: If the current slot is assigned to the virtual empty queue, the GBS queue
-	  // of the next slot should be checked for service eligibility before the service is granted to
-	  // a lower-priority queue. Otherwise, the queues that follow virtual empty queue services may
-	  // suffer for excessive services given to the lower-priority queue, becasue there is no credit
-	  // maintenance for the virtual empty queue.
-	  
-	  // Advance the selection to the next slot
-	  ss->timeslotIdxPrev = ss->timeslotIdx;
-	  ss->timeslotIdx++;
-	  deqStates |= DEQ_STATE_MASK_NEW_TIMESLOT;
-	  ss->STATS_DEQUEUE.timeslots++;
-	  if (ss->timeslotIdx >= timeslotsPerSeq)
-	    {
-	      ss->timeslotIdx = ss->timeslotIdx - timeslotsPerSeq;
-	      deqStates |= DEQ_STATE_MASK_NEW_SCHEDSEQ;
-	      ss->STATS_DEQUEUE.schedSequences++;
-	      ss->schedSeqTotalPrev = ss->schedSeqTotal;
-	    }
-	  
-	  // Update the GBS credits for the bundle of the newly identified slot.
-	  gbsBundleId = sc->pss[sc->confId][ss->timeslotIdx];                 // id of next scheduled bundle
-	  bc = &(sc->bundleConf[sc->confId][gbsBundleId]);
-	  bs = &(ss->gbsBundle[sc->confId][gbsBundleId]);
-	  
-	  gbsPathId = bc->pathId;
-	  pc = &(sc->pathConf[sc->confId][gbsPathId]);
-	  ps = &(ss->gbsPath[sc->confId][gbsPathId]);
-	  
-	  // If a new bundle is found...
-	  if (gbsBundleId > 0)
-	    {
-	      // ... update its bundle credit
-	      increaseBundleCredit(sc, bs, bc->numTimeslots, rtscCurr);
-	      
-	      // If the bundle has a path...
-	      if (gbsPathId > 0)
-		{
-		  // ... update its path credit
-		  increasePathCredit(sc, ps, pc->numTimeslots, rtscCurr);
-		}
-	    }
-	}
 
       // Check again if a servable bundle has been found, whether the original or the new one
       if (((gbsBundleId > 0) && (bs->bundleCredit.value >= 0)) &&
@@ -1128,12 +1459,19 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 	  */
 	  // END DEBUG
 	  
-	  // check the queues in the bundle (round-robin) to see which one has data to send
-	  for (int i = 0; i < bc->numQueues; i++)
+	  // check the queues in the bundle (deficit round-robin) to see which one has data to send. Each visited
+	  // queue sends a pkt, then more while their wire time fits in the rest of the timeslot. Credits are charged
+	  // once per queue and the pkts of the decision reach the txRing in one burst.
+	  int64_t budgetTsc = (int64_t) (ss->timeslotEndRtsc - rtscCurr);
+	  struct rte_mbuf *txBurst[DEQ_BURST_PKTS_MAX];
+	  uint64_t txSojourn[DEQ_BURST_PKTS_MAX];
+	  unsigned txCount = 0;
+	  for (int i = 0; i < bc->numQueues && txCount < DEQ_BURST_PKTS_MAX; i++)
 	    {
-	      uint16_t gbsQueueId = getNextQueueToServed(bc);
-	      QueueState *qs = &(ss->gbsQueue[sc->confId][gbsQueueId]);
-	      uint8_t dominance = sc->streamCfg[sc->confId][gbsQueueId].dominance;   // Update stream cfg
+	      uint16_t gbsQueueId = getNextQueueToServed(sc, bc, bs);
+	      QueueState *qs = &(ss->gbsQueue[gbsQueueId]);
+	      // Update stream cfg. Queues beyond the stream table carry no stream: STREAM_TYPE_UNKNOWN.
+	      uint8_t dominance = (gbsQueueId <= NUM_STREAMS_MAX) ? cf->streamCfg[gbsQueueId].dominance : STREAM_TYPE_UNKNOWN;
 	      
 	      // ignore queue credits for BW dominated (and other) flows
 	      if (dominance == STREAM_TYPE_LAT_DOMINIATE)
@@ -1145,162 +1483,153 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 	      if ( (dominance == STREAM_TYPE_LAT_DOMINIATE) && (qs->queueCredit.value < 0) )
 		{
 		  // if not, check next queue in bundle
+		  bundleQueueSkipped(sc, bc, bs, false);
 		  continue;
 		}
 	      
 	      // check to see if the queue has data
-	      if ( !rte_ring_empty(qs->rxRing) )
+	      if ( !TmBufferQueueActive(ss, gbsQueueId) )
 		{
-		  // found a non-empty queue
-		  int n = rte_ring_sc_dequeue(qs->rxRing, (void **) &mbuf);
+		  bundleQueueSkipped(sc, bc, bs, true);
+		  continue;
+		}
+
+	      // found a non-empty queue
+	      uint32_t batchBytes = 0;                                   // pkt_len of the pkts served
+	      uint64_t batchSchedBytes = 0;                              // with the PHY and telemetry overhead
+	      int n = 0;
+	      for (unsigned k = 0; k < DEQ_BURST_PKTS_MAX && txCount < DEQ_BURST_PKTS_MAX; k++)
+		{
+		  if (k > 0)
+		    {
+		      uint32_t nextLen = TmFqQueueNextLen(sc, ss, gbsQueueId);
+		      if (nextLen == 0 ||
+			  (int64_t) txTimeTsc(sc, nextLen + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN) > budgetTsc)
+			break;
+		    }
+		  n = TmFqQueueDequeue(sc, ss, cf, gbsQueueId, &mbuf);
 		  if (n != 0)
 		    {
-		      printf("Error reading from rxRing\n");
-		      continue;
+		      if (n != -EAGAIN)
+			printf("Error reading from rxRing\n");
+		      break;
 		    }
+		  TmBufferOccDeq(ss, gbsQueueId, mbuf->pkt_len);
 		  qs->nextRxRingEntry = NULL;
 		  qs->nextMbufId++;
 		  if (qs->nextMbufId >= TXDESC_PER_QUEUE_MAX)
 		    qs->nextMbufId = 0;
-		  
-		  // got the packet, update credits
-		  uint64_t txtimeTsc = ((mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN) * 8 * 1E6)
-		    / sc->linkSpeedBpMTsc;
-		  
-		  // DEBUG
-		  //printf("CreditUpdate: pkt_len: %u, ETHER_PHY_FRAME_PHY_OVERHEAD: %u  TELEMETRY_DATA_LEN: %u   txtimeTsc: %lu\n",
-		  //     mbuf->pkt_len, ETHER_PHY_FRAME_OVERHEAD, TELEMETRY_DATA_LEN, txtimeTsc);
-		  //		      printf("%lu %lu TM9 - Slot %u - Bundle %u - Credit drop: %lu for packet size %u\n",
-		  //     ss->schedSeqTotal,
-		  //     ss->timeslotsTotal,
-		  //     ss->timeslotIdx, gbsBundleId, txtimeTsc, mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN);
-		  //fflush(stdout);
-		  // END DEBUG
-		  
-		  // Credit updates for served bundle, path, and queue
-		  decreaseBundleCredit(sc, bs, txtimeTsc);
-		  
-		  if (gbsPathId > 0)
-		    {
-		      decreasePathCredit(sc, ps, txtimeTsc);
-		    }
-		  
-		  if (dominance == STREAM_TYPE_LAT_DOMINIATE)
+
+		  // AQM on the sojourn time, before the pkt consumes any credit
+		  if (cf->aqmConf[gbsQueueId].mode != AQM_NONE &&
+		      TmAqmDequeue(sc, ss, cf, gbsQueueId, mbuf, RTE_RDTSC(epoch)) == AQM_DROP)
+		    continue;
+
+		  uint32_t schedBytes = mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN;
+		  budgetTsc -= (int64_t) txTimeTsc(sc, schedBytes);
+		  batchBytes += mbuf->pkt_len;
+		  batchSchedBytes += schedBytes;
+
+		  /// Target queue is not empty: it can be selected for GBS service
+		  rtscRxDeq = RTE_RDTSC(epoch);  // slightly delayed as include CIR postponement
+		  tscSojourn = rtscRxDeq - ORION_MBUF_META(mbuf)->rxRtsc;
+		  pktType = INTTYPE_GBS;
+		      
+		  /* Design Notes:
+		   * 1. INT TLV insertion is optimized to minimize impact on TM performance.
+		   *    TLV is only inserted for pkts with IPv4 dscp=DSCP_ORION_TM, which is done
+		   *    by SchedRxClassifyPkt() and save the condition in the mbuf OrionMbufMeta to avoid parsing again!
+		   *    It is further assumed these pkts already has TLV structure template popluated!!!
+		   * 2. When testing tm3 with iperf3, need to disable INT 
+		   */
+		  if(rtscCurr + timeslotTsc < rtscRxDeq)
 		    {
-		      decreaseQueueCredit(sc, qs);
+		      qs->tsViolation++;
 		    }
-		  
-		  if (likely(mbuf))
+		  // CRP get rid of this for now - Keep code in case we want to capture this measurement
+#if 0
+		  OrionMbufUsr omu = ORION_MBUF_META(mbuf)->omu;
+		  if (omu.u.addTMINT)
 		    {
-		      /// Target queue is not empty: it can be selected for GBS service
-		      rtscRxDeq = RTE_RDTSC(epoch);  // slightly delayed as include CIR postponement
-		      pktType = INTTYPE_GBS;
-		      
-		      /* Design Notes:
-		       * 1. INT TLV insertion is optimized to minimize impact on TM performance.
-		       *    TLV is only inserted for pkts with IPv4 dscp=DSCP_ORION_TM, which is done
-		       *    by SchedRxClassifyPkt() and save the condition in mbuf.hash.usr to avoid parsing again!
-		       *    It is further assumed these pkts already has TLV structure template popluated!!!
-		       * 2. When testing tm3 with iperf3, need to disable INT 
-		       */
-		      if(rtscCurr + timeslotTsc < RTE_RDTSC(epoch))
+		      char *pkt = rte_pktmbuf_mtod(mbuf, char *);
+		      TMGbsTLV *tlv = get_tmgbstlv_ptr(pkt, omu.u.vlan);
+		      if (tlv)
 			{
-			  qs->tsViolation++;
+			  tlv->tmsHdr.pktType = pktType;
+			  tlv->deqStates = deqStates;
+			  tlv->rxQLen = rte_ring_count(ss->rxRing[qs->qid]);  // FUTURE: fill in EqneueThread instead!
+			  tlv->txQLen = qs->tsViolation;
+			  
+			  /* NOTE:
+			   *  tscRxLatency is delay between EnqThread Classifer to start of this DeqThread's current time.
+			   *  tscTxLatency is delay between this current time to TxThread's txRing dequeued time
+			   */
+			  tlv->tscRxLatency = (uint32_t) (rtscRxDeq - tlv->tsRtscTx);  // tlv->tsRtscTx cached as rxRtsc.
+			  
+			  tlv->tsRtscTx = rtscCurr;  // cache it to compute TxLatency later by TxThread
 			}
-		      // CRP get rid of this for now - Keep code in case we want to capture this measurement
-#if 0
-		      OrionMbufUsr omu;
-		      omu.usr = mbuf->hash.usr;
-		      if (omu.u.addTMINT)
-			{
-			  char *pkt = rte_pktmbuf_mtod(mbuf, char *);
-			  TMGbsTLV *tlv = get_tmgbstlv_ptr(pkt, omu.u.vlan);
-			  if (tlv)
-			    {
-			      tlv->tmsHdr.pktType = pktType;
-			      tlv->deqStates = deqStates;
-			      tlv->rxQLen = rte_ring_count(qs->rxRing);  // FUTURE: fill in EqneueThread instead!
-			      tlv->txQLen = qs->tsViolation;
-			      
-			      /* NOTE:
-			       *  tscRxLatency is delay between EnqThread Classifer to start of this DeqThread's current time.
-			       *  tscTxLatency is delay between this current time to TxThread's txRing dequeued time
-			       */
-			      tlv->tscRxLatency = (uint32_t) (rtscRxDeq - tlv->tsRtscTx);  // tlv->tsRtscTx cached as rxRtsc.
-			      
-			      tlv->tsRtscTx = rtscCurr;  // cache it to compute TxLatency later by TxThread
-			    }
-			}
-#endif
 		    }
+#endif
 
-            /* --- PATCH 2a : rewrite Ethernet src/dst --------------------------- */
-          update_sched_mac(mbuf, sc->schedId);
-		  int rval = rte_ring_sp_enqueue(ss->txRing, (void *)mbuf);
-		  
-		  if (likely(rval==0))
-		    {
-		      ss->txPktsTotal++;  // none clearing counter
-		      
-		      DequeueThreadStats *sps = &ss->STATS_DEQUEUE;
-		      sps->txPkts++;
-		      sps->txBytes += mbuf->pkt_len;
-		      
-		      // DEBUG: The following seems strange, because TELEMETRY_DATA_LEN is 104 bytes
-		      // pkt_len is 1454 bytes, ETHER_PHY_FRAME_OVERHEAD is 24 bytes, and TELEMETRY_DATA_LEN is 104, for
-		      // a total of 1582 bytes. I believe that pkt_len should be instead 1500, with 42 more bytes to be added
-		      // as Ethernet overhead (18 for Ethernet header, 24 for PHY overhead). An TA measures 1494
-		      // bytes per packet.
-		      // AF240627: I believe it is now all taken care of.
-		      //
-		      //printf("Processing stats upon TX event. Total bytes counted for packet of size %u are %u\n",
-		      //	 mbuf->pkt_len, mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN);
-		      // END DEBUG
-		      
-		      
-		      //sps->txFrameBytes += (mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD);
-		      sps->txSchedBytes += (mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN);
-		      sps->txGBSPkts++; 
-		    }
-		  else
-		    {
-		      ss->STATS_DEQUEUE.txRingDrops++;
-		      deqStates |= DEQ_STATE_MASK_NOTSENT;
-		      rte_pktmbuf_free(mbuf);
-		      
-		      /*
-			TODO: got sent=0 so need to protect again this condition and redo scheduling 
-			But do not accumulate credit??
-		      */
-		    }
+		  /* --- PATCH 2a : rewrite Ethernet src/dst --------------------------- */
+		  update_sched_mac(mbuf, sc->schedId);
+		  txSojourn[txCount] = tscSojourn;
+		  txBurst[txCount++] = mbuf;
+		}
+	      if (batchSchedBytes == 0)
+		{
+		  // nothing read, or only AQM drops
+		  if (n != 0)
+		    bundleQueueSkipped(sc, bc, bs, false);
+		  continue;
+		}
+	      bundleQueueServed(bs, batchBytes);
+
+	      // got the packets, update credits
+	      uint64_t txtimeTsc = txTimeTsc(sc, batchSchedBytes);
+	      
+	      // Credit updates for served bundle, path, and queue
+	      decreaseBundleCredit(sc, bs, txtimeTsc);
+	      
+	      if (gbsPathId > 0)
+		{
+		  decreasePathCredit(sc, ps, txtimeTsc);
+		}
+	      
+	      if (dominance == STREAM_TYPE_LAT_DOMINIATE)
+		{
+		  decreaseQueueCredit(sc, qs);
+		}
+	    } // end for (int i = 0; i < bc->numQueues; i++)
+
+	  if (txCount != 0)
+	    {
+	      unsigned sent = rte_ring_sp_enqueue_burst(ss->txRing, (void **) txBurst, txCount, NULL);
+	      DequeueThreadStats *sps = &ss->STATS_DEQUEUE;
+
+	      ss->txPktsTotal += sent;  // none clearing counter
+	      sps->txPkts += sent;
+	      sps->txGBSPkts += sent;
+	      for (unsigned k = 0; k < sent; k++)
+		{
+		  sps->txBytes += txBurst[k]->pkt_len;
+		  sps->txSchedBytes += (txBurst[k]->pkt_len + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN);
+		  sps->tscGbsSojournSum += txSojourn[k];
+		  if (txSojourn[k] > sps->tscGbsSojournMax)
+		    sps->tscGbsSojournMax = txSojourn[k];
+		}
+	      if (unlikely(sent < txCount))
+		{
+		  sps->txRingDrops += txCount - sent;
+		  deqStates |= DEQ_STATE_MASK_NOTSENT;
+		  rte_pktmbuf_free_bulk(&txBurst[sent], txCount - sent);
 		  
-		  // NEW CONFIG CODE: AF250624 - I don't think this is needed here anymore, since it is repeated
-		  // at the end of the while loop
-		  // Switch config?
 		  /*
-		  if(sc->newConfig)
-		    {
-		      sc->confId = !sc->confId;
-		      printf(" Switching configs!!! to %d\n", sc->confId);
-		      sc->newConfig = false;
-		    }
+		    TODO: got sent=0 so need to protect again this condition and redo scheduling 
+		    But do not accumulate credit??
 		  */
-		  // END NEW CONFIG CODE
-		  
-		  // Idle for duration of last scheduled pkt so we don;t queue up multiple packets!!!
-		  /* NOTE: Performance degraded with the static inline SchedDequeueThreadIdleWait() by <1% for both thruput
-		   *       and cpu utilization at 10G input. Decided to keep the static inline function instead embedded code.
-		   */
-		  //SchedDequeueThreadIdleWait(ss, txtimeTsc, rtscCurr);
-#if 0
-		  uint64_t waitCount = 0;
-		  while ( (rte_ring_count(ss->txRing) > 0) && (!forceQuit) )
-		    {
-		      waitCount++;
-		    }
-#endif
-		} // end if ( !rte_ring_empty(qs->rxRing) )
-	    } // end for (int i = 0; i < bc->numQueues; i++)
+		}
+	    }
 	      // END NEW CONFIG CODE
 	} // end if ((gbsBundleId > 0) && (bs->bundleCredit.value >= 0) )
       else
@@ -1317,7 +1646,7 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 	  /*
 	    uint16_t uu;
 	    for(uu = 0; uu < 41; uu++) {
-	    printf("Bundle %u Credits: %ld\n", uu, ss->gbsBundle[sc->confId][uu].bundleCredit.value);
+	    printf("Bundle %u Credits: %ld\n", uu, ss->gbsBundle[uu].bundleCredit.value);
 	    }
 	  */
 	  // END DEBUG
@@ -1328,25 +1657,37 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 	  //	  printf("t: %lu slot: %u Looking for EBS queue to serve (bundleId: %u)\n", rtscCurr,  ss->timeslotIdx, gbsBundleId);
 	  // END DEBUG
 
-	  // No GBS packet selected for transmission: look for an EBS packet
-	  for (int ii = (TM_NUM_CLASSES - 1); ii >= 0; ii--)
+	  // No GBS packet selected for transmission: look for an EBS packet of the class picked by the
+	  // [EBS_SCHEDULING] priorities, DRR groups and rate caps. Tries again after an AQM drop.
+	  const DualQConf *dq = &cf->dualq;
+	  for (int tries = 0; tries < 2 * TM_NUM_CLASSES; tries++)
 	    {
-	      QueueState *qs = &(ss->ebsQueue[ii]);
+	      int sel = TmEbsSelect(sc, ss, cf, rtscCurr);
+	      if (sel < 0)
+		break;
+
+	      // The [EBS_DUALQ] pair is served at the priority of its classic class
+	      int cls = sel;
+	      if (dq->enabled && sel == dq->cClass)
+		cls = TmAqmDualQSelect(ss, cf);
+	      QueueState *qs = &(ss->ebsQueue[cls]);
 
 	      // See if the EBS queue has data
-	      if ( !rte_ring_empty(qs->rxRing) )
+	      if ( TmBufferQueueActive(ss, QID_EBS(ss->queuesNum, cls)) )
 		{
 		  // DEBUG
-		  //printf("t: %lu slot: %u Found a non-empty EBS queue (%u)\n", rtscCurr,  ss->timeslotIdx, ii);
+		  //printf("t: %lu slot: %u Found a non-empty EBS queue (%u)\n", rtscCurr,  ss->timeslotIdx, cls);
 		  // END DEBUG
 
 	  	  // Found a non-empty queue
-		  int n = rte_ring_sc_dequeue(qs->rxRing, (void **) &mbuf);
+		  int n = TmFqQueueDequeue(sc, ss, cf, QID_EBS(ss->queuesNum, cls), &mbuf);
 		  if (n != 0)
 		    {
-		      printf("Error reading from rxRing\n");
+		      if (n != -EAGAIN)
+			printf("Error reading from rxRing\n");
 		      continue;
 		    }
+		  TmBufferOccDeq(ss, QID_EBS(ss->queuesNum, cls), mbuf->pkt_len);
 		  qs->nextRxRingEntry = NULL;
 		  qs->nextMbufId++;
 		  if (qs->nextMbufId >= TXDESC_PER_QUEUE_MAX)
@@ -1354,22 +1695,33 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 		      qs->nextMbufId = 0;
 		    }
 
+		  // AQM on the sojourn time: after a drop, look at the next pkt of the same class
+		  int verdict = AQM_PASS;
+		  if (dq->enabled && (cls == dq->cClass || cls == dq->lClass))
+		    verdict = TmAqmDualQDequeue(ss, cf, cls == dq->lClass, mbuf, RTE_RDTSC(epoch));
+		  else if (cf->aqmConf[QID_EBS(ss->queuesNum, cls)].mode != AQM_NONE)
+		    verdict = TmAqmDequeue(sc, ss, cf, QID_EBS(ss->queuesNum, cls), mbuf, RTE_RDTSC(epoch));
+		  if (verdict == AQM_DROP)
+		    continue;
+
 		  if (likely(mbuf))
 		    {
+		      TmEbsServed(ss, cf, sel, mbuf->pkt_len);
 
 		      // DEBUG
 		      //printf("t: %lu slot: %u Packet of size %u found in non-empty EBS queue (%u)\n",
-			     //rtscCurr,  ss->timeslotIdx, mbuf->pkt_len, ii);
+			     //rtscCurr,  ss->timeslotIdx, mbuf->pkt_len, cls);
 		      // END DEBUG
 
 		      // Target queue is not empty: it can be selected for EBS service
 		      rtscRxDeq = RTE_RDTSC(epoch);  // slightly delayed as include CIR postponement
+		      tscSojourn = rtscRxDeq - ORION_MBUF_META(mbuf)->rxRtsc;
 		      pktType = INTTYPE_EBS;
 		      
 		      /* Design Notes:
 		       * 1. INT TLV insertion is optimized to minimize impact on TM performance.
 		       *    TLV is only inserted for pkts with IPv4 dscp=DSCP_ORION_TM, which is done
-		       *    by SchedRxClassifyPkt() and save the condition in mbuf.hash.usr to avoid parsing again!
+		       *    by SchedRxClassifyPkt() and save the condition in the mbuf OrionMbufMeta to avoid parsing again!
 		       *    It is further assumed these pkts already has TLV structure template popluated!!!
 		       * 2. When testing tm3 with iperf3, need to disable INT 
 		       */
@@ -1379,8 +1731,7 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 			}
 		      // CRP get rid of this for now - Keep code in case we want to capture this measurement
 #if 0
-		      OrionMbufUsr omu;
-		      omu.usr = mbuf->hash.usr;
+		      OrionMbufUsr omu = ORION_MBUF_META(mbuf)->omu;
 		      if (omu.u.addTMINT)
 			{
 			  char *pkt = rte_pktmbuf_mtod(mbuf, char *);
@@ -1389,7 +1740,7 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 			    {
 			      tlv->tmsHdr.pktType = pktType;
 			      tlv->deqStates = deqStates;
-			      tlv->rxQLen = rte_ring_count(qs->rxRing);  // FUTURE: fill in EqneueThread instead!
+			      tlv->rxQLen = rte_ring_count(ss->rxRing[QID_EBS(ss->queuesNum, cls)]);  // FUTURE: fill in EqneueThread instead!
 			      tlv->txQLen = qs->tsViolation;
 			      
 			      /* NOTE:
@@ -1432,6 +1783,10 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 		      //sps->txFrameBytes += (mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD);
 		      sps->txSchedBytes += (mbuf->pkt_len + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN);
 		      sps->txEBSPkts++; 
+		      sps->txEbsClassPkts[sel]++;
+		      sps->tscEbsSojournSum += tscSojourn;
+		      if (tscSojourn > sps->tscEbsSojournMax)
+			sps->tscEbsSojournMax = tscSojourn;
 		    }
 		  else
 		    {
@@ -1462,12 +1817,12 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 
 		  if (likely(pktType == INTTYPE_EBS))
 		    {
-		      // Force the exit from the loop since a packet to serve was found
-		      ii = 0;
+		      // A packet to serve was found
+		      break;
 		    }
 
-		} // end if ( !rte_ring_empty(qs->rxRing) )
-	    }  // end for (int ii = TM_NUM_CLASSES - 1; ii >= 0; i--)
+		} // end if ( TmBufferQueueActive(ss, QID_EBS(ss->queuesNum, cls)) )
+	    }  // end for (int tries = 0; tries < 2 * TM_NUM_CLASSES; tries++)
 	} // if (likely(pktType == INTPKT_UNKNOWN))
       //#endif // ADDEBSCODE
       else
@@ -1477,15 +1832,40 @@ SchedDequeueThreadDCB_Q(unsigned lcoreId)
 	  // END DEBUG
 	}
 
-      // Check for new configuration at the end of each loop iteration
-      // Switch configuration?
-      if(sc->newConfig)
+      // Queues found empty by this iteration stop being active
+      TmBufferActiveFlush(ss);
+
+      // Iterations that sent no pkt are idle, whether or not a slot was looked at
+      uint64_t tscDelta = RTE_RDTSC(epoch) - rtscCurr;
+      if (pktType != PKTTYPE_UNKNOWN)
+	ss->STATS_DEQUEUE.tscDeqLcoreBusy += tscDelta;
+      else
+	ss->STATS_DEQUEUE.tscDeqLcoreIdle += tscDelta;
+
+      // Check for new configuration at the end of each loop iteration. The old config is only
+      // reclaimed once this lcore reported quiescent, so no pointer into it may survive the report.
+      rte_rcu_qsbr_quiescent(sc->confRcu, CONF_RCU_DEQ_ID);
+      const TmConf *next = TmConfGet(sc);
+      if (unlikely(next != cf))
 	{
-	  sc->confId = !sc->confId;
-	  printf(" Switching PSS configuration!!! to %d\n", sc->confId);
-	  sc->newConfig = false;
+	  cf = next;
+	  memset(ss->gbsPath, 0, ss->queuesNum * sizeof(*ss->gbsPath));
+	  memset(ss->gbsBundle, 0, ss->queuesNum * sizeof(*ss->gbsBundle));
+	  for (uint16_t q = 0; q < ss->queuesNum; q++)
+	    ss->gbsQueue[q].queueCredit = (CreditState) { 0 };
+	  ss->pssIdleEndRtsc = 0;
+	  printf(" Switching PSS configuration!!! to #%u\n", cf->version);
+	  SchedDequeueDrainUnserved(ss, cf);
 	}
     } // end while (!forceQuit)
+  rte_rcu_qsbr_thread_offline(sc->confRcu, CONF_RCU_DEQ_ID);
+  rte_rcu_qsbr_thread_unregister(sc->confRcu, CONF_RCU_DEQ_ID);
+
+  // Pkts taken from the rings but not served yet
+  uint32_t freed = 0;
+  for (uint16_t qid = 0; qid < NUM_QIDS(ss->queuesNum); qid++)
+    freed += TmFqDrain(ss, qid);
+  printf("SchedDequeueThreadDCB_Q() exiting, %u held back pkts freed\n", freed);
 }
 
 
@@ -1570,11 +1950,17 @@ SchedTxThread(unsigned lcoreId)
   runConf.initMask |= INIT_MASK_TXRUNNING;
   RTE_LOG(INFO, SCHED, "TX thread completed init (0x%02x) on lcore %u\n", runConf.initMask, lcoreId);
 
+  // The pkts on txRing may still belong to a retired config (e.g. its stream mbufs): report quiescent
+  // only between two pkts, so that the config is reclaimed after they are handed to the driver
+  rte_rcu_qsbr_thread_register(sc->confRcu, CONF_RCU_TX_ID);
+  rte_rcu_qsbr_thread_online(sc->confRcu, CONF_RCU_TX_ID);
+
   uint64_t rtscCurr = RTE_RDTSC(epoch);
   while (!forceQuit)
     {
       struct rte_mbuf *mbuf;
 
+      rte_rcu_qsbr_quiescent(sc->confRcu, CONF_RCU_TX_ID);
       int n = rte_ring_sc_dequeue(txRing, (void **) &mbuf);
       if (n != 0)
 	continue; // no pkts pending
@@ -1586,6 +1972,7 @@ SchedTxThread(unsigned lcoreId)
       uint64_t tscIdleWait = rtscTxStart - rtscCurr;
       ss->STATS_TX.tscTxLcoreIdle += tscIdleWait;
       uint16_t pktlen = mbuf->pkt_len;  // cache as mbuf is asynchronously freed by tx driver
+      uint64_t tscLatency = rtscTxStart - ORION_MBUF_META(mbuf)->rxRtsc;
       // Transmit
       while (!forceQuit)
 	{
@@ -1604,12 +1991,17 @@ SchedTxThread(unsigned lcoreId)
       ss->STATS_TX.txBytes += pktlen;
       //ss->STATS_TX.txFrameBytes += (pktlen + ETHER_PHY_FRAME_OVERHEAD);
       ss->STATS_TX.txSchedBytes += (pktlen + ETHER_PHY_FRAME_OVERHEAD + TELEMETRY_DATA_LEN);
+      ss->STATS_TX.tscLatencySum += tscLatency;
+      if (tscLatency > ss->STATS_TX.tscLatencyMax)
+	ss->STATS_TX.tscLatencyMax = tscLatency;
       uint64_t tscTx = RTE_RDTSC(epoch) - rtscTxStart;
       ss->STATS_TX.tscTxLcoreBusy += tscTx;
 
       rtscCurr = RTE_RDTSC(epoch);
 
     }
+  rte_rcu_qsbr_thread_offline(sc->confRcu, CONF_RCU_TX_ID);
+  rte_rcu_qsbr_thread_unregister(sc->confRcu, CONF_RCU_TX_ID);
 
   printf("SchedTxThread() exiting!\n");
 }
@@ -1620,8 +2012,6 @@ SchedMainThread(unsigned lcoreId)
   struct stat file_stat;
   unsigned timerSec;
   int first = 0;
-  bool freeOldBuffer = false;
-  uint8_t thisConfig = 0;
 
   timerSec = runConf.statsTimerSec;
   RTE_LOG(INFO, SCHED, "entering main loop on lcore %u, stats interval = %u seconds\n", lcoreId, timerSec);
@@ -1633,26 +2023,28 @@ SchedMainThread(unsigned lcoreId)
   uint64_t tsc0=rte_rdtsc();
   uint64_t tscHz = rte_get_tsc_hz();
   uint64_t rtscNextPrint=0;  // Force an initial print
+  uint64_t tscClockSync=tsc0;
 
   rte_delay_us(100*USEC_PER_MSEC);
 
   while (!forceQuit)
     {
       static uint32_t prints=0;
+      OrionLogDrain();  // print the log records posted by the lcores
+      uint64_t tscNow = rte_rdtsc();
+      if (tscNow - tscClockSync >= tscHz)
+	{
+	  TmRxClockSync(sc->rxPort);  // re-anchor NIC rx timestamp conversion
+	  tscClockSync = tscNow;
+	}
       if (timerSec > 0)
 	{
 	  rte_delay_us(USEC_PER_MSEC);
 	  uint64_t rtscNow = RTE_RDTSC(tsc0);
 	  if (rtscNow >= rtscNextPrint)
 	    {
-	      // free rte_mbuf(confId))
-	      if (freeOldBuffer) {
-		for(int sidx; sidx <= sc->numStreams; sidx++) {
-		  struct rte_mbuf *mbuf = ss->streamPktMbuf[thisConfig][sidx];
-		  rte_pktmbuf_free(mbuf);
-		}
-		freeOldBuffer = false;
-	      }
+	      // Free the retired configs, with their stream mbufs, that no lcore can reach anymore
+	      TmConfReclaim(sc);
 
 	      //#if 0
 	      uint64_t drops=0;
@@ -1685,61 +2077,45 @@ SchedMainThread(unsigned lcoreId)
 		uint16_t ii;
 		printf("BUNDLE CREDIT INITIALIZATION VALUES\n");
 		for(ii = 0; ii < 41; ii++) {
-		  printf("Bundle %u  Credit: %ld\n", ii, ss->gbsBundle[thisConfig][ii].bundleCredit.value);
+		  printf("Bundle %u  Credit: %ld\n", ii, ss->gbsBundle[ii].bundleCredit.value);
 		}
 		*/
 		// END DEBUG
 
 	      }
 	      if(file_stat.st_mtime > sc->lastUpdateTime) {
-		// Found a new verson of the scheduler configuraton file: swap configuration
+		// Found a new verson of the scheduler configuraton file: build it aside, then publish it
 		printf(" UPDATE ");
-		int confId = !sc->confId; 
-		// Reset configurations and state for this confId
-		memset(&sc->pss[confId][0], 0, sizeof(sc->pss)/2);
-		memset(&sc->bundleConf[confId][0], 0, sizeof(sc->bundleConf)/2);
-		memset(&ss->gbsBundle[confId][0], 0, sizeof(ss->gbsBundle)/2);
-		memset(&ss->gbsQueue[confId][0], 0, sizeof(ss->gbsQueue)/2);
-		QueueState *qs;
-		for (int q=0; q<sc->queuesNum; q++)
-		  {
-		    qs = &ss->gbsQueue[confId][q];
-		    //memset(qs, 0, sizeof(QueueState));  // Not required as done by SchedState init
-		    qs->qtype = QUEUE_TYPE_GBS;
-		    qs->qid = (uint16_t) q & 0xffff;
-		  }
-    
-		// Parse the new configuraton file for the scheduler
-		int ret = app_parse_scf(sc->schedId, sc->schedCfgFile, confId);
-		if (ret != 0) {
+		TmConf *cf = app_parse_scf(sc->schedId, sc->schedCfgFile);
+		if (cf == NULL) {
 		  // failed ... ignore
 		  printf("Failure to parse updated config file %s \n", sc->schedCfgFile);
 		}
 		else { // TM config successful
-
 		  // AF250521: There is no stream configuration file with TM9: should this
 		  // entire piece of code be removed?
 
-		  // Assume stream file also changed.  Use configId that was set above
-		  // Reset Configs and state ... may do it along with other above
-		  memset(&sc->streamCfg[confId][0], 0, sizeof(sc->streamCfg)/2);
-		  sc->streamsBaseNum = 0;
-		  sc->numStreams = 0;
-		  ret = app_parse_strmcf(sc->schedId, sc->streamCfgFile, confId);
+		  // Assume stream file also changed
+		  int ret = 0;
+		  if (sc->streamCfgFile[0] != '\0')
+		    ret = app_parse_strmcf(sc->schedId, sc->streamCfgFile, cf);
 		  if(ret !=0) {
 		    // failed ... ignore
-		    printf("Failure to parse updated stream file %s \n", sc->schedCfgFile);
+		    printf("Failure to parse updated stream file %s \n", sc->streamCfgFile);
+		    TmConfFree(cf);
 		  }
 		  else {
 		    // now initialize packets
-		    if(StreamPktInit(confId, 0) < 0){
+		    if(StreamPktInit(cf, 0) < 0){
 		      printf("Failure to n stream packet init");
+		      TmConfFree(cf);
 		    }
 		    else {
-		      StreamRatesValidate(sc, confId);
-		      sc->newConfig = true;
-		      freeOldBuffer = true;
-		      thisConfig = sc->confId; // frees old config buffers
+		      StreamRatesValidate(sc, cf);
+		      // The NIC only steers by the MARK rules of a config that is published
+		      if (runConf.flowMarkOffload)
+			TmRxFlowMarkInstall(sc, cf);  // MARK rules for the new [FLOW_TABLE]
+		      TmConfPublish(sc, cf);  // picked up by the lcores, the old one retired
 		    }
 		  }
 		}
@@ -1751,6 +2127,9 @@ SchedMainThread(unsigned lcoreId)
 	}
     }
 
+  OrionLogDrain();
+  if (sc->conf->flowAssign.numBundles != 0)
+    TmFlowAssignDump(sc, ss);
   printf("SchedMainThread() exiting!\n");
 }
 
@@ -1778,7 +2157,7 @@ SchedThreadsDispatcher(void)
    * - SchedMainThread() - thread monitoring and statistics reporting
    */
 
-  if (lcoreId == sc->rxCore)
+  if (LcoreIdToEnqIdx(sc, lcoreId) >= 0)
     SchedEnqueueThread(lcoreId);
   else if (lcoreId == sc->tmCore)
     SchedDequeueThread(lcoreId);
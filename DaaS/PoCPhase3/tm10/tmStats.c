@@ -6,10 +6,19 @@
 **
 */
 
+#include <rte_malloc.h>
+
 #include "tmStats.h"
+#include "tmBuffer.h"
 
 #define BITS_PER_GBPS 1.0e9
 
+static inline double
+TscToUsec(uint64_t tsc)
+{
+	return (double)tsc * 1E6 / (double)rte_get_tsc_hz();
+}
+
 /* Print Dequeue Thread statistics */
 void
 SummaryDequeueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint64_t *drops)
@@ -35,7 +44,15 @@ SummaryDequeueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint6
 	deqDelta.tscDeqLcoreBusy     = deqNew.tscDeqLcoreBusy     - deqPrev.tscDeqLcoreBusy;
 	deqDelta.tscDeqLcoreIdle     = deqNew.tscDeqLcoreIdle     - deqPrev.tscDeqLcoreIdle;
 	deqDelta.txRingDrops         = deqNew.txRingDrops         - deqPrev.txRingDrops;
-	*drops += deqDelta.txRingDrops;
+	deqDelta.tscGbsSojournSum    = deqNew.tscGbsSojournSum    - deqPrev.tscGbsSojournSum;
+	deqDelta.tscEbsSojournSum    = deqNew.tscEbsSojournSum    - deqPrev.tscEbsSojournSum;
+	deqDelta.aqmMarks            = deqNew.aqmMarks            - deqPrev.aqmMarks;
+	deqDelta.aqmDrops            = deqNew.aqmDrops            - deqPrev.aqmDrops;
+	deqDelta.dualqLSignals       = deqNew.dualqLSignals       - deqPrev.dualqLSignals;
+	deqDelta.dualqCSignals       = deqNew.dualqCSignals       - deqPrev.dualqCSignals;
+	for (unsigned c=0; c<TM_NUM_CLASSES; c++)
+		deqDelta.txEbsClassPkts[c] = deqNew.txEbsClassPkts[c] - deqPrev.txEbsClassPkts[c];
+	*drops += deqDelta.txRingDrops + deqDelta.aqmDrops;
 
 	rte_memcpy(&deqPrev, &deqNew, sizeof(DequeueThreadStats));	// save new previous values
 
@@ -48,6 +65,8 @@ SummaryDequeueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint6
 		   "\nTx rate/scheduling rate:        %8.4fG/%8.4fG"
 		   "\nTx pkts GBS/EBS/Sync:           %12"PRIu64"/%12"PRIu64"/%12"PRIu64
 		   "\nTx ringDrops:                   %12u"
+		   "\nAQM marks/drops:                %12"PRIu64"/%12"PRIu64
+		   "\nDualQ L4S/classic signals/p':   %12"PRIu64"/%12"PRIu64"/%8.6f"
 		   "\ntscSchedErr max/usec/Exc:       %12"PRIu64"/%12"PRIu64"/%12"PRIu64
 		   "\nDeq Busy/Idle/BusyPct:          %12"PRIu64"/%12"PRIu64"/%8.4f%%",
 		   schedId, secs,
@@ -65,6 +84,11 @@ SummaryDequeueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint6
 	           deqDelta.txEBSPkts,
 	           deqDelta.txSyncPkts,
 		   deqDelta.txRingDrops,
+	           deqDelta.aqmMarks,
+	           deqDelta.aqmDrops,
+	           deqDelta.dualqLSignals,
+	           deqDelta.dualqCSignals,
+	           ssp->dualq.prob,
 	           deqDelta.tscSchedErrMax,
 	           nsecSchedErrMax,
 	           deqDelta.tscSchedErrExc,
@@ -75,13 +99,30 @@ SummaryDequeueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint6
 
 	if (ssp->txRing)  // check of null to avoid race condition with Tx thread
 	{
-		int capacity = rte_ring_get_capacity(ssp->txRing);  // Should equal APP_RING_SIZE
+		int capacity = rte_ring_get_capacity(ssp->txRing);  // Should equal TM_TX_RING_SIZE - 1
 		printf("\nTxRing size=%d, occupany: %4x", capacity, rte_ring_count(ssp->txRing));
 	}
 
+	printf("\nSojourn usec GBS avg/max:       %12.2f/%12.2f"
+		   "\nSojourn usec EBS avg/max:       %12.2f/%12.2f",
+		   deqDelta.txGBSPkts ? TscToUsec(deqDelta.tscGbsSojournSum / deqDelta.txGBSPkts) : 0.0,
+		   TscToUsec(deqNew.tscGbsSojournMax),
+		   deqDelta.txEBSPkts ? TscToUsec(deqDelta.tscEbsSojournSum / deqDelta.txEBSPkts) : 0.0,
+		   TscToUsec(deqNew.tscEbsSojournMax));
+
+	// EBS share of each class under the [EBS_SCHEDULING] priorities and rate caps
+	printf("\nTx pkts EBS per class:        ");
+	for (unsigned c=0; c<TM_NUM_CLASSES; c++)
+	{
+		if (deqDelta.txEbsClassPkts[c] != 0)
+			printf(" ebs%u=%"PRIu64, c, deqDelta.txEbsClassPkts[c]);
+	}
+
 	printf("\n====================================================\n");
 	secsPrev = secs;
         ssp->STATS_DEQUEUE.timeslotsSkippedMax = 0;
+        ssp->STATS_DEQUEUE.tscGbsSojournMax = 0;
+        ssp->STATS_DEQUEUE.tscEbsSojournMax = 0;
 }
 
 /* Print Tx Thread statistics */
@@ -100,6 +141,7 @@ SummaryTxStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs)
 	txDelta.txSchedBytes    = txNew.txSchedBytes    - txPrev.txSchedBytes;
 	txDelta.tscTxLcoreBusy  = txNew.tscTxLcoreBusy  - txPrev.tscTxLcoreBusy;
 	txDelta.tscTxLcoreIdle  = txNew.tscTxLcoreIdle  - txPrev.tscTxLcoreIdle;
+	txDelta.tscLatencySum   = txNew.tscLatencySum   - txPrev.tscLatencySum;
 
 	rte_memcpy(&txPrev, &txNew, sizeof(TxThreadStats));	// save new previous values
 
@@ -107,7 +149,8 @@ SummaryTxStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs)
 		   "\nTx pkts deq:               %12"PRIu64
 		   "\nTx pkts/bytes/sched bytes: %12"PRIu64"/%12"PRIu64"/%12"PRIu64
 		   "\nTx rate/scheduling rate:   %8.4fG/%8.4fG"
-		   "\nTx busy/idle/busy pct:     %12"PRIu64"/%12"PRIu64"/%8.4f%%",
+		   "\nTx busy/idle/busy pct:     %12"PRIu64"/%12"PRIu64"/%8.4f%%"
+		   "\nRx-to-tx usec avg/max:     %12.2f/%12.2f",
 		   schedId, secs,
 	           txDelta.txPktsDeq,
 	           txDelta.txPktsSent,
@@ -117,11 +160,14 @@ SummaryTxStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs)
 	           (float)(txDelta.txSchedBytes * 8)/((float)(secs - secsPrev) * BITS_PER_GBPS),
 	           txDelta.tscTxLcoreBusy,
 	           txDelta.tscTxLcoreIdle,
-		   (float)(txDelta.tscTxLcoreBusy * 100)/(float)(txDelta.tscTxLcoreBusy + txDelta.tscTxLcoreIdle)
+		   (float)(txDelta.tscTxLcoreBusy * 100)/(float)(txDelta.tscTxLcoreBusy + txDelta.tscTxLcoreIdle),
+		   txDelta.txPktsSent ? TscToUsec(txDelta.tscLatencySum / txDelta.txPktsSent) : 0.0,
+		   TscToUsec(txNew.tscLatencyMax)
 	       );
 
 	printf("\n====================================================\n");
 	secsPrev = secs;
+	ssp->STATS_TX.tscLatencyMax = 0;
 }
 
 void
@@ -183,28 +229,95 @@ void
 SummaryEnqueueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint64_t *drops)
 {
 	static EnqueueThreadStats enqPrev;
+	static uint64_t busyPrev[NUM_ENQ_LCORES_MAX], idlePrev[NUM_ENQ_LCORES_MAX];
 	static uint32_t secsPrev;
+	static uint64_t *queueDropsNew, *queueDropsPrev, *queueDropsDelta;	// [NUM_QIDS(queuesNum)]
 	EnqueueThreadStats enqDelta, enqNew;
-	rte_memcpy(&enqNew, &ssp->STATS_ENQUEUE, sizeof(EnqueueThreadStats));
+	SchedConf *sc = &schedConf[schedId];
+	unsigned numQids = NUM_QIDS(sc->queuesNum);
+
+	if (queueDropsNew == NULL)
+	{
+		queueDropsNew = rte_zmalloc("QueueDropsStats", 3 * numQids * sizeof(uint64_t), 0);
+		if (queueDropsNew == NULL)
+			rte_exit(EXIT_FAILURE, "ERROR: queue drop stats alloc failed for %u qids!\n", numQids);
+		queueDropsPrev = queueDropsNew + numQids;
+		queueDropsDelta = queueDropsPrev + numQids;
+	}
+
+	// Sum of the per enqueue lcore counters
+	memset(&enqNew, 0, sizeof(EnqueueThreadStats));
+	memset(queueDropsNew, 0, numQids * sizeof(uint64_t));
+	enqNew.queueDrops = queueDropsNew;
+	for (unsigned e=0; e<sc->numRxCores; e++)
+	{
+		EnqueueThreadStats *es = &ssp->STATS_ENQUEUE[e];
+		for (unsigned q=0; q<runConf.rxqNum; q++)
+		{
+			enqNew.rxqPkts[q]       += es->rxqPkts[q];
+			enqNew.rxqEmptyPolls[q] += es->rxqEmptyPolls[q];
+			enqNew.rxqFullBursts[q] += es->rxqFullBursts[q];
+		}
+		enqNew.rxPkts          += es->rxPkts;
+		enqNew.rxBytes         += es->rxBytes;
+		enqNew.rxFrameBytes    += es->rxFrameBytes;
+		enqNew.rxRingDrops     += es->rxRingDrops;
+		enqNew.rxMarkInvalid   += es->rxMarkInvalid;
+		for (unsigned c=0; c<RTE_COLORS; c++)
+			enqNew.policerColors[c] += es->policerColors[c];
+		enqNew.policerRemarks  += es->policerRemarks;
+		enqNew.policerDrops    += es->policerDrops;
+		for (unsigned qid=0; qid<numQids; qid++)
+			enqNew.queueDrops[qid] += es->queueDrops[qid];
+		enqNew.bufDtDrops      += es->bufDtDrops;
+		enqNew.flowAssignNew   += es->flowAssignNew;
+		enqNew.flowAssignAged  += es->flowAssignAged;
+		enqNew.flowAssignFull  += es->flowAssignFull;
+		enqNew.tscEnqLcoreBusy += es->tscEnqLcoreBusy;
+		enqNew.tscEnqLcoreIdle += es->tscEnqLcoreIdle;
+	}
 
 	for (unsigned q=0; q<runConf.rxqNum; q++)
-		enqDelta.rxqPkts[q] = enqNew.rxqPkts[q] - enqPrev.rxqPkts[q];
+	{
+		enqDelta.rxqPkts[q]       = enqNew.rxqPkts[q]       - enqPrev.rxqPkts[q];
+		enqDelta.rxqEmptyPolls[q] = enqNew.rxqEmptyPolls[q] - enqPrev.rxqEmptyPolls[q];
+		enqDelta.rxqFullBursts[q] = enqNew.rxqFullBursts[q] - enqPrev.rxqFullBursts[q];
+	}
 
 	enqDelta.rxPkts          = enqNew.rxPkts          - enqPrev.rxPkts;
 	enqDelta.rxBytes         = enqNew.rxBytes         - enqPrev.rxBytes;
 	enqDelta.rxFrameBytes    = enqNew.rxFrameBytes    - enqPrev.rxFrameBytes;
 	enqDelta.rxRingDrops     = enqNew.rxRingDrops     - enqPrev.rxRingDrops;
+	enqDelta.rxMarkInvalid   = enqNew.rxMarkInvalid   - enqPrev.rxMarkInvalid;
+	for (unsigned c=0; c<RTE_COLORS; c++)
+		enqDelta.policerColors[c] = enqNew.policerColors[c] - enqPrev.policerColors[c];
+	enqDelta.policerRemarks  = enqNew.policerRemarks  - enqPrev.policerRemarks;
+	enqDelta.policerDrops    = enqNew.policerDrops    - enqPrev.policerDrops;
+	enqDelta.queueDrops = queueDropsDelta;
+	for (unsigned qid=0; qid<numQids; qid++)
+		enqDelta.queueDrops[qid] = enqNew.queueDrops[qid] - queueDropsPrev[qid];
+	enqDelta.bufDtDrops      = enqNew.bufDtDrops      - enqPrev.bufDtDrops;
+	enqDelta.flowAssignNew   = enqNew.flowAssignNew   - enqPrev.flowAssignNew;
+	enqDelta.flowAssignAged  = enqNew.flowAssignAged  - enqPrev.flowAssignAged;
+	enqDelta.flowAssignFull  = enqNew.flowAssignFull  - enqPrev.flowAssignFull;
 	enqDelta.tscEnqLcoreBusy  = enqNew.tscEnqLcoreBusy  - enqPrev.tscEnqLcoreBusy;
 	enqDelta.tscEnqLcoreIdle  = enqNew.tscEnqLcoreIdle  - enqPrev.tscEnqLcoreIdle;
 	*drops += enqDelta.rxRingDrops;
 
 	rte_memcpy(&enqPrev, &enqNew, sizeof(EnqueueThreadStats));	// save new previous values
+	rte_memcpy(queueDropsPrev, queueDropsNew, numQids * sizeof(uint64_t));
 
 	printf("\nEnqueueStatistics for TM%u  %usec ------------------------------", schedId, secs);
 
 	printf("\nrxQPkts:"); 
 	for (uint16_t q=0; q<runConf.rxqNum; q++)
 		printf(" %12"PRIu64, enqDelta.rxqPkts[q]);
+	printf("\nrxQEmptyPolls:"); 
+	for (uint16_t q=0; q<runConf.rxqNum; q++)
+		printf(" %12"PRIu64, enqDelta.rxqEmptyPolls[q]);
+	printf("\nrxQFullBursts:"); 
+	for (uint16_t q=0; q<runConf.rxqNum; q++)
+		printf(" %12"PRIu64, enqDelta.rxqFullBursts[q]);
 
 	unsigned avgPktsize=0;
 	if (likely(enqDelta.rxPkts>0))
@@ -216,6 +329,7 @@ SummaryEnqueueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint6
 	printf(
 		   "\nRx pkts/bytes/+framing/gbps:  %12"PRIu64"/%12"PRIu64"/%12"PRIu64"/%8.4fG, avg_pktsize=%u"
 		   "\nRx ringDrops:                 %12"PRIu64
+		   "\nPolicer G/Y/R/remark/drop:    %12"PRIu64"/%12"PRIu64"/%12"PRIu64"/%12"PRIu64"/%12"PRIu64
 		   "\nEnq Busy/Idle/BusyPct:        %12"PRIu64"/%12"PRIu64"/%8.4f%%",
 	           enqDelta.rxPkts,
 	           enqDelta.rxBytes,
@@ -224,12 +338,76 @@ SummaryEnqueueStatsPrint(unsigned schedId, SchedState *ssp, uint32_t secs, uint6
 	           //(float)(enqDelta.rxFrameBytes * 8)/(float)((secs - secsPrev) * BITS_PER_GBPS),
 	           avgPktsize,
 	           enqDelta.rxRingDrops,
+	           enqDelta.policerColors[RTE_COLOR_GREEN],
+	           enqDelta.policerColors[RTE_COLOR_YELLOW],
+	           enqDelta.policerColors[RTE_COLOR_RED],
+	           enqDelta.policerRemarks,
+	           enqDelta.policerDrops,
 	           enqDelta.tscEnqLcoreBusy,
 	           enqDelta.tscEnqLcoreIdle,
 		   (float)(enqDelta.tscEnqLcoreBusy * 100)/(float)(enqDelta.tscEnqLcoreBusy + enqDelta.tscEnqLcoreIdle)
 	       );
 
-	// int capacity = rte_ring_get_capacity(ssp->gbsQueue[schedId][0].rxRing);	// Should equal APP_RING_SIZE
+	printf("\nConfig version:               %12u", sc->confVersion);
+	if (runConf.flowMarkOffload)
+		printf("\nRx flow MARK invalid:        %12"PRIu64, enqDelta.rxMarkInvalid);
+
+	// Tail drops at the queue buffer limits, only queues that dropped
+	printf("\nQueue limit drops:           ");
+	for (unsigned qid=0; qid<numQids; qid++)
+	{
+		if (enqDelta.queueDrops[qid] == 0)
+			continue;
+		if (qid < sc->queuesNum)
+			printf(" q%u=%"PRIu64, qid, enqDelta.queueDrops[qid]);
+		else
+			printf(" ebs%u=%"PRIu64, qid - QID_EBS_BASE(sc->queuesNum), enqDelta.queueDrops[qid]);
+	}
+
+	// Shared mbuf pool: pkts held by the queues, then the non-empty queues
+	printf("\nBuffer used/shared/DT drops:  %12u/%12u/%12"PRIu64,
+	       TmBufferUsed(ssp), sc->conf->bufSharedPkts, enqDelta.bufDtDrops);
+	printf("\nQueue occupancy pkts:        ");
+	for (unsigned qid=0; qid<numQids; qid++)
+	{
+		uint32_t pkts;
+		uint64_t bytes;
+		TmBufferOcc(ssp, qid, &pkts, &bytes);
+		if (pkts == 0)
+			continue;
+		if (qid < sc->queuesNum)
+			printf(" q%u=%u", qid, pkts);
+		else
+			printf(" ebs%u=%u", qid - QID_EBS_BASE(sc->queuesNum), pkts);
+	}
+
+	// [FLOW_ASSIGN] mapping: flows pinned to each GBS queue, see TmFlowAssignDump() for the flows
+	if (sc->conf->flowAssign.numBundles != 0)
+	{
+		printf("\nFlow assign new/aged/full:    %12"PRIu64"/%12"PRIu64"/%12"PRIu64,
+		       enqDelta.flowAssignNew, enqDelta.flowAssignAged, enqDelta.flowAssignFull);
+		printf("\nFlows per queue:             ");
+		for (unsigned qid=1; qid<sc->queuesNum; qid++)
+		{
+			if (ssp->flowAssignFlows[qid] != 0)
+				printf(" q%u=%u", qid, ssp->flowAssignFlows[qid]);
+		}
+	}
+
+	if (sc->numRxCores > 1)
+	{
+		printf("\nEnq BusyPct per lcore:       ");
+		for (unsigned e=0; e<sc->numRxCores; e++)
+		{
+			uint64_t busy = ssp->STATS_ENQUEUE[e].tscEnqLcoreBusy - busyPrev[e];
+			uint64_t idle = ssp->STATS_ENQUEUE[e].tscEnqLcoreIdle - idlePrev[e];
+			busyPrev[e] += busy;
+			idlePrev[e] += idle;
+			printf(" lcore%u=%6.2f%%", sc->rxCores[e], (busy + idle) ? (float)(busy * 100)/(float)(busy + idle) : 0.0);
+		}
+	}
+
+	// int capacity = rte_ring_get_capacity(ssp->gbsQueue[schedId][0].rxRing);	// Sized by TmBufferRingSize()
 	// printf("\nRxRing size=%d, %d entries have cnts: ", capacity, TM_NUM_RX_RINGS);
 	// for (int i=0; i<TM_NUM_RX_RINGS; i++)
 	// 	printf("%4d ", rte_ring_count(ssp->gbsQueue[schedId][i].rxRing));
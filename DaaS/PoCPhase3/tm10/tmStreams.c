@@ -9,17 +9,16 @@
 #include "tmDefs.h"
 
 int
-StreamPktInit(uint8_t confId, uint8_t sid)
+StreamPktInit(TmConf *cf, uint8_t sid)
 {
   SchedConf *sc = &schedConf[sid];
-  SchedState *ss = &schedState[sid];
   IntfConf *ic = &intfConf[sid];
 
   // For all streams...
 
-  for (int sIdx=1; sIdx <= sc->numStreams; sIdx++)
+  for (int sIdx=1; sIdx <= cf->numStreams; sIdx++)
   {
-    StreamCfg *sCfg = &sc->streamCfg[confId][sIdx];
+    StreamCfg *sCfg = &cf->streamCfg[sIdx];
 
     // Set stream type (bandwidth dominate vs latency dominate) based on latency value and rate
 
@@ -73,14 +72,14 @@ StreamPktInit(uint8_t confId, uint8_t sid)
 
     // Update stream cfg - sacrificing multiple ports and using it for extra stream configuration
     //struct rte_mbuf **pmbuf = &ss->streamPktMbuf[sc->txPort][sIdx];
-    struct rte_mbuf **pmbuf = &ss->streamPktMbuf[confId][sIdx];
+    struct rte_mbuf **pmbuf = &cf->streamPktMbuf[sIdx];
     struct rte_mbuf *mbuf = rte_pktmbuf_alloc(pktmbufPool);
     *pmbuf = mbuf;
-    mbuf->hash.usr = sIdx;  // cache stream index in packet for runtime packet touches (e.g. seqno)
+    ORION_MBUF_META(mbuf)->streamIdx = sIdx;  // cache stream index in packet for runtime packet touches (e.g. seqno)
 
     // Sanity check
-    if (sIdx > sc->numStreams)
-      rte_panic(" PktTemplateInit: Bad stream index %d as >%d\n", (int)sIdx, (int)sc->numStreams);
+    if (sIdx > cf->numStreams)
+      rte_panic(" PktTemplateInit: Bad stream index %d as >%d\n", (int)sIdx, (int)cf->numStreams);
     if (mbuf == NULL)
       rte_panic(" PktTemplateInit: mbuf allocation failed for stream index %d\n", sIdx);
 